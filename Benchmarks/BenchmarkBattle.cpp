@@ -0,0 +1,206 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#include "BenchmarkBattle.h"
+
+
+BenchmarkOptions::BenchmarkOptions() :
+unitsPerPlayer(10),
+fightersPerUnit(80),
+timeSteps(1000),
+layout(BenchmarkLayoutCharge),
+weapon("mixed"),
+seed(1),
+threads(1),
+spatialIndex(SpatialIndexQuadTree),
+influenceTolerance(0),
+aggregateDistance(0),
+allowSleep(false)
+{
+}
+
+
+void PrintUsage(const char* program, const char* arguments)
+{
+	printf("usage: %s %s[-u units per player] [-f fighters per unit] [-n time steps]\n", program, arguments);
+	printf("          [-l charge|melee|stand|volley|march] [-w kata|yari|nagi|bow|arq|melee|mixed] [-s seed]\n");
+	printf("          [-t threads, 0 for all cores] [-i quadtree|incremental|grid]\n");
+	printf("          [-e influence tolerance, 0 for the exact sum] [-a aggregate distance, 0 for none]\n");
+	printf("          [-z 1 to let units at rest sleep]\n");
+}
+
+
+bool ParseOptions(int argc, char* argv[], int first, BenchmarkOptions& options)
+{
+	for (int i = first; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (arg[0] != '-' || arg[1] == 0 || arg[2] != 0 || value == nullptr)
+			return false;
+
+		switch (arg[1])
+		{
+			case 'u': options.unitsPerPlayer = atoi(value); break;
+			case 'f': options.fightersPerUnit = atoi(value); break;
+			case 'n': options.timeSteps = atoi(value); break;
+			case 't': options.threads = atoi(value); break;
+			case 'e': options.influenceTolerance = (float)atof(value); break;
+			case 'a': options.aggregateDistance = (float)atof(value); break;
+			case 'z': options.allowSleep = atoi(value) != 0; break;
+			case 's': options.seed = (unsigned int)strtoul(value, nullptr, 10); break;
+			case 'w': options.weapon = value; break;
+			case 'i':
+				if (strcmp(value, "quadtree") == 0)
+					options.spatialIndex = SpatialIndexQuadTree;
+				else if (strcmp(value, "incremental") == 0)
+					options.spatialIndex = SpatialIndexIncrementalQuadTree;
+				else if (strcmp(value, "grid") == 0)
+					options.spatialIndex = SpatialIndexGrid;
+				else
+					return false;
+				break;
+			case 'l':
+				if (strcmp(value, "charge") == 0)
+					options.layout = BenchmarkLayoutCharge;
+				else if (strcmp(value, "melee") == 0)
+					options.layout = BenchmarkLayoutMelee;
+				else if (strcmp(value, "stand") == 0)
+					options.layout = BenchmarkLayoutStand;
+				else if (strcmp(value, "volley") == 0)
+					options.layout = BenchmarkLayoutVolley;
+				else if (strcmp(value, "march") == 0)
+					options.layout = BenchmarkLayoutMarch;
+				else
+					return false;
+				break;
+			default:
+				return false;
+		}
+		++i;
+	}
+
+	return options.unitsPerPlayer > 0 && options.fightersPerUnit > 0 && options.timeSteps > 0;
+}
+
+
+const char* GetSpatialIndexName(SpatialIndex spatialIndex)
+{
+	switch (spatialIndex)
+	{
+		case SpatialIndexIncrementalQuadTree: return "incremental";
+		case SpatialIndexGrid: return "grid";
+		default: return "quadtree";
+	}
+}
+
+
+float Random()
+{
+	return (rand() & 0x7FFF) / (float)0x7FFF;
+}
+
+
+SimulationState* CreateSimulationState(unsigned int seed, bool lake)
+{
+	SimulationState* result = new SimulationState();
+	result->seed = seed;
+	result->map = new image(512, 512);
+
+	if (lake)
+	{
+		image* map = result->map;
+		for (int y = 0; y < (int)map->_height; ++y)
+			for (int x = 0; x < (int)map->_width; ++x)
+			{
+				bool water = 200 <= y && y < 280 && 90 <= x && x < 460;
+				bool ford = 200 <= y && y < 280 && 60 <= x && x < 90;
+				bool forest = 300 <= y && y < 340 && 60 <= x && x < 300;
+				map->set_pixel(x, y, glm::vec4(ford ? 1 : 0, forest ? 1 : 0, water || ford ? 1 : 0, 1));
+			}
+	}
+
+	result->UpdateTerrainGrid();
+	return result;
+}
+
+
+UnitStats GetBenchmarkUnitStats(const char* weapon, int index)
+{
+	if (strcmp(weapon, "kata") == 0)
+		return SimulationState::GetDefaultUnitStats(UnitPlatformSam, UnitWeaponKata);
+	if (strcmp(weapon, "yari") == 0)
+		return SimulationState::GetDefaultUnitStats(UnitPlatformAsh, UnitWeaponYari);
+	if (strcmp(weapon, "nagi") == 0)
+		return SimulationState::GetDefaultUnitStats(UnitPlatformSam, UnitWeaponNagi);
+	if (strcmp(weapon, "bow") == 0)
+		return SimulationState::GetDefaultUnitStats(UnitPlatformSam, UnitWeaponBow);
+	if (strcmp(weapon, "arq") == 0)
+		return SimulationState::GetDefaultUnitStats(UnitPlatformAsh, UnitWeaponArq);
+	if (strcmp(weapon, "melee") == 0)
+		return index % 2 == 0
+			? SimulationState::GetDefaultUnitStats(UnitPlatformSam, UnitWeaponKata)
+			: SimulationState::GetDefaultUnitStats(UnitPlatformAsh, UnitWeaponYari);
+
+	switch (index % 4)
+	{
+		case 0: return SimulationState::GetDefaultUnitStats(UnitPlatformSam, UnitWeaponKata);
+		case 1: return SimulationState::GetDefaultUnitStats(UnitPlatformAsh, UnitWeaponYari);
+		case 2: return SimulationState::GetDefaultUnitStats(UnitPlatformAsh, UnitWeaponArq);
+		default: return SimulationState::GetDefaultUnitStats(UnitPlatformSam, UnitWeaponBow);
+	}
+}
+
+
+void DeployArmies(SimulationState* simulationState, int unitsPerPlayer, int fightersPerUnit, BenchmarkLayout layout, const char* weapon, int extraFighters)
+{
+	float gap;
+	switch (layout)
+	{
+		case BenchmarkLayoutMelee: gap = 12; break;
+		case BenchmarkLayoutStand: gap = 400; break;
+		case BenchmarkLayoutVolley: gap = 100; break;
+		case BenchmarkLayoutMarch: gap = 700; break;
+		default: gap = 200; break;
+	}
+
+	// large armies are deployed in several lines, one behind the other
+	int columns = std::min(unitsPerPlayer, 16);
+	float width = 60;
+	float depth = 30;
+	float left = 512 - width * (columns - 1) / 2;
+
+	std::vector<Unit*> units1;
+	std::vector<Unit*> units2;
+
+	for (int i = 0; i < unitsPerPlayer; ++i)
+	{
+		UnitStats stats = GetBenchmarkUnitStats(weapon, i);
+		float x = left + width * (i % columns);
+		float y = gap / 2 + depth * (i / columns);
+		units1.push_back(simulationState->AddUnit(Player1, fightersPerUnit + extraFighters, stats, glm::vec2(x, 512 - y)));
+		units2.push_back(simulationState->AddUnit(Player2, fightersPerUnit, stats, glm::vec2(x, 512 + y)));
+	}
+
+	if (layout != BenchmarkLayoutStand && layout != BenchmarkLayoutVolley)
+	{
+		for (int i = 0; i < unitsPerPlayer; ++i)
+		{
+			bool isMissile = units1[i]->stats.maximumRange > 0;
+			if (!isMissile || layout == BenchmarkLayoutMarch)
+			{
+				units1[i]->movement.target = units2[i];
+				units2[i]->movement.target = units1[i];
+			}
+		}
+	}
+}
+
+
+SimulationState* CreateBattle(const BenchmarkOptions& options)
+{
+	SimulationState* result = CreateSimulationState(options.seed, false);
+	DeployArmies(result, options.unitsPerPlayer, options.fightersPerUnit, options.layout, options.weapon);
+	return result;
+}
@@ -0,0 +1,69 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#ifndef BENCHMARKBATTLE_H
+#define BENCHMARKBATTLE_H
+
+#include "SimulationState.h"
+#include "SimulationRules.h"
+
+
+// Setup shared by the benchmarks, so that they all play the same battle: two
+// armies facing each other across the middle of a 1024 meter map, in lines of
+// up to 16 units, with the options SimulationBenchmark takes on the command line.
+
+
+enum BenchmarkLayout
+{
+	BenchmarkLayoutCharge, // two lines charging each other across the field
+	BenchmarkLayoutMelee,  // two lines already in contact
+	BenchmarkLayoutStand,  // two lines standing out of reach
+	BenchmarkLayoutVolley, // two lines standing within missile range
+	BenchmarkLayoutMarch   // two lines marching toward each other from the map edges
+};
+
+
+struct BenchmarkOptions
+{
+	int unitsPerPlayer;
+	int fightersPerUnit;
+	int timeSteps;
+	BenchmarkLayout layout;
+	const char* weapon;
+	unsigned int seed;
+	int threads;
+	SpatialIndex spatialIndex;
+	float influenceTolerance;
+	float aggregateDistance;
+	bool allowSleep;
+
+	BenchmarkOptions();
+};
+
+
+// prints the usage line and the options ParseOptions() takes after the arguments
+void PrintUsage(const char* program, const char* arguments);
+
+// options from argv[first] on, false if one is not known or has no value
+bool ParseOptions(int argc, char* argv[], int first, BenchmarkOptions& options);
+
+const char* GetSpatialIndexName(SpatialIndex spatialIndex);
+
+// a number between 0 and 1 from rand(), for scenes repeated with srand()
+float Random();
+
+// an empty map, or one with a lake across the middle, a ford at its west end and forest south of it
+SimulationState* CreateSimulationState(unsigned int seed, bool lake);
+
+// kata, yari, nagi, bow or arq; melee for kata and yari by turns, otherwise kata, yari, arq and bow
+UnitStats GetBenchmarkUnitStats(const char* weapon, int index);
+
+// player 1's units get extra fighters each, for a battle one side should win
+void DeployArmies(SimulationState* simulationState, int unitsPerPlayer, int fightersPerUnit, BenchmarkLayout layout, const char* weapon, int extraFighters = 0);
+
+// a new state on an empty map with the armies of the options deployed
+SimulationState* CreateBattle(const BenchmarkOptions& options);
+
+
+#endif
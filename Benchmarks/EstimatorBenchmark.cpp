@@ -0,0 +1,119 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#include "BenchmarkBattle.h"
+#include "SimulationEstimator.h"
+
+
+// Estimates the outcome of a battle between two lines of mixed units, one of
+// them a few fighters per unit stronger, and reports the throughput in battles
+// per second. Exits with an error if the estimate differs between a single
+// thread and all threads, or if a battle played out by the estimator differs
+// from the same battle played out on the state it was estimated from.
+
+
+static bool IsSameOutcome(const SimulationOutcome& a, const SimulationOutcome& b)
+{
+	return a.seed == b.seed && a.winner == b.winner && a.time == b.time
+		&& memcmp(a.casualties, b.casualties, sizeof(a.casualties)) == 0;
+}
+
+
+// plays the battle on a copy of the state the way the game would, without snapshots
+static SimulationOutcome PlayBattle(int unitsPerPlayer, int fightersPerUnit, unsigned int seed, float maxTime)
+{
+	SimulationState* simulationState = CreateSimulationState(seed, false);
+	DeployArmies(simulationState, unitsPerPlayer, fightersPerUnit, BenchmarkLayoutCharge, "melee", fightersPerUnit / 10);
+
+	int fighters[3] = { 0, 0, 0 };
+	for (std::map<int, Unit*>::iterator i = simulationState->units.begin(); i != simulationState->units.end(); ++i)
+		fighters[(*i).second->player] += (*i).second->fightersCount;
+
+	SimulationRules simulationRules(simulationState);
+	int endTick = (int)ceilf(maxTime / simulationState->timeStep);
+	while (simulationState->winner == PlayerNone && simulationState->tick < endTick)
+		simulationRules.AdvanceTime(simulationState->timeStep);
+
+	SimulationOutcome result;
+	result.seed = seed;
+	result.winner = simulationState->winner;
+	result.time = simulationState->time;
+	for (std::map<int, Unit*>::iterator i = simulationState->units.begin(); i != simulationState->units.end(); ++i)
+		fighters[(*i).second->player] -= (*i).second->fightersCount;
+	for (int player = PlayerNone; player <= Player2; ++player)
+		result.casualties[player] = fighters[player];
+
+	delete simulationState;
+	return result;
+}
+
+
+static void PrintCasualties(const SimulationEstimate& estimate, Player player)
+{
+	printf("player %d:     %.1f%% wins, casualties mean %.1f, median %d, 10-90%% %d-%d\n",
+		(int)player,
+		100 * estimate.GetProbability(player),
+		estimate.GetMeanCasualties(player),
+		estimate.GetCasualtyQuantile(player, 0.5f),
+		estimate.GetCasualtyQuantile(player, 0.1f),
+		estimate.GetCasualtyQuantile(player, 0.9f));
+}
+
+
+int main(int argc, char* argv[])
+{
+	int battles = argc > 1 ? atoi(argv[1]) : 200;
+	int threads = argc > 2 ? atoi(argv[2]) : 0;
+	int unitsPerPlayer = argc > 3 ? atoi(argv[3]) : 4;
+	int fightersPerUnit = argc > 4 ? atoi(argv[4]) : 40;
+	if (battles <= 0 || threads < 0 || unitsPerPlayer <= 0 || fightersPerUnit <= 0)
+	{
+		printf("usage: %s [battles] [threads, 0 for all cores] [units per player] [fighters per unit]\n", argv[0]);
+		return 1;
+	}
+
+	const unsigned int seed = 1;
+	const float maxTime = 300;
+
+	SimulationState* simulationState = CreateSimulationState(seed, false);
+	DeployArmies(simulationState, unitsPerPlayer, fightersPerUnit, BenchmarkLayoutCharge, "melee", fightersPerUnit / 10);
+
+	taskpool* workers = new taskpool(threads);
+
+	SimulationEstimator estimator(simulationState);
+	estimator.maxTime = maxTime;
+
+	SimulationEstimate serial = estimator.Run(battles, seed);
+	estimator.workers = workers;
+	SimulationEstimate parallel = estimator.Run(battles, seed);
+
+	bool same = true;
+	for (int i = 0; i < battles; ++i)
+		same = same && IsSameOutcome(serial.outcomes[i], parallel.outcomes[i]);
+
+	bool played = true;
+	for (int i = 0; i < std::min(battles, 4); ++i)
+		played = played && IsSameOutcome(parallel.outcomes[i], PlayBattle(unitsPerPlayer, fightersPerUnit, parallel.outcomes[i].seed, maxTime));
+
+	double meanTime = 0;
+	for (const SimulationOutcome& outcome : parallel.outcomes)
+		meanTime += outcome.time / battles;
+
+	printf("battles:      %d, %d x %d fighters per player, %.1f s simulated on average\n", battles, unitsPerPlayer, fightersPerUnit, meanTime);
+	PrintCasualties(parallel, Player1);
+	PrintCasualties(parallel, Player2);
+	printf("undecided:    %.1f%%\n", 100 * parallel.GetProbability(PlayerNone));
+	printf("1 thread:     %.1f battles/s\n", serial.GetBattlesPerSecond());
+	printf("workers:      %.1f battles/s on %d threads, %.2fx, %s\n",
+		parallel.GetBattlesPerSecond(),
+		workers->size(),
+		serial.seconds / parallel.seconds,
+		same ? "same outcomes" : "DIFFERENT outcomes");
+	printf("replayed:     %s\n", played ? "same as playing the state" : "DIFFERS from playing the state");
+
+	delete simulationState;
+	delete workers;
+
+	return same && played ? 0 : 1;
+}
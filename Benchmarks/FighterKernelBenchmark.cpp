@@ -0,0 +1,160 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#include "BenchmarkBattle.h"
+#include "FighterKernels.h"
+
+
+// Times the fighter velocity and position kernels against the per fighter glm
+// code SimulationRules used before them, over units of random sizes so that
+// the vector kernels also run their scalar tails. Exits with an error if a
+// kernel set differs in any bit from the scalar kernels, or if the kernels are
+// off from the glm code by more than float rounding.
+
+
+struct Scene
+{
+	std::vector<int> unitSizes;
+	std::vector<glm::vec2> position;
+	std::vector<glm::vec2> destination;
+	std::vector<glm::vec2> velocity;
+	std::vector<float> speed;
+};
+
+
+static Scene MakeScene(int fighters)
+{
+	Scene result;
+	for (int count = 0; count < fighters; )
+	{
+		int size = std::min(1 + rand() % 100, fighters - count);
+		result.unitSizes.push_back(size);
+		count += size;
+	}
+
+	for (int i = 0; i < fighters; ++i)
+	{
+		glm::vec2 position(1024 * Random(), 1024 * Random());
+
+		// destinations far, within a time step, and close enough to be reached
+		float distance = i % 3 == 0 ? 20 * Random() : i % 3 == 1 ? 0.5f * Random() : 0.1f * Random();
+		float angle = 6.2832f * Random();
+
+		result.position.push_back(position);
+		result.destination.push_back(position + distance * glm::vec2(cosf(angle), sinf(angle)));
+		result.velocity.push_back(glm::vec2(4 * Random() - 2, 4 * Random() - 2));
+		result.speed.push_back(i % 5 == 0 ? 0.75f : 2 + 6 * Random());
+	}
+	return result;
+}
+
+
+static glm::vec2 NextVelocityGlm(glm::vec2 position, glm::vec2 destination, float speed)
+{
+	glm::vec2 diff = destination - position;
+	float diff_len = glm::dot(diff, diff);
+	if (diff_len < 0.01)
+		return diff;
+
+	glm::vec2 delta = glm::normalize(diff) * speed;
+	float delta_len = glm::dot(delta, delta);
+
+	return delta_len < diff_len ? delta : diff;
+}
+
+
+static void RunGlm(const Scene& scene, float timeStep, std::vector<glm::vec2>& velocity, std::vector<glm::vec2>& position)
+{
+	int n = (int)scene.position.size();
+	for (int i = 0; i < n; ++i)
+	{
+		velocity[i] = NextVelocityGlm(scene.position[i], scene.destination[i], scene.speed[i]);
+		position[i] = scene.position[i] + scene.velocity[i] * timeStep;
+	}
+}
+
+
+static void RunKernels(const Scene& scene, FighterKernelSet set, float timeStep, std::vector<glm::vec2>& velocity, std::vector<glm::vec2>& position)
+{
+	int first = 0;
+	for (int size : scene.unitSizes)
+	{
+		FighterKernels::NextVelocity(set, &scene.position[first], &scene.destination[first], &scene.speed[first], &velocity[first], size);
+		FighterKernels::IntegratePosition(set, &scene.position[first], &scene.velocity[first], timeStep, &position[first], size);
+		first += size;
+	}
+}
+
+
+static float GetMaxError(const std::vector<glm::vec2>& a, const std::vector<glm::vec2>& b)
+{
+	float result = 0;
+	for (size_t i = 0; i < a.size(); ++i)
+	{
+		float scale = fmaxf(1, fmaxf(fabsf(b[i].x), fabsf(b[i].y)));
+		result = fmaxf(result, fmaxf(fabsf(a[i].x - b[i].x), fabsf(a[i].y - b[i].y)) / scale);
+	}
+	return result;
+}
+
+
+int main(int argc, char* argv[])
+{
+	int fighters = argc > 1 ? atoi(argv[1]) : 100000;
+	int passes = argc > 2 ? atoi(argv[2]) : 200;
+	if (fighters <= 0 || passes <= 0)
+	{
+		printf("usage: %s [fighters] [passes]\n", argv[0]);
+		return 1;
+	}
+
+	srand(1);
+	Scene scene = MakeScene(fighters);
+	const float timeStep = 1.0f / 15;
+
+	std::vector<glm::vec2> glmVelocity(fighters), glmPosition(fighters);
+	std::vector<glm::vec2> scalarVelocity(fighters), scalarPosition(fighters);
+	std::vector<glm::vec2> velocity(fighters), position(fighters);
+
+	RunGlm(scene, timeStep, glmVelocity, glmPosition);
+	RunKernels(scene, FighterKernelScalar, timeStep, scalarVelocity, scalarPosition);
+
+	printf("fighters:     %d in %d units, %d passes\n", fighters, (int)scene.unitSizes.size(), passes);
+	printf("best set:     %s\n", FighterKernels::GetName(FighterKernels::GetBestSupported()));
+	printf("max error:    %g relative to glm\n", fmaxf(GetMaxError(scalarVelocity, glmVelocity), GetMaxError(scalarPosition, glmPosition)));
+
+	bool failed = GetMaxError(scalarVelocity, glmVelocity) > 1e-6f || GetMaxError(scalarPosition, glmPosition) > 1e-6f;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int pass = 0; pass < passes; ++pass)
+		RunGlm(scene, timeStep, velocity, position);
+	double glmSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("glm:          %.1f M fighters/s\n", fighters * (double)passes / glmSeconds / 1e6);
+
+	for (FighterKernelSet set : { FighterKernelScalar, FighterKernelSSE, FighterKernelAVX2 })
+	{
+		if (!FighterKernels::IsSupported(set))
+		{
+			printf("%-13s not supported\n", (std::string(FighterKernels::GetName(set)) + ":").c_str());
+			continue;
+		}
+
+		start = std::chrono::steady_clock::now();
+		for (int pass = 0; pass < passes; ++pass)
+			RunKernels(scene, set, timeStep, velocity, position);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		bool same = memcmp(velocity.data(), scalarVelocity.data(), fighters * sizeof(glm::vec2)) == 0
+			&& memcmp(position.data(), scalarPosition.data(), fighters * sizeof(glm::vec2)) == 0;
+		failed = failed || !same;
+
+		printf("%-13s %.1f M fighters/s, %.2fx glm, %s\n",
+			(std::string(FighterKernels::GetName(set)) + ":").c_str(),
+			fighters * (double)passes / seconds / 1e6,
+			glmSeconds / seconds,
+			same ? "same as scalar" : "DIFFERS from scalar");
+	}
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,162 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#include "BenchmarkBattle.h"
+#include "SimulationFork.h"
+#include "SimulationSnapshot.h"
+
+
+// Times forking a battle for look-ahead, against cloning the state with its
+// map, and the number of candidate orders that can be evaluated per second on
+// a single core, each played out for a few seconds in a branch. Exits with an
+// error if playing out a branch changes the trunk, or if a branch without
+// orders plays out differently from the trunk.
+
+
+// what a clone cost without a fork, the map copied and classified along with the state
+static SimulationState* CloneState(const SimulationState* simulationState, std::vector<unsigned char>& buffer)
+{
+	SimulationState* result = new SimulationState();
+	const image* map = simulationState->map;
+	result->map = new image(map->_width, map->_height, map->_format);
+	memcpy(result->map->_data, map->_data, map->_width * map->_height * map->components());
+	result->UpdateTerrainGrid();
+
+	SimulationSnapshot::Write(simulationState, buffer);
+	SimulationSnapshot::Restore(buffer.data(), buffer.size(), result);
+	return result;
+}
+
+
+// moves one of player 1's units somewhere around where it is
+static void ApplyCandidate(SimulationState* simulationState, int candidate)
+{
+	std::vector<Unit*> units;
+	for (std::map<int, Unit*>::iterator i = simulationState->units.begin(); i != simulationState->units.end(); ++i)
+		if ((*i).second->player == Player1)
+			units.push_back((*i).second);
+	if (units.empty())
+		return;
+
+	Unit* unit = units[candidate % units.size()];
+	float angle = 0.7854f * (candidate / units.size() % 8);
+	unit->movement.target = nullptr;
+	unit->movement.path.clear();
+	unit->movement.destination = unit->state.center + 40.0f * glm::vec2(cosf(angle), sinf(angle));
+	unit->movement.running = candidate % 2 != 0;
+}
+
+
+static int CountFighters(const SimulationState* simulationState, Player player)
+{
+	int result = 0;
+	for (std::map<int, Unit*>::const_iterator i = simulationState->units.begin(); i != simulationState->units.end(); ++i)
+		if ((*i).second->player == player)
+			result += (*i).second->fightersCount;
+	return result;
+}
+
+
+static double GetMicroseconds(std::chrono::steady_clock::time_point start, int count)
+{
+	return 1e6 * std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / count;
+}
+
+
+int main(int argc, char* argv[])
+{
+	int candidates = argc > 1 ? atoi(argv[1]) : 40;
+	float lookAhead = argc > 2 ? (float)atof(argv[2]) : 3;
+	int unitsPerPlayer = argc > 3 ? atoi(argv[3]) : 10;
+	int fightersPerUnit = argc > 4 ? atoi(argv[4]) : 80;
+	if (candidates <= 0 || lookAhead <= 0 || unitsPerPlayer <= 0 || fightersPerUnit <= 0)
+	{
+		printf("usage: %s [candidates] [look-ahead seconds] [units per player] [fighters per unit]\n", argv[0]);
+		return 1;
+	}
+
+	BenchmarkOptions options;
+	options.unitsPerPlayer = unitsPerPlayer;
+	options.fightersPerUnit = fightersPerUnit;
+	options.weapon = "melee";
+	SimulationState* trunk = CreateBattle(options);
+
+	// into the battle, the first lines in contact
+	SimulationRules* trunkRules = new SimulationRules(trunk);
+	for (int i = 0; i < 300; ++i)
+		trunkRules->AdvanceTime(trunk->timeStep);
+
+	const int forks = 200;
+	std::vector<unsigned char> buffer;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < forks; ++i)
+		delete CloneState(trunk, buffer);
+	double cloneMicroseconds = GetMicroseconds(start, forks);
+
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < forks; ++i)
+	{
+		SimulationFork fork(trunk);
+		delete fork.CreateBranch();
+	}
+	double forkMicroseconds = GetMicroseconds(start, forks);
+
+	SimulationFork fork(trunk);
+	SimulationState* branch = fork.CreateBranch();
+
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < forks; ++i)
+		fork.ResetBranch(branch);
+	double resetMicroseconds = GetMicroseconds(start, forks);
+
+	unsigned long long trunkHash = trunk->CalculateHash();
+	int steps = (int)ceilf(lookAhead / trunk->timeStep);
+
+	start = std::chrono::steady_clock::now();
+	int bestCandidate = -1;
+	int bestScore = 0;
+	for (int candidate = 0; candidate < candidates; ++candidate)
+	{
+		fork.ResetBranch(branch);
+		ApplyCandidate(branch, candidate);
+
+		SimulationRules rules(branch);
+		for (int i = 0; i < steps; ++i)
+			rules.AdvanceTime(branch->timeStep);
+
+		int score = CountFighters(branch, Player1) - CountFighters(branch, Player2);
+		if (bestCandidate == -1 || score > bestScore)
+		{
+			bestCandidate = candidate;
+			bestScore = score;
+		}
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	bool untouched = trunk->CalculateHash() == trunkHash;
+
+	fork.ResetBranch(branch);
+	SimulationRules branchRules(branch);
+	for (int i = 0; i < steps; ++i)
+	{
+		branchRules.AdvanceTime(branch->timeStep);
+		trunkRules->AdvanceTime(trunk->timeStep);
+	}
+	bool same = branch->CalculateHash() == trunk->CalculateHash();
+
+	printf("fighters:     %d + %d at tick %d\n", CountFighters(trunk, Player1), CountFighters(trunk, Player2), trunk->tick - steps);
+	printf("clone:        %.1f us, with the map\n", cloneMicroseconds);
+	printf("fork:         %.1f us, snapshot and first branch\n", forkMicroseconds);
+	printf("reset:        %.1f us per branch\n", resetMicroseconds);
+	printf("look-ahead:   %d candidates of %.1f s, %.1f candidates/s, best %d (%+d fighters)\n",
+		candidates, lookAhead, candidates / seconds, bestCandidate, bestScore);
+	printf("trunk:        %s\n", untouched ? "untouched by the branches" : "CHANGED by the branches");
+	printf("branch:       %s\n", same ? "same as the trunk without orders" : "DIFFERS from the trunk without orders");
+
+	delete branch;
+	delete trunkRules;
+	delete trunk;
+
+	return untouched && same ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#include "BenchmarkBattle.h"
+
+
+// Times the morale influence of every unit on the others, as NextUnitState
+// computes it each time step, with the exact sum and with the influence field,
+// for growing numbers of units spread over the map in clusters, and finds the
+// number of units from which the field is the faster. Exits with an error if
+// any unit's influence is off by more than the tolerance times the sum of
+// absolute weighted masses, which is the field's error bound.
+
+
+static SimulationState* CreateScene(int count)
+{
+	SimulationState* result = CreateSimulationState(1, false);
+
+	glm::vec2 cluster;
+	for (int i = 0; i < count; ++i)
+	{
+		if (i % 20 == 0)
+			cluster = glm::vec2(64 + 896 * Random(), 64 + 896 * Random());
+
+		Player player = i % 2 == 0 ? Player1 : Player2;
+		glm::vec2 position = cluster + glm::vec2(120 * Random() - 60, 120 * Random() - 60);
+		UnitStats stats = SimulationState::GetDefaultUnitStats(UnitPlatformAsh, UnitWeaponYari);
+		stats.trainingLevel = Random();
+
+		Unit* unit = result->AddUnit(player, 1, stats, position);
+		unit->state.center = position;
+		unit->state.morale = 2 * Random() - 1;
+	}
+	return result;
+}
+
+
+// what the field's error is bounded by, the influence with the absolute mass of every unit
+static float GetBound(const SimulationState* simulationState, const Unit* unit)
+{
+	float result = 0;
+	for (std::map<int, Unit*>::const_iterator i = simulationState->units.begin(); i != simulationState->units.end(); ++i)
+	{
+		const Unit* other = (*i).second;
+		if (other->player == unit->player)
+		{
+			float weight = 50.0f / (glm::length(other->state.center - unit->state.center) + 50.0f);
+			result += weight * fabsf((1 - other->state.morale) * other->stats.trainingLevel);
+		}
+	}
+	return (1 - unit->stats.trainingLevel) * result;
+}
+
+
+// microseconds for one time step's influence of all units, repeated for at least 20 ms
+static double TimeInfluence(SimulationRules& simulationRules, const std::vector<Unit*>& units, std::vector<float>& result)
+{
+	int passes = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	double seconds = 0;
+	while (seconds < 0.02)
+	{
+		if (simulationRules.influenceTolerance > 0)
+			simulationRules.BuildInfluenceField();
+		for (size_t i = 0; i < units.size(); ++i)
+			result[i] = simulationRules.NextUnitInfluence(units[i]);
+
+		++passes;
+		seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+	return 1e6 * seconds / passes;
+}
+
+
+int main(int argc, char* argv[])
+{
+	float tolerance = argc > 1 ? (float)atof(argv[1]) : 0.01f;
+	if (tolerance <= 0)
+	{
+		printf("usage: %s [tolerance]\n", argv[0]);
+		return 1;
+	}
+
+	srand(1);
+
+	bool failed = false;
+	int crossover = 0;
+
+	printf("tolerance %g\n\n", tolerance);
+	printf("%8s %14s %14s %14s\n", "units", "exact us", "field us", "max error");
+
+	for (int count = 25; count <= 3200; count *= 2)
+	{
+		SimulationState* simulationState = CreateScene(count);
+		SimulationRules simulationRules(simulationState);
+
+		std::vector<Unit*> units;
+		for (std::map<int, Unit*>::iterator i = simulationState->units.begin(); i != simulationState->units.end(); ++i)
+			units.push_back((*i).second);
+
+		std::vector<float> exact(count);
+		std::vector<float> approximate(count);
+
+		simulationRules.influenceTolerance = 0;
+		double exactMicroseconds = TimeInfluence(simulationRules, units, exact);
+
+		simulationRules.influenceTolerance = tolerance;
+		double fieldMicroseconds = TimeInfluence(simulationRules, units, approximate);
+
+		// error relative to the bound, so 1 means the error is exactly at the tolerance
+		float maxError = 0;
+		for (int i = 0; i < count; ++i)
+		{
+			float bound = GetBound(simulationState, units[i]);
+			float error = fabsf(approximate[i] - exact[i]) / (tolerance * bound + 1e-6f * bound + 1e-12f);
+			maxError = fmaxf(maxError, error);
+		}
+
+		if (crossover == 0 && fieldMicroseconds < exactMicroseconds)
+			crossover = count;
+
+		printf("%8d %14.1f %14.1f %13.3f%s\n", count, exactMicroseconds, fieldMicroseconds, maxError, maxError > 1 ? "  FAILED" : "");
+
+		if (maxError > 1)
+			failed = true;
+
+		delete simulationState;
+	}
+
+	if (crossover != 0)
+		printf("\nthe field is faster from %d units\n", crossover);
+	else
+		printf("\nthe exact sum is faster at every size\n");
+
+	return failed ? 1 : 0;
+}
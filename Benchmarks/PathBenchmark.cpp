@@ -0,0 +1,141 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#include "BenchmarkBattle.h"
+
+
+// Orders units across a map with a lake in the way to one hill on the far
+// side, and times the paths planned around the lake against the searches they
+// share. Then plays the march out with planned and with straight paths and
+// counts the fighter time steps spent in impassable water. Exits with an error
+// if a planned path crosses impassable water, or if the units sharing a
+// destination area do not share its search.
+
+
+static void DeployUnits(SimulationState* simulationState, int units, int fightersPerUnit)
+{
+	for (int i = 0; i < units; ++i)
+	{
+		UnitPlatform platform = i % 3 == 0 ? UnitPlatformCav : UnitPlatformAsh;
+		UnitStats stats = SimulationState::GetDefaultUnitStats(platform, platform == UnitPlatformCav ? UnitWeaponYari : UnitWeaponArq);
+		float x = 250 + 520 * (i % 10) / 9.0f;
+		float y = 740 + 24 * (i / 10);
+		simulationState->AddUnit(Player1, fightersPerUnit, stats, glm::vec2(x, y));
+	}
+}
+
+
+// the hill, a patch of twenty meters on the far side of the lake
+static glm::vec2 GetHillPosition(int i)
+{
+	return glm::vec2(300 + 20 * ((i * 7) % 10) / 9.0f, 250 + 20 * ((i * 3) % 10) / 9.0f);
+}
+
+
+static bool CrossesWater(const SimulationState* simulationState, const std::vector<glm::vec2>& path, glm::vec2 position)
+{
+	glm::vec2 p = position;
+	for (glm::vec2 point : path)
+	{
+		if (!PathPlanner::IsClear(simulationState->terrainGrid, p, point))
+			return true;
+		p = point;
+	}
+	return false;
+}
+
+
+static void OrderUnits(SimulationState* simulationState, bool planned)
+{
+	int i = 0;
+	for (std::map<int, Unit*>::iterator u = simulationState->units.begin(); u != simulationState->units.end(); ++u, ++i)
+	{
+		Unit* unit = (*u).second;
+		glm::vec2 destination = GetHillPosition(i);
+		unit->movement.path.clear();
+		MovementRules::UpdateMovementPath(planned ? simulationState : nullptr, unit, unit->movement.path, unit->state.center, destination, 0);
+		unit->movement.destination = destination;
+	}
+}
+
+
+static SimulationState* CreateMarch(int units, int fightersPerUnit)
+{
+	SimulationState* result = CreateSimulationState(1, true);
+	DeployUnits(result, units, fightersPerUnit);
+	return result;
+}
+
+
+static long long MarchUnits(SimulationState* simulationState, int timeSteps)
+{
+	long long result = 0;
+	SimulationRules simulationRules(simulationState);
+	for (int i = 0; i < timeSteps; ++i)
+	{
+		simulationRules.AdvanceTime(simulationState->timeStep);
+		for (std::map<int, Unit*>::iterator u = simulationState->units.begin(); u != simulationState->units.end(); ++u)
+		{
+			Unit* unit = (*u).second;
+			for (Fighter* fighter = unit->fighters, * end = fighter + unit->fightersCount; fighter != end; ++fighter)
+				if (simulationState->IsImpassable(fighter->GetPosition()))
+					++result;
+		}
+	}
+	return result;
+}
+
+
+int main(int argc, char* argv[])
+{
+	int units = argc > 1 ? atoi(argv[1]) : 100;
+	int timeSteps = argc > 2 ? atoi(argv[2]) : 1500;
+	if (units <= 0 || timeSteps <= 0)
+	{
+		printf("usage: %s [units] [time steps]\n", argv[0]);
+		return 1;
+	}
+
+	SimulationState* simulationState = CreateMarch(units, 4);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	OrderUnits(simulationState, true);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	int searches = simulationState->pathPlanner.GetSearchCount();
+
+	start = std::chrono::steady_clock::now();
+	OrderUnits(simulationState, true);
+	double cachedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	int crossing = 0;
+	size_t points = 0;
+	for (std::map<int, Unit*>::iterator u = simulationState->units.begin(); u != simulationState->units.end(); ++u)
+	{
+		if (CrossesWater(simulationState, (*u).second->movement.path, (*u).second->state.center))
+			++crossing;
+		points += (*u).second->movement.path.size();
+	}
+
+	// one field per platform speed in forest and destination area, the hill spans two areas at most each way
+	bool shared = searches <= 2 * 4 && simulationState->pathPlanner.GetSearchCount() == searches;
+
+	delete simulationState;
+
+	simulationState = CreateMarch(units, 40);
+	OrderUnits(simulationState, true);
+	long long plannedInWater = MarchUnits(simulationState, timeSteps);
+	delete simulationState;
+
+	simulationState = CreateMarch(units, 40);
+	OrderUnits(simulationState, false);
+	long long straightInWater = MarchUnits(simulationState, timeSteps);
+	delete simulationState;
+
+	printf("units:        %d ordered to one hill across a lake\n", units);
+	printf("searches:     %d flow fields, %.2f ms per unit, %.3f ms per unit cached\n", searches, 1000 * seconds / units, 1000 * cachedSeconds / units);
+	printf("paths:        %.1f points on average, %d crossing water\n", (double)points / units, crossing);
+	printf("in water:     %lld fighter time steps planned, %lld straight\n", plannedInWater, straightInWater);
+
+	return crossing == 0 && shared ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#include "BenchmarkBattle.h"
+
+
+// Sends units after enemies on the far side of a lake, so that every unit asks
+// for a path around it, and times the longest time steps with the paths
+// searched when due and searched on a background thread. The battle pauses
+// between time steps as it does between frames in the game, which is when the
+// thread searches. Exits with an error if the battle differs between the two.
+
+
+static SimulationState* CreateLakeBattle(int units)
+{
+	SimulationState* result = CreateSimulationState(1, true);
+
+	std::vector<Unit*> units1;
+	std::vector<Unit*> units2;
+	for (int i = 0; i < units; ++i)
+	{
+		UnitStats stats = SimulationState::GetDefaultUnitStats(UnitPlatformSam, UnitWeaponKata);
+		float x = 250 + 520 * (i % 10) / 9.0f;
+		units1.push_back(result->AddUnit(Player1, 40, stats, glm::vec2(x, 740 + 30 * (i / 10))));
+		units2.push_back(result->AddUnit(Player2, 40, stats, glm::vec2(x, 300 - 30 * (i / 10))));
+	}
+
+	// each after the enemy across the lake, spread over areas that need searches of their own
+	for (int i = 0; i < units; ++i)
+		units1[i]->movement.target = units2[(i * 7) % units];
+
+	return result;
+}
+
+
+struct PathJobResult
+{
+	double meanMilliseconds;
+	double maxMilliseconds;
+	unsigned long long hash;
+	int waits;
+};
+
+
+static PathJobResult RunBattle(int units, int timeSteps, int pause, bool background)
+{
+	SimulationState* simulationState = CreateLakeBattle(units);
+	PathJobQueue* pathJobs = background ? new PathJobQueue() : nullptr;
+
+	SimulationRules simulationRules(simulationState);
+	simulationRules.pathJobs = pathJobs;
+
+	PathJobResult result;
+	result.maxMilliseconds = 0;
+	double seconds = 0;
+	for (int i = 0; i < timeSteps; ++i)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		simulationRules.AdvanceTime(simulationState->timeStep);
+		double milliseconds = 1000 * std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		seconds += milliseconds / 1000;
+		result.maxMilliseconds = std::max(result.maxMilliseconds, milliseconds);
+
+		std::this_thread::sleep_for(std::chrono::microseconds(pause));
+	}
+
+	result.meanMilliseconds = 1000 * seconds / timeSteps;
+	result.hash = simulationState->CalculateHash();
+	result.waits = pathJobs != nullptr ? pathJobs->GetWaitCount() : 0;
+
+	delete pathJobs;
+	delete simulationState;
+	return result;
+}
+
+
+int main(int argc, char* argv[])
+{
+	int units = argc > 1 ? atoi(argv[1]) : 40;
+	int timeSteps = argc > 2 ? atoi(argv[2]) : 150;
+	int pause = argc > 3 ? atoi(argv[3]) : 50000;
+	if (units <= 0 || timeSteps <= 0 || pause < 0)
+	{
+		printf("usage: %s [units per player] [time steps] [pause microseconds]\n", argv[0]);
+		return 1;
+	}
+
+	PathJobResult due = RunBattle(units, timeSteps, pause, false);
+	PathJobResult background = RunBattle(units, timeSteps, pause, true);
+
+	printf("units:        %d after enemies across a lake, %d time steps %d us apart\n", units, timeSteps, pause);
+	printf("when due:     %.2f ms per time step, %.2f ms longest\n", due.meanMilliseconds, due.maxMilliseconds);
+	printf("background:   %.2f ms per time step, %.2f ms longest, %d waits for a search\n", background.meanMilliseconds, background.maxMilliseconds, background.waits);
+	printf("battle:       %s\n", due.hash == background.hash ? "same either way" : "DIFFERS with background searches");
+
+	return due.hash == background.hash ? 0 : 1;
+}
@@ -0,0 +1,176 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#include "BenchmarkBattle.h"
+#include "SimulationRecorder.h"
+#include "SimulationReplay.h"
+
+
+// Runs a battle log written by SimulationRecorder at maximum speed, checking the
+// state hash after every time step when the log has them. The record command
+// writes a scripted battle to a log, for trying this out without the app, and
+// takes the battle options; the replay command takes the threads and index.
+//
+//   ReplayBenchmark record battle.owrl
+//   ReplayBenchmark replay battle.owrl
+
+
+static Unit* FindUnit(SimulationState* simulationState, Player player, int index)
+{
+	for (std::map<int, Unit*>::iterator i = simulationState->units.begin(); i != simulationState->units.end(); ++i)
+		if ((*i).second->player == player && index-- == 0)
+			return (*i).second;
+	return nullptr;
+}
+
+
+// the kind of orders a player gives: advance, run, charge a unit, pick a missile target
+static void GiveCommands(SimulationState* simulationState, int unitsPerPlayer)
+{
+	int tick = simulationState->tick;
+	if (tick % 45 != 0)
+		return;
+
+	int index = (tick / 45) % unitsPerPlayer;
+	Player player = (tick / 45) % 2 == 0 ? Player1 : Player2;
+	Unit* unit = FindUnit(simulationState, player, index);
+	Unit* enemy = FindUnit(simulationState, Opponent(player), unitsPerPlayer - 1 - index);
+	if (unit == nullptr || enemy == nullptr)
+		return;
+
+	if (unit->stats.maximumRange > 0)
+	{
+		unit->missileTarget = enemy;
+		unit->missileTargetLocked = true;
+		unit->movement.direction = angle(enemy->state.center - unit->state.center);
+	}
+	else if ((tick / 90) % 2 == 0)
+	{
+		unit->movement.target = enemy;
+		unit->movement.destination = enemy->state.center;
+		unit->movement.running = true;
+	}
+	else
+	{
+		glm::vec2 destination = (unit->state.center + enemy->state.center) / 2.0f;
+		unit->movement.target = nullptr;
+		unit->movement.path.clear();
+		unit->movement.path.push_back(destination);
+		unit->movement.destination = destination;
+		unit->movement.running = false;
+	}
+
+	unit->timeUntilSwapFighters = 0.2f;
+}
+
+
+static int Record(const char* path, const BenchmarkOptions& options)
+{
+	SimulationState* simulationState = CreateBattle(options);
+
+	SimulationRecorder recorder(simulationState, true);
+	SimulationRules* simulationRules = new SimulationRules(simulationState);
+	simulationRules->recorder = &recorder;
+
+	for (int i = 0; i < options.timeSteps; ++i)
+	{
+		GiveCommands(simulationState, options.unitsPerPlayer);
+		simulationRules->AdvanceTime(simulationState->timeStep);
+	}
+
+	bool saved = recorder.Save(path);
+	printf("%s: %d time steps, %d units, %d bytes\n",
+			path,
+			simulationState->tick,
+			2 * options.unitsPerPlayer,
+			(int)recorder.GetLog().size());
+
+	delete simulationRules;
+	delete simulationState;
+
+	return saved ? 0 : 1;
+}
+
+
+static int Replay(const char* path, int threads, SpatialIndex spatialIndex)
+{
+	SimulationReplay replay;
+	if (!replay.Load(path))
+	{
+		printf("%s: not a valid battle log\n", path);
+		return 1;
+	}
+
+	SimulationState* simulationState = replay.CreateSimulationState();
+	taskpool* workers = threads != 1 ? new taskpool(threads) : nullptr;
+
+	SimulationRules* simulationRules = new SimulationRules(simulationState);
+	simulationRules->workers = workers;
+	simulationRules->spatialIndex = spatialIndex;
+
+	int lastTick = replay.GetLastTick();
+	int checked = 0;
+	int firstMismatch = -1;
+	double seconds = 0;
+
+	while (simulationState->tick < lastTick)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		replay.ApplyCommands(simulationState);
+		simulationRules->AdvanceTime(simulationState->timeStep);
+		seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		unsigned long long hash;
+		if (replay.GetHash(simulationState->tick, hash))
+		{
+			++checked;
+			if (firstMismatch == -1 && hash != simulationState->CalculateHash())
+				firstMismatch = simulationState->tick;
+		}
+	}
+
+	printf("log:          %s\n", path);
+	printf("units:        %d\n", (int)simulationState->units.size());
+	printf("commands:     %d\n", replay.GetCommandCount());
+	printf("time steps:   %d (%.1f s simulated)\n", simulationState->tick, simulationState->time);
+	printf("wall time:    %.3f s\n", seconds);
+	printf("ticks/second: %.1f\n", simulationState->tick / seconds);
+	if (!replay.HasHashes())
+		printf("hashes:       none in log\n");
+	else if (firstMismatch == -1)
+		printf("hashes:       %d checked, all match\n", checked);
+	else
+		printf("hashes:       %d checked, first mismatch at tick %d\n", checked, firstMismatch);
+
+	delete simulationRules;
+	delete simulationState;
+	delete workers;
+
+	return firstMismatch == -1 ? 0 : 1;
+}
+
+
+int main(int argc, char* argv[])
+{
+	BenchmarkOptions options;
+	options.unitsPerPlayer = 16;
+	options.timeSteps = 2000;
+	if (argc < 3 || !ParseOptions(argc, argv, 3, options))
+	{
+		PrintUsage(argv[0], "record|replay <log> ");
+		return 1;
+	}
+
+	const char* command = argv[1];
+	const char* path = argv[2];
+
+	if (strcmp(command, "record") == 0)
+		return Record(path, options);
+
+	if (strcmp(command, "replay") == 0)
+		return Replay(path, options.threads, options.spatialIndex);
+
+	PrintUsage(argv[0], "record|replay <log> ");
+	return 1;
+}
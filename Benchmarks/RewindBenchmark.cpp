@@ -0,0 +1,117 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#include "BenchmarkBattle.h"
+#include "SimulationHistory.h"
+
+
+// Plays a battle with SimulationHistory attached and reports what keeping the
+// history costs per tick, how much memory it holds and how long rewinding to a
+// tick takes. Every rewound state is checked against the state hash recorded
+// when the tick was first simulated, and so is the start of the battle, which
+// is kept when the memory budget drops older ticks.
+
+
+static double Simulate(SimulationRules* simulationRules, SimulationState* simulationState, int timeSteps, std::vector<unsigned long long>* hashes)
+{
+	double seconds = 0;
+	for (int i = 0; i < timeSteps; ++i)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		simulationRules->AdvanceTime(simulationState->timeStep);
+		seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		if (hashes != nullptr)
+		{
+			hashes->resize(simulationState->tick + 1);
+			(*hashes)[simulationState->tick] = simulationState->CalculateHash();
+		}
+	}
+	return seconds;
+}
+
+
+int main(int argc, char* argv[])
+{
+	int unitsPerPlayer = argc > 1 ? atoi(argv[1]) : 32;
+	int timeSteps = argc > 2 ? atoi(argv[2]) : 1500;
+	int budget = argc > 3 ? atoi(argv[3]) : 64; // megabytes
+	int interval = argc > 4 ? atoi(argv[4]) : 75;
+	if (unitsPerPlayer <= 0 || timeSteps <= 0 || budget <= 0 || interval <= 0)
+	{
+		printf("usage: %s [units per player] [time steps] [memory budget MB] [keyframe interval]\n", argv[0]);
+		return 1;
+	}
+
+	BenchmarkOptions options;
+	options.unitsPerPlayer = unitsPerPlayer;
+
+	// without history, for the baseline cost of a tick
+	SimulationState* simulationState = CreateBattle(options);
+	SimulationRules* simulationRules = new SimulationRules(simulationState);
+	double baseline = Simulate(simulationRules, simulationState, timeSteps, nullptr);
+	delete simulationRules;
+	delete simulationState;
+
+	simulationState = CreateBattle(options);
+	simulationRules = new SimulationRules(simulationState);
+	SimulationHistory history((size_t)budget << 20, interval);
+	simulationRules->history = &history;
+
+	std::vector<unsigned long long> hashes;
+	unsigned long long startHash = simulationState->CalculateHash();
+	double seconds = Simulate(simulationRules, simulationState, timeSteps, &hashes);
+
+	int first = history.GetFirstTick();
+	int last = history.GetLastTick();
+	int retained = last - first + 1;
+
+	printf("fighters:     %d slots\n", simulationState->fighterStore.size);
+	printf("time steps:   %d\n", timeSteps);
+	printf("tick:         %.3f ms, %.3f ms with history\n", 1000 * baseline / timeSteps, 1000 * seconds / timeSteps);
+	printf("memory:       %.1f of %d MB\n", history.GetMemoryUsed() / 1048576.0, budget);
+	printf("retained:     ticks %d to %d, %d keyframes every %d ticks\n", first, last, history.GetKeyframeCount(), interval);
+	printf("per tick:     %.1f KB\n", history.GetMemoryUsed() / 1024.0 / retained);
+
+	// rewind to ticks spread over the retained range, latest first
+	bool failed = false;
+	double worst = 0;
+	double total = 0;
+	int rewinds = 0;
+	for (int tick = last; tick >= first; tick -= std::max(1, retained / 37))
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		bool restored = simulationRules->Rewind(tick);
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		worst = std::max(worst, elapsed);
+		total += elapsed;
+		++rewinds;
+
+		if (!restored || simulationState->tick != tick || simulationState->CalculateHash() != hashes[tick])
+		{
+			printf("rewind to tick %d: %s\n", tick, restored ? "DIFFERENT state" : "FAILED");
+			failed = true;
+		}
+	}
+
+	printf("rewind:       %.3f ms average, %.3f ms worst, %d rewinds\n", 1000 * total / rewinds, 1000 * worst, rewinds);
+
+	// the start is kept when the budget drops older ticks, for the Rewind button
+	bool kept = history.GetStartTick() == 0 && simulationRules->Rewind(0) && simulationState->CalculateHash() == startHash;
+	printf("start:        %s\n", kept ? "same as the first time" : "LOST or DIFFERENT");
+	failed = failed || !kept;
+
+	// rewind halfway and play on, the battle must end up where it did the first time
+	int middle = (first + last) / 2;
+	simulationRules->Rewind(middle);
+	Simulate(simulationRules, simulationState, last - middle, nullptr);
+	bool same = simulationState->tick == last && simulationState->CalculateHash() == hashes[last];
+	printf("replayed:     %s\n", same ? "same as the first time" : "DIFFERENT from the first time");
+	failed = failed || !same;
+
+	delete simulationRules;
+	delete simulationState;
+
+	return failed ? 1 : 0;
+}
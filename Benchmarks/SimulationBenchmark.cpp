@@ -0,0 +1,91 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#include "BenchmarkBattle.h"
+
+#include <sys/resource.h>
+
+
+static int CountFighters(SimulationState* simulationState)
+{
+	int result = 0;
+	for (std::map<int, Unit*>::iterator i = simulationState->units.begin(); i != simulationState->units.end(); ++i)
+		result += (*i).second->fightersCount;
+	return result;
+}
+
+
+static long GetPeakMemoryKilobytes()
+{
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#ifdef __APPLE__
+	return usage.ru_maxrss / 1024;
+#else
+	return usage.ru_maxrss;
+#endif
+}
+
+
+int main(int argc, char* argv[])
+{
+	BenchmarkOptions options;
+	if (!ParseOptions(argc, argv, 1, options))
+	{
+		PrintUsage(argv[0], "");
+		return 1;
+	}
+
+	SimulationState* simulationState = CreateBattle(options);
+
+	taskpool* workers = options.threads != 1 ? new taskpool(options.threads) : nullptr;
+
+	SimulationProfile profile;
+	SimulationRules* simulationRules = new SimulationRules(simulationState);
+	simulationRules->profile = &profile;
+	simulationRules->workers = workers;
+	simulationRules->spatialIndex = options.spatialIndex;
+	simulationRules->influenceTolerance = options.influenceTolerance;
+	simulationRules->aggregateDistance = options.aggregateDistance;
+	simulationRules->allowSleep = options.allowSleep;
+
+	int fightersBefore = CountFighters(simulationState);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < options.timeSteps; ++i)
+		simulationRules->AdvanceTime(simulationState->timeStep);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	int fightersAfter = CountFighters(simulationState);
+	double total = profile.GetTotalSeconds();
+
+	printf("units:        %d x 2\n", options.unitsPerPlayer);
+	printf("threads:      %d\n", workers != nullptr ? workers->size() : 1);
+	printf("index:        %s\n", GetSpatialIndexName(options.spatialIndex));
+	printf("fighters:     %d -> %d\n", fightersBefore, fightersAfter);
+	printf("time steps:   %d (%.1f s simulated)\n", profile.timeSteps, simulationState->time);
+	printf("wall time:    %.3f s\n", seconds);
+	printf("ticks/second: %.1f\n", profile.timeSteps / seconds);
+	printf("peak memory:  %ld KB\n", GetPeakMemoryKilobytes());
+	printf("asleep:       %.0f of %.0f fighters per tick\n",
+			(double)profile.fightersAsleep / profile.timeSteps,
+			(double)profile.fighters / profile.timeSteps);
+	printf("\n");
+	printf("%-28s %12s %8s\n", "phase", "ms/tick", "share");
+	for (int i = 0; i < SimulationPhaseCount; ++i)
+	{
+		SimulationPhase phase = (SimulationPhase)i;
+		printf("%-28s %12.4f %7.1f%%\n",
+				SimulationProfile::GetPhaseName(phase),
+				1000 * profile.seconds[i] / profile.timeSteps,
+				total > 0 ? 100 * profile.seconds[i] / total : 0);
+	}
+
+	delete simulationRules;
+	delete simulationState;
+	delete workers;
+
+	return 0;
+}
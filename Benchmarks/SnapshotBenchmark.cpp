@@ -0,0 +1,132 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#include "BenchmarkBattle.h"
+#include "SimulationSnapshot.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+// Times SimulationSnapshot::Write() and Restore() for a battle in progress, and
+// checks that a restored battle goes on exactly like the original: once when
+// restored into a new state mapped from a file, and once when rewinding the
+// original state to an earlier tick.
+
+
+static void Simulate(SimulationRules* simulationRules, SimulationState* simulationState, int timeSteps)
+{
+	for (int i = 0; i < timeSteps; ++i)
+		simulationRules->AdvanceTime(simulationState->timeStep);
+}
+
+
+static bool SaveFile(const char* path, const std::vector<unsigned char>& data)
+{
+	FILE* file = fopen(path, "wb");
+	if (file == nullptr)
+		return false;
+
+	bool result = fwrite(data.data(), 1, data.size(), file) == data.size();
+	return fclose(file) == 0 && result;
+}
+
+
+int main(int argc, char* argv[])
+{
+	int unitsPerPlayer = argc > 1 ? atoi(argv[1]) : 63;
+	int fightersPerUnit = argc > 2 ? atoi(argv[2]) : 80;
+	const char* path = argc > 3 ? argv[3] : "/tmp/openwar-snapshot.owss";
+	if (unitsPerPlayer <= 0 || fightersPerUnit <= 0)
+	{
+		printf("usage: %s [units per player] [fighters per unit] [snapshot file]\n", argv[0]);
+		return 1;
+	}
+
+	BenchmarkOptions options;
+	options.unitsPerPlayer = unitsPerPlayer;
+	options.fightersPerUnit = fightersPerUnit;
+
+	SimulationState* simulationState = CreateBattle(options);
+	SimulationRules* simulationRules = new SimulationRules(simulationState);
+
+	// into melee, with casualties and projectiles in flight
+	Simulate(simulationRules, simulationState, 300);
+
+	std::vector<unsigned char> snapshot;
+	const int iterations = 100;
+
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i)
+		SimulationSnapshot::Write(simulationState, snapshot);
+	std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+
+	// restoring over the same tick exercises the in-place path used for rewinding
+	for (int i = 0; i < iterations; ++i)
+		SimulationSnapshot::Restore(snapshot.data(), snapshot.size(), simulationState);
+	std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+	simulationRules->ResetSpatialIndex();
+
+	int fighters = 0;
+	for (std::map<int, Unit*>::iterator i = simulationState->units.begin(); i != simulationState->units.end(); ++i)
+		fighters += (*i).second->fightersCount;
+
+	printf("units:        %d\n", (int)simulationState->units.size());
+	printf("fighters:     %d (%d slots)\n", fighters, simulationState->fighterStore.size);
+	printf("tick:         %d\n", simulationState->tick);
+	printf("size:         %d bytes\n", (int)snapshot.size());
+	printf("write:        %.1f us\n", 1e6 * std::chrono::duration<double>(t1 - t0).count() / iterations);
+	printf("restore:      %.1f us\n", 1e6 * std::chrono::duration<double>(t2 - t1).count() / iterations);
+
+	bool failed = false;
+
+	// restore from a mapped file into a new state and compare with the original
+	if (!SaveFile(path, snapshot))
+	{
+		printf("%s: could not write snapshot\n", path);
+		return 1;
+	}
+
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+	fstat(fd, &st);
+	void* mapped = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	SimulationState* restoredState = CreateSimulationState(options.seed, false);
+	std::chrono::steady_clock::time_point t3 = std::chrono::steady_clock::now();
+	bool restored = mapped != MAP_FAILED && SimulationSnapshot::Restore((const unsigned char*)mapped, (size_t)st.st_size, restoredState);
+	std::chrono::steady_clock::time_point t4 = std::chrono::steady_clock::now();
+	if (mapped != MAP_FAILED)
+		munmap(mapped, (size_t)st.st_size);
+	close(fd);
+
+	printf("mapped:       %.1f us\n", 1e6 * std::chrono::duration<double>(t4 - t3).count());
+
+	SimulationRules* restoredRules = new SimulationRules(restoredState);
+	Simulate(simulationRules, simulationState, 200);
+	Simulate(restoredRules, restoredState, 200);
+
+	bool same = restored && simulationState->CalculateHash() == restoredState->CalculateHash();
+	printf("copy:         %s\n", same ? "same as original after 200 ticks" : "DIFFERENT from original");
+	failed = failed || !same;
+
+	// rewind the original to the snapshot and play the same ticks again
+	unsigned long long hash = simulationState->CalculateHash();
+	SimulationSnapshot::Restore(snapshot.data(), snapshot.size(), simulationState);
+	simulationRules->ResetSpatialIndex();
+	Simulate(simulationRules, simulationState, 200);
+
+	same = simulationState->CalculateHash() == hash;
+	printf("rewind:       %s\n", same ? "same as before after 200 ticks" : "DIFFERENT from before");
+	failed = failed || !same;
+
+	delete restoredRules;
+	delete restoredState;
+	delete simulationRules;
+	delete simulationState;
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,119 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#include "quadtree.h"
+#include "spatialgrid.h"
+
+
+// Compares quadtree and spatialgrid on a dense melee scene: two blocks of
+// fighters pressed together at roughly one fighter per square meter, queried
+// with the fixed radii used by NextFighterPosition and FindFighterStrikingTarget.
+// The quadtree is measured both with incremental insert() and with bulk build().
+
+
+struct Point
+{
+	float x, y;
+};
+
+
+static std::vector<Point> MakeMeleeScene(int count, unsigned int seed)
+{
+	srand(seed);
+
+	std::vector<Point> result;
+	int files = (int)sqrtf((float)count);
+	for (int i = 0; i < count; ++i)
+	{
+		float jitterX = 0.3f * ((rand() & 0x7FFF) / (float)0x7FFF - 0.5f);
+		float jitterY = 0.3f * ((rand() & 0x7FFF) / (float)0x7FFF - 0.5f);
+		Point p;
+		p.x = 512 - files / 2 + (float)(i % files) * 1.0f + jitterX;
+		p.y = 512 - files / 2 + (float)(i / files) * 1.0f + jitterY;
+		result.push_back(p);
+	}
+	return result;
+}
+
+
+template <class Index> static void Fill(Index& index, const std::vector<Point>& points)
+{
+	for (int i = 0; i < (int)points.size(); ++i)
+		index.insert(points[i].x, points[i].y, i);
+}
+
+
+static void FillBulk(quadtree<int>& index, const std::vector<Point>& points)
+{
+	for (int i = 0; i < (int)points.size(); ++i)
+		index.add(points[i].x, points[i].y, i);
+	index.build();
+}
+
+
+template <class Index> static void RunBenchmark(const char* name, Index& index, void (*fill)(Index&, const std::vector<Point>&), const std::vector<Point>& points, int rounds)
+{
+	static const float radii[] = { 0.75f, 0.9f, 1.1f };
+
+	double buildSeconds = 0;
+	double querySeconds = 0;
+	long found = 0;
+	long queries = 0;
+
+	for (int round = 0; round < rounds; ++round)
+	{
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+
+		index.clear();
+		fill(index, points);
+
+		std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < (int)points.size(); ++i)
+		{
+			for (float radius : radii)
+			{
+				for (typename Index::iterator j(index.find(points[i].x, points[i].y, radius)); *j; ++j)
+					++found;
+				++queries;
+			}
+		}
+
+		std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+
+		buildSeconds += std::chrono::duration<double>(t1 - t0).count();
+		querySeconds += std::chrono::duration<double>(t2 - t1).count();
+	}
+
+	printf("%-14s %12.3f %12.1f %14ld\n",
+			name,
+			1000 * buildSeconds / rounds,
+			1e9 * querySeconds / queries,
+			found / rounds);
+}
+
+
+int main(int argc, char* argv[])
+{
+	int count = argc > 1 ? atoi(argv[1]) : 20000;
+	int rounds = argc > 2 ? atoi(argv[2]) : 20;
+	if (count <= 0 || rounds <= 0)
+	{
+		printf("usage: %s [fighters] [rounds]\n", argv[0]);
+		return 1;
+	}
+
+	std::vector<Point> points = MakeMeleeScene(count, 1);
+
+	quadtree<int> tree(0, 0, 1024, 1024);
+	spatialgrid<int> grid(0, 0, 1024, 1024, 2);
+
+	printf("%d fighters, %d rounds\n\n", count, rounds);
+	printf("%-14s %12s %12s %14s\n", "index", "build ms", "ns/query", "hits/round");
+	RunBenchmark("quadtree", tree, Fill<quadtree<int>>, points, rounds);
+	RunBenchmark("quadtree bulk", tree, FillBulk, points, rounds);
+	RunBenchmark("grid", grid, Fill<spatialgrid<int>>, points, rounds);
+
+	return 0;
+}
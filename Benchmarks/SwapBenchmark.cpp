@@ -0,0 +1,256 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#include "BenchmarkBattle.h"
+
+
+// Times swapping the fighters of a large unit into files and ranks, as the unit
+// wheels to a new direction and again once it has formed up facing it and its
+// fighters have stopped moving, against sorting them all over as swapping used
+// to. Exits with an error if a swap leaves a fighter out of its file or rank, if
+// swapping allocates memory once the unit has swapped before, or if swapping a
+// formed up unit moves more than one fighter in a hundred.
+
+
+static long long allocations = 0;
+
+
+// not inlined, so that the compiler does not see malloc() and free() paired with new and delete
+__attribute__((noinline)) void* operator new(size_t size)
+{
+	++allocations;
+	void* result = malloc(size != 0 ? size : 1);
+	if (result == nullptr)
+		throw std::bad_alloc();
+	return result;
+}
+
+
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+
+struct FighterPos
+{
+	Fighter* fighter;
+	FighterState state;
+	FighterHandle handle;
+	glm::vec2 pos;
+};
+
+
+static bool SortLeftToRight(const FighterPos& v1, const FighterPos& v2) { return v1.pos.y > v2.pos.y; }
+static bool SortFrontToBack(const FighterPos& v1, const FighterPos& v2) { return v1.pos.x > v2.pos.x; }
+
+
+// how swapping used to work, every fighter rotated, sorted and copied
+static void SortFighters(Unit* unit)
+{
+	std::vector<FighterPos> fighters;
+
+	float direction = unit->formation._direction;
+
+	Fighter* fightersEnd = unit->fighters + unit->fightersCount;
+
+	for (Fighter* fighter = unit->fighters; fighter != fightersEnd; ++fighter)
+	{
+		FighterPos fighterPos;
+		fighterPos.fighter = fighter;
+		fighterPos.state = fighter->GetState();
+		fighterPos.handle = fighter->store->handle[fighter->slot];
+		fighterPos.pos = rotate(fighterPos.state.position, -direction);
+		fighters.push_back(fighterPos);
+	}
+
+	std::sort(fighters.begin(), fighters.end(), SortLeftToRight);
+
+	int index = 0;
+	while (index < unit->fightersCount)
+	{
+		int count = unit->fightersCount - index;
+		if (count > unit->formation.numberOfRanks)
+			count = unit->formation.numberOfRanks;
+
+		std::vector<FighterPos>::iterator begin = fighters.begin() + index;
+		std::sort(begin, begin + count, SortFrontToBack);
+		while (count-- != 0)
+		{
+			Fighter* fighter = unit->fighters + index;
+			fighter->SetState(fighters[index].state);
+			fighter->store->SetHandle(fighter->slot, fighters[index].handle);
+			++index;
+		}
+	}
+}
+
+
+// every file is to the right of the one before, and every file is ordered front to back
+static bool IsInOrder(Unit* unit)
+{
+	int ranks = unit->formation.numberOfRanks;
+	float right = -INFINITY;
+	for (int index = 0; index < unit->fightersCount; index += ranks)
+	{
+		int end = std::min(index + ranks, unit->fightersCount);
+		float back = -INFINITY;
+		for (int i = index; i < end; ++i)
+		{
+			glm::vec2 position = unit->fighters[i].GetPosition();
+			float file = glm::dot(position, unit->formation.towardRight);
+			float rank = glm::dot(position, unit->formation.towardBack);
+			if (file < right || rank < back)
+				return false;
+			back = rank;
+		}
+		for (int i = index; i < end; ++i)
+			right = std::max(right, glm::dot(unit->fighters[i].GetPosition(), unit->formation.towardRight));
+	}
+	return true;
+}
+
+
+// advances time until no fighter has moved more than a centimeter a time step for ten time steps,
+// at most 1000 time steps; fighters are followed by handle, since swaps move them between slots
+static int Settle(SimulationRules& simulationRules, float timeStep, Unit* unit)
+{
+	FighterStore* store = unit->fighters->store;
+	std::vector<std::pair<FighterHandle, glm::vec2>> positions(unit->fightersCount);
+	int steps = 0;
+	int still = 0;
+	while (still < 10 && steps < 1000)
+	{
+		for (int i = 0; i < unit->fightersCount; ++i)
+			positions[i] = std::make_pair(store->handle[unit->fighters[i].slot], unit->fighters[i].GetPosition());
+
+		simulationRules.AdvanceTime(timeStep);
+		++steps;
+
+		float moved = 0;
+		for (int i = 0; i < unit->fightersCount; ++i)
+			moved = std::max(moved, glm::length(store->GetFighter(positions[i].first)->GetPosition() - positions[i].second));
+
+		still = moved <= 0.01f ? still + 1 : 0;
+	}
+	return steps;
+}
+
+
+struct SwapTimes
+{
+	int swaps;
+	double sortSeconds;
+	double swapSeconds;
+	long long moved; // fighters that changed place, summed over swaps
+	long long allocations; // by swaps after the first
+	bool inOrder;
+
+	SwapTimes() : swaps(0), sortSeconds(0), swapSeconds(0), moved(0), allocations(0), inOrder(true) { }
+};
+
+
+static void MeasureSwap(Unit* unit, SwapTimes& times)
+{
+	FighterStore* store = unit->fighters->store;
+	std::vector<FighterState> states;
+	std::vector<FighterHandle> handles;
+	for (int i = 0; i < unit->fightersCount; ++i)
+	{
+		states.push_back(unit->fighters[i].GetState());
+		handles.push_back(store->handle[unit->fighters[i].slot]);
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	SortFighters(unit);
+	times.sortSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	for (int i = 0; i < unit->fightersCount; ++i)
+	{
+		unit->fighters[i].SetState(states[i]);
+		store->SetHandle(unit->fighters[i].slot, handles[i]);
+	}
+
+	long long before = allocations;
+	start = std::chrono::steady_clock::now();
+	MovementRules::SwapFighters(unit);
+	times.swapSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	times.allocations += allocations - before;
+
+	for (int i = 0; i < unit->fightersCount; ++i)
+		if (store->handle[unit->fighters[i].slot] != handles[i])
+			++times.moved;
+
+	times.inOrder = times.inOrder && IsInOrder(unit);
+	++times.swaps;
+}
+
+
+static void PrintTimes(const char* name, const SwapTimes& times)
+{
+	printf("%-14s%.1f us sorting all, %.1f us swapping, %.1f fighters moved per swap\n", name,
+		1e6 * times.sortSeconds / times.swaps, 1e6 * times.swapSeconds / times.swaps, (double)times.moved / times.swaps);
+}
+
+
+int main(int argc, char* argv[])
+{
+	int fighters = argc > 1 ? atoi(argv[1]) : 400;
+	int wheels = argc > 2 ? atoi(argv[2]) : 100;
+	float angle = argc > 3 ? (float)atof(argv[3]) : 0.5f;
+	if (fighters <= 0 || wheels <= 0)
+	{
+		printf("usage: %s [fighters] [wheels] [radians per wheel]\n", argv[0]);
+		return 1;
+	}
+
+	SimulationState* simulationState = CreateSimulationState(1, false);
+	Unit* unit = simulationState->AddUnit(Player1, fighters, SimulationState::GetDefaultUnitStats(UnitPlatformAsh, UnitWeaponYari), glm::vec2(512, 512));
+
+	SimulationRules simulationRules(simulationState);
+	for (int i = 0; i < 30; ++i)
+		simulationRules.AdvanceTime(simulationState->timeStep);
+
+	MovementRules::SwapFighters(unit); // the scratch buffer is allocated once
+
+	SwapTimes wheeling;
+	SwapTimes steady;
+	int settleSteps = 0;
+	for (int wheel = 0; wheel < wheels; ++wheel)
+	{
+		// swapped as the unit turns, then again once it has formed up facing the new direction and stopped moving
+		float direction = unit->formation._direction + angle;
+		unit->formation.SetDirection(direction);
+		MeasureSwap(unit, wheeling);
+
+		unit->movement.path.clear();
+		unit->movement.destination = unit->state.center;
+		unit->movement.direction = direction;
+		settleSteps += Settle(simulationRules, simulationState->timeStep, unit);
+
+		MeasureSwap(unit, steady);
+	}
+
+	printf("unit:         %d fighters in %d ranks, %d wheels of %.2f radians\n", unit->fightersCount, unit->formation.numberOfRanks, wheels, angle);
+	PrintTimes("wheeling:", wheeling);
+	PrintTimes("formed up:", steady);
+	printf("settling:     %.0f time steps per wheel\n", (double)settleSteps / wheels);
+	printf("allocations:  %lld in %d swaps\n", wheeling.allocations + steady.allocations, wheeling.swaps + steady.swaps);
+	printf("order:        %s\n", wheeling.inOrder && steady.inOrder ? "every file and rank in order" : "OUT OF ORDER after a swap");
+
+	// a unit formed up is in order already, give or take fighters in a tie
+	bool settled = steady.moved <= steady.swaps * (long long)unit->fightersCount / 100;
+	if (!settled)
+		printf("formed up:    MORE than 1%% of the fighters moved per swap\n");
+
+	delete simulationState;
+
+	return wheeling.inOrder && steady.inOrder && settled && wheeling.allocations + steady.allocations == 0 ? 0 : 1;
+}
@@ -0,0 +1,253 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#include "BenchmarkBattle.h"
+#include "SimulationSync.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+// Plays a battle and sends it every tick to one client per player over UDP
+// loopback sockets, with SyncServer and SyncClient at either end. Reports the
+// bytes per tick and checks that every unit a client sees matches the battle
+// within the quantization. Packets can be dropped on purpose to exercise the
+// acknowledged baselines.
+
+
+struct Endpoint
+{
+	int socket;
+	sockaddr_in address;
+};
+
+
+static bool OpenEndpoint(Endpoint& endpoint)
+{
+	endpoint.socket = socket(AF_INET, SOCK_DGRAM, 0);
+	if (endpoint.socket < 0)
+		return false;
+
+	memset(&endpoint.address, 0, sizeof(endpoint.address));
+	endpoint.address.sin_family = AF_INET;
+	endpoint.address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	endpoint.address.sin_port = 0;
+
+	socklen_t length = sizeof(endpoint.address);
+	int size = 1 << 20;
+	setsockopt(endpoint.socket, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+	return bind(endpoint.socket, (sockaddr*)&endpoint.address, sizeof(endpoint.address)) == 0
+		&& getsockname(endpoint.socket, (sockaddr*)&endpoint.address, &length) == 0;
+}
+
+
+static bool Send(const Endpoint& from, const Endpoint& to, const std::vector<unsigned char>& data)
+{
+	return sendto(from.socket, data.data(), data.size(), 0, (const sockaddr*)&to.address, sizeof(to.address)) == (ssize_t)data.size();
+}
+
+
+static bool Receive(const Endpoint& endpoint, std::vector<unsigned char>& data, bool wait, sockaddr_in* from)
+{
+	socklen_t length = sizeof(sockaddr_in);
+	data.resize(65536);
+	ssize_t size = recvfrom(endpoint.socket, data.data(), data.size(), wait ? 0 : MSG_DONTWAIT, (sockaddr*)from, from != nullptr ? &length : nullptr);
+	data.resize(size > 0 ? (size_t)size : 0);
+	return size > 0;
+}
+
+
+struct Client
+{
+	Player player;
+	SimulationState* simulationState;
+	SyncClient* syncClient;
+	SyncServer* syncServer;
+	Endpoint endpoint;
+
+	size_t bytes;
+	size_t maxBytes;
+	size_t fullBytes;
+	int fullPackets;
+	int packets;
+	int dropped;
+	int visibleUnits;
+	float maxError;
+};
+
+
+static bool CheckClient(SimulationState* simulationState, Client& client)
+{
+	// every own unit is seen, every unit seen is where the battle has it
+	for (std::pair<int, Unit*> item : simulationState->units)
+		if (item.second->player == client.player && client.simulationState->GetUnit(item.first) == nullptr)
+			return false;
+
+	for (std::pair<int, Unit*> item : client.simulationState->units)
+	{
+		Unit* unit = simulationState->GetUnit(item.first);
+		Unit* seen = item.second;
+		if (unit == nullptr || seen->fightersCount != unit->fightersCount || seen->player != unit->player)
+			return false;
+
+		for (int i = 0; i < unit->fightersCount; ++i)
+		{
+			glm::vec2 d = seen->fighters[i].GetPosition() - unit->fighters[i].GetPosition();
+			client.maxError = fmaxf(client.maxError, fmaxf(fabsf(d.x), fabsf(d.y)));
+			if (seen->fighters[i].GetReadyState() != unit->fighters[i].GetReadyState())
+				return false;
+		}
+	}
+
+	return client.simulationState->tick == simulationState->tick;
+}
+
+
+int main(int argc, char* argv[])
+{
+	int unitsPerPlayer = argc > 1 ? atoi(argv[1]) : 63;
+	int timeSteps = argc > 2 ? atoi(argv[2]) : 600;
+	int dropPercent = argc > 3 ? atoi(argv[3]) : 0;
+	if (unitsPerPlayer <= 0 || timeSteps <= 0 || dropPercent < 0 || dropPercent >= 100)
+	{
+		printf("usage: %s [units per player] [time steps] [drop percent]\n", argv[0]);
+		return 1;
+	}
+
+	// the armies start out of sight of each other
+	BenchmarkOptions options;
+	options.unitsPerPlayer = unitsPerPlayer;
+	options.layout = BenchmarkLayoutMarch;
+
+	SimulationState* simulationState = CreateBattle(options);
+	SimulationRules* simulationRules = new SimulationRules(simulationState);
+
+	Endpoint server;
+	Client clients[2];
+	bool failed = !OpenEndpoint(server);
+	for (int i = 0; i < 2; ++i)
+	{
+		Client& client = clients[i];
+		client.player = i == 0 ? Player1 : Player2;
+		client.simulationState = new SimulationState();
+		client.syncClient = new SyncClient(client.simulationState);
+		client.syncServer = new SyncServer(client.player);
+		client.bytes = client.maxBytes = client.fullBytes = 0;
+		client.fullPackets = client.packets = client.dropped = client.visibleUnits = 0;
+		client.maxError = 0;
+		failed = failed || !OpenEndpoint(client.endpoint);
+	}
+	if (failed)
+	{
+		printf("could not open loopback sockets\n");
+		return 1;
+	}
+
+	double encoding = 0;
+	double decoding = 0;
+	std::vector<unsigned char> packet;
+	std::vector<unsigned char> received;
+
+	for (int t = 0; t < timeSteps && !failed; ++t)
+	{
+		simulationRules->AdvanceTime(simulationState->timeStep);
+
+		for (Client& client : clients)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			client.syncServer->WritePacket(simulationState, packet);
+			encoding += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			client.bytes += packet.size();
+			client.maxBytes = std::max(client.maxBytes, packet.size());
+			if (client.syncServer->GetAcknowledgedTick() < 0)
+			{
+				client.fullBytes += packet.size();
+				++client.fullPackets;
+			}
+			++client.packets;
+
+			if (counterrng(2)((unsigned int)t, (unsigned int)client.player, 0, 0) % 100 < (unsigned int)dropPercent)
+			{
+				++client.dropped;
+				continue;
+			}
+
+			if (!Send(server, client.endpoint, packet) || !Receive(client.endpoint, received, true, nullptr))
+			{
+				printf("tick %d: packet of %d bytes not delivered\n", simulationState->tick, (int)packet.size());
+				failed = true;
+				break;
+			}
+
+			start = std::chrono::steady_clock::now();
+			int tick = client.syncClient->ReadPacket(received.data(), received.size());
+			decoding += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			if (tick < 0 || !CheckClient(simulationState, client))
+			{
+				printf("tick %d: player %d client %s\n", simulationState->tick, client.player, tick < 0 ? "could not decode packet" : "DIFFERS from battle");
+				failed = true;
+				break;
+			}
+			client.visibleUnits += (int)client.simulationState->units.size();
+
+			std::vector<unsigned char> ack;
+			bitwriter writer(ack);
+			writer.write((unsigned int)tick, 32);
+			writer.flush();
+			Send(client.endpoint, server, ack);
+		}
+
+		// the server reads acknowledgements as they arrive, a tick later
+		sockaddr_in from;
+		while (Receive(server, received, false, &from))
+		{
+			bitreader reader(received.data(), received.size());
+			int tick = (int)reader.read(32);
+			for (Client& client : clients)
+				if (client.endpoint.address.sin_port == from.sin_port)
+					client.syncServer->Acknowledge(tick);
+		}
+	}
+
+	int fighters = 0;
+	for (std::pair<int, Unit*> item : simulationState->units)
+		fighters += item.second->fightersCount;
+
+	printf("fighters:     %d at start, %d at end\n", unitsPerPlayer * 2 * options.fightersPerUnit, fighters);
+	printf("time steps:   %d at %.0f Hz, %d%% dropped\n", timeSteps, 1 / simulationState->timeStep, dropPercent);
+	printf("encode:       %.3f ms per client per tick\n", 1000 * encoding / (2 * timeSteps));
+	printf("decode:       %.3f ms per client per tick\n", 1000 * decoding / (2 * timeSteps));
+
+	for (Client& client : clients)
+	{
+		int delivered = client.packets - client.dropped;
+		double average = (double)client.bytes / client.packets;
+		printf("player %d:     %.0f bytes/tick average (%.1f kbit/s), %d max, %d full packets of %.0f bytes average, %.1f units seen, %.3f m max error\n",
+			client.player,
+			average,
+			average * 8 / simulationState->timeStep / 1000,
+			(int)client.maxBytes,
+			client.fullPackets,
+			client.fullPackets != 0 ? (double)client.fullBytes / client.fullPackets : 0.0,
+			delivered != 0 ? (double)client.visibleUnits / delivered : 0.0,
+			client.maxError);
+	}
+
+	for (Client& client : clients)
+	{
+		close(client.endpoint.socket);
+		delete client.syncServer;
+		delete client.syncClient;
+		delete client.simulationState;
+	}
+	close(server.socket);
+	delete simulationRules;
+	delete simulationState;
+
+	return failed ? 1 : 0;
+}
@@ -35,14 +35,10 @@ inline float angle_difference(float a1, float a2)
 
 struct plane
 {
-	union
-	{
-		struct {float a, b, c;};
-		struct {glm::vec3 normal;};
-	};
+	glm::vec3 normal;
 	float d;
 
-	plane() : a(0), b(0), c(0), d(0) {}
+	plane() : normal(0, 0, 0), d(0) {}
 	plane(glm::vec3 n, float k) : normal(n), d(-k) {}
 	plane(glm::vec3 n, glm::vec3 p);
 	plane(glm::vec3 v1, glm::vec3 v2, glm::vec3 v3);
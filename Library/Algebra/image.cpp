@@ -30,6 +30,7 @@ static int count_components(GLenum format)
 }
 
 
+#ifdef __APPLE__
 static CGImageAlphaInfo GetAlphaInfo(GLenum format)
 {
 	switch (format)
@@ -43,20 +44,24 @@ static CGImageAlphaInfo GetAlphaInfo(GLenum format)
 			return kCGImageAlphaNone;
 	}
 }
+#endif
 
 
 image::image(size_t width, size_t height, GLenum format) :
 _format(format),
 _width(width),
 _height(height),
-_data(nullptr),
-_context(nil)
+_data(nullptr)
+#ifdef __APPLE__
+,_context(nil)
+#endif
 {
 	init_data_context();
 
 }
 
 
+#ifdef __APPLE__
 image::image(NSString* name) :
 _format(GL_RGBA),
 _width(0),
@@ -127,12 +132,15 @@ _context(nil)
 	init_data_context();
 	CGContextDrawImage(_context, CGRectMake(0.0f, 0.0f, (CGFloat) _width, (CGFloat) _height), image);
 }
+#endif
 
 
 image::~image()
 {
 	free(_data);
+#ifdef __APPLE__
 	CGContextRelease(_context);
+#endif
 }
 
 
@@ -161,13 +169,21 @@ void image::set_pixel(int x, int y, glm::vec4 c)
 }
 
 
+int image::components() const
+{
+	return count_components(_format);
+}
+
+
 void image::init_data_context()
 {
 	int components = count_components(_format);
 
 	_data = (GLubyte*) calloc(_width * _height * components, sizeof(GLubyte));
 
+#ifdef __APPLE__
 	CGColorSpaceRef colorSpace = components < 3 ? CGColorSpaceCreateDeviceGray() : CGColorSpaceCreateDeviceRGB();
 	_context = CGBitmapContextCreate(_data, _width, _height, 8, _width * components, colorSpace, GetAlphaInfo(_format));
 	CGColorSpaceRelease(colorSpace);
+#endif
 }
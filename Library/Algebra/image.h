@@ -13,14 +13,19 @@ public:
 	size_t _width;
 	size_t _height;
 	GLubyte* _data;
+#ifdef __APPLE__
 	CGContextRef _context;
+#endif
 
 	image(size_t width, size_t height, GLenum format = GL_RGBA);
+#ifdef __APPLE__
 	image(NSString* name);
 	image(CGImageRef image);
+#endif
 	~image();
 
 	glm::ivec2 size() const { return glm::ivec2(_width, _height); }
+	int components() const;
 
 	glm::vec4 get_pixel(int x, int y) const;
 	void set_pixel(int x, int y, glm::vec4 c);
@@ -0,0 +1,73 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#ifndef BINARYSTREAM_H
+#define BINARYSTREAM_H
+
+
+// Readers and writers for flat binary formats. Values are copied in host byte
+// order, so only plain data types should be passed to read() and write(). A
+// reader that runs past the end of its data fails and returns zero values from
+// then on, so callers can check failed() once after reading a whole record.
+
+class binarywriter
+{
+	std::vector<unsigned char>& _buffer;
+
+public:
+	explicit binarywriter(std::vector<unsigned char>& buffer) : _buffer(buffer) {}
+
+	size_t size() const { return _buffer.size(); }
+
+	template <class T> void write(const T& value)
+	{
+		write_bytes(&value, sizeof(T));
+	}
+
+	void write_bytes(const void* data, size_t size)
+	{
+		const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+		_buffer.insert(_buffer.end(), p, p + size);
+	}
+};
+
+
+class binaryreader
+{
+	const unsigned char* _data;
+	size_t _size;
+	size_t _position;
+	bool _failed;
+
+public:
+	binaryreader(const unsigned char* data, size_t size) : _data(data), _size(size), _position(0), _failed(false) {}
+
+	bool failed() const { return _failed; }
+	bool at_end() const { return _position == _size; }
+	size_t position() const { return _position; }
+
+	template <class T> T read()
+	{
+		T result = T();
+		read_bytes(&result, sizeof(T));
+		return result;
+	}
+
+	bool read_bytes(void* data, size_t size)
+	{
+		if (_failed || size > _size - _position)
+		{
+			_failed = true;
+			memset(data, 0, size);
+			return false;
+		}
+
+		memcpy(data, _data + _position, size);
+		_position += size;
+		return true;
+	}
+};
+
+
+#endif
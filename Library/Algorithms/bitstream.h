@@ -0,0 +1,100 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#ifndef BITSTREAM_H
+#define BITSTREAM_H
+
+
+// Readers and writers for bit-packed formats. Values of up to 32 bits are
+// written least significant bit first. Like binaryreader, a bitreader that runs
+// past the end of its data fails and returns zero from then on.
+
+class bitwriter
+{
+	std::vector<unsigned char>& _buffer;
+	unsigned long long _bits;
+	int _count;
+
+public:
+	explicit bitwriter(std::vector<unsigned char>& buffer) : _buffer(buffer), _bits(0), _count(0) {}
+
+	size_t size_in_bits() const { return 8 * _buffer.size() + _count; }
+
+	void write(unsigned int value, int bits)
+	{
+		_bits |= (unsigned long long)(value & mask(bits)) << _count;
+		_count += bits;
+		while (_count >= 8)
+		{
+			_buffer.push_back((unsigned char)_bits);
+			_bits >>= 8;
+			_count -= 8;
+		}
+	}
+
+	void write_signed(int value, int bits)
+	{
+		write((unsigned int)value, bits);
+	}
+
+	void flush()
+	{
+		if (_count != 0)
+		{
+			_buffer.push_back((unsigned char)_bits);
+			_bits = 0;
+			_count = 0;
+		}
+	}
+
+	static unsigned int mask(int bits)
+	{
+		return bits < 32 ? (1u << bits) - 1 : 0xFFFFFFFFu;
+	}
+};
+
+
+class bitreader
+{
+	const unsigned char* _data;
+	size_t _size;
+	size_t _position;
+	unsigned long long _bits;
+	int _count;
+	bool _failed;
+
+public:
+	bitreader(const unsigned char* data, size_t size) : _data(data), _size(size), _position(0), _bits(0), _count(0), _failed(false) {}
+
+	bool failed() const { return _failed; }
+
+	unsigned int read(int bits)
+	{
+		while (_count < bits)
+		{
+			if (_position == _size)
+			{
+				_failed = true;
+				return 0;
+			}
+			_bits |= (unsigned long long)_data[_position++] << _count;
+			_count += 8;
+		}
+
+		unsigned int result = (unsigned int)(_bits & bitwriter::mask(bits));
+		_bits >>= bits;
+		_count -= bits;
+		return _failed ? 0 : result;
+	}
+
+	int read_signed(int bits)
+	{
+		unsigned int value = read(bits);
+		unsigned int sign = 1u << (bits - 1);
+		return (int)((value ^ sign) - sign);
+	}
+};
+
+
+#endif
@@ -0,0 +1,38 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#ifndef COUNTERRNG_H
+#define COUNTERRNG_H
+
+
+// Stateless counter-based random numbers. Each value is a hash of the seed and
+// a key of four counters, so the same key always gives the same value and rolls
+// do not depend on the order, or the thread, they are drawn in.
+
+class counterrng
+{
+	unsigned long long _seed;
+
+public:
+	explicit counterrng(unsigned long long seed) : _seed(mix(seed)) {}
+
+	unsigned int operator()(unsigned int a, unsigned int b, unsigned int c, unsigned int d) const
+	{
+		unsigned long long x = mix(_seed ^ (((unsigned long long)a << 32) | b));
+		x = mix(x ^ (((unsigned long long)c << 32) | d));
+		return (unsigned int)(x >> 32);
+	}
+
+	// splitmix64 finalizer
+	static unsigned long long mix(unsigned long long x)
+	{
+		x += 0x9E3779B97F4A7C15ULL;
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+		return x ^ (x >> 31);
+	}
+};
+
+
+#endif
@@ -7,39 +7,63 @@
 
 
 const int QuadTreeNodeItems = 16;
+const int QuadTreeMaxLevel = 12;
 
 
+// Nodes and items are allocated from arrays owned by the tree, so clearing and
+// refilling the tree does not touch the heap once the arrays have grown.
+//
+// The tree is filled either incrementally with insert(), where full nodes are
+// split as items arrive, or in bulk with add() followed by build(), which sorts
+// the items by Morton code and lays out every leaf as a contiguous range.
+//
+// Items inserted with track() get a handle that follows them when nodes are
+// split, so they can later be moved or removed without rebuilding the tree.
+// A moved item stays in its node while it is within the node bounds.
+
 template <class T> class quadtree
 {
 	struct item
 	{
 		float _x, _y;
 		T _value;
-		item() : _x(), _y(), _value() {}
-		item(float x, float y, T value) : _x(x), _y(y), _value(value) {}
+		int _handle; // -1 if not tracked
+		item() : _x(), _y(), _value(), _handle(-1) {}
+		item(float x, float y, T value, int handle) : _x(x), _y(y), _value(value), _handle(handle) {}
+	};
+
+	struct location
+	{
+		int _node;
+		int _index; // offset from the first item of the node
 	};
 
 	struct node
 	{
-		node* _parent;
-		node* _children[4];
+		int _parent;
+		int _children; // index of first of four consecutive children, 0 if leaf
 		float _minX, _minY;
 		float _maxX, _maxY;
 		float _midX, _midY;
 		int _minX100, _maxX100, _minY100, _maxY100;
-		item _items[QuadTreeNodeItems];
+		int _first; // index of first item in _items
 		int _count;
+		int _capacity;
 
-		node(node* parent, float minX, float minY, float maxX, float maxY);
-		~node();
+		node(int parent, float minX, float minY, float maxX, float maxY);
 
-		int get_index();
-		int get_child_index(float x, float y);
-		void split();
-		void reset();
+		int get_child_index(float x, float y) const;
+		bool contains(float x, float y) const;
 	};
 
-	node _root;
+	std::vector<node> _nodes;
+	std::vector<item> _items;
+	std::vector<item> _added;
+	std::vector<std::pair<unsigned int, int>> _codes;
+	std::vector<std::pair<unsigned int, int>> _sorted;
+	std::vector<location> _locations; // indexed by handle
+	std::vector<int> _freeHandles;
+	bool _bulk;
 
 public:
 	class iterator
@@ -48,16 +72,18 @@ public:
 		int _x100, _y100;
 		int _radius100;
 		float _radiusSquared;
-		node* _node;
+		const quadtree<T>* _tree;
+		int _node; // -1 at end
 		int _index;
 
 	public:
-		iterator(node* root, float x, float y, float radius);
+		iterator(const quadtree<T>* tree, float x, float y, float radius);
 		iterator(const iterator& i) :
 		_x(i._x), _y(i._y),
 		_x100(i._x100), _y100(i._y100),
 		_radius100(i._radius100),
 		_radiusSquared(i._radiusSquared),
+		_tree(i._tree),
 		_node(i._node),
 		_index(i._index) {}
 
@@ -72,12 +98,11 @@ public:
 		}
 
 	private:
-		bool is_within_radius(item* item);
-		bool is_within_radius(node* node);
-		bool is_within_radius(float x, float y);
+		bool is_within_radius(const item& item) const;
+		bool is_within_radius(const node& node) const;
 
 		void move_next();
-		node* get_next_node();
+		int get_next_node() const;
 	};
 
 public:
@@ -87,18 +112,36 @@ public:
 	void insert(float x, float y, T value);
 	void clear();
 
+	void add(float x, float y, T value);
+	void build();
+
+	int track(float x, float y, T value);
+	void move(int handle, float x, float y);
+	void remove(int handle);
+
 	iterator find(float x, float y, float radius);
 
 private:
+	void insert(const item& item);
+	void set_item(int index, int offset, const item& item);
+	int add_node(int parent, float minX, float minY, float maxX, float maxY, int capacity);
+	void split(int index);
+	void build(int index, int begin, int end, int level);
+	void sort_codes();
+
+	unsigned int get_morton_code(float x, float y) const;
+
 	static int convert(float value) { return (int)(value * 100); }
+	static unsigned int spread_bits(unsigned int value);
 };
 
 
 
 
 template <class T> quadtree<T>::quadtree(float minX, float minY, float maxX, float maxY) :
-_root(0, minX, minY, maxX, maxY)
+_bulk(false)
 {
+	add_node(-1, minX, minY, maxX, maxY, QuadTreeNodeItems);
 }
 
 
@@ -111,173 +154,370 @@ template <class T> quadtree<T>::~quadtree()
 
 template <class T> void quadtree<T>::insert(float x, float y, T value)
 {
-	node* node = &_root;
+	insert(item(x, y, value, -1));
+}
+
+
+
+template <class T> void quadtree<T>::insert(const item& item)
+{
+	float x = item._x;
+	float y = item._y;
+	int index = 0;
 	int level = 0;
 
-	while (node->_children[0])
+	while (_nodes[index]._children)
 	{
-		node = node->_children[node->get_child_index(x, y)];
-		if (++level > 12)
+		index = _nodes[index]._children + _nodes[index].get_child_index(x, y);
+		if (++level > QuadTreeMaxLevel)
 			break;
 	}
 
-	while (node->_count == QuadTreeNodeItems)
+	while (_nodes[index]._count == _nodes[index]._capacity)
 	{
-		node->split();
-		if (++level > 12)
+		split(index);
+		if (++level > QuadTreeMaxLevel)
 			break;
-		node = node->_children[node->get_child_index(x, y)];
+		index = _nodes[index]._children + _nodes[index].get_child_index(x, y);
 	}
 
-	node->_items[node->_count++] = item(x, y, value);
+	set_item(index, _nodes[index]._count++, item);
 }
 
 
 
 template <class T> void quadtree<T>::clear()
 {
-    _root.reset();
+	if (_bulk)
+	{
+		_nodes.erase(_nodes.begin() + 1, _nodes.end());
+		_items.resize(QuadTreeNodeItems);
+		_nodes[0]._children = 0;
+		_nodes[0]._first = 0;
+		_nodes[0]._capacity = QuadTreeNodeItems;
+		_bulk = false;
+	}
+
+	// the shape of an incrementally built tree is kept, only the items are removed
+	for (node& n : _nodes)
+		n._count = 0;
+
+	_added.clear();
+	_locations.clear();
+	_freeHandles.clear();
 }
 
 
 
-template <class T> typename quadtree<T>::iterator quadtree<T>::find(float x, float y, float radius)
+template <class T> void quadtree<T>::add(float x, float y, T value)
 {
-	return iterator(&_root, x, y, radius);
+	_added.push_back(item(x, y, value, -1));
 }
 
 
 
-template <class T> quadtree<T>::node::node(node* parent, float minX, float minY, float maxX, float maxY)
-: _parent(parent),
-_minX(minX), _minY(minY),
-_maxX(maxX), _maxY(maxY),
-_midX((minX + maxX) / 2), _midY((minY + maxY) / 2),
-_minX100(convert(minX)), _maxX100(convert(maxX)), _minY100(convert(minY)), _maxY100(convert(maxY)),
-_count(0)
+template <class T> void quadtree<T>::build()
 {
-	_children[0] = 0;
-	_children[1] = 0;
-	_children[2] = 0;
-	_children[3] = 0;
+	node root = _nodes[0];
+
+	_nodes.clear();
+	add_node(-1, root._minX, root._minY, root._maxX, root._maxY, 0);
+	_bulk = true;
+
+	int count = (int)_added.size();
+
+	_codes.resize(count);
+	for (int i = 0; i < count; ++i)
+		_codes[i] = std::make_pair(get_morton_code(_added[i]._x, _added[i]._y), i);
+
+	sort_codes();
+
+	_items.resize(count);
+	for (int i = 0; i < count; ++i)
+		_items[i] = _added[_codes[i].second];
+
+	build(0, 0, count, 0);
+
+	_added.clear();
 }
 
 
 
-template <class T> quadtree<T>::node::~node()
+template <class T> int quadtree<T>::track(float x, float y, T value)
 {
-	delete _children[0];
-	delete _children[1];
-	delete _children[2];
-	delete _children[3];
+	int handle;
+	if (!_freeHandles.empty())
+	{
+		handle = _freeHandles.back();
+		_freeHandles.pop_back();
+	}
+	else
+	{
+		handle = (int)_locations.size();
+		_locations.push_back(location());
+	}
+
+	insert(item(x, y, value, handle));
+	return handle;
 }
 
 
 
-template <class T> int quadtree<T>::node::get_index()
+template <class T> void quadtree<T>::move(int handle, float x, float y)
 {
-	if (this == _parent->_children[0]) return 0;
-	if (this == _parent->_children[1]) return 1;
-	if (this == _parent->_children[2]) return 2;
-	if (this == _parent->_children[3]) return 3;
-	throw -1;
+	location l = _locations[handle];
+	item& i = _items[_nodes[l._node]._first + l._index];
+
+	if (_nodes[l._node].contains(x, y))
+	{
+		i._x = x;
+		i._y = y;
+		return;
+	}
+
+	T value = i._value;
+	remove(handle);
+	_freeHandles.pop_back();
+	insert(item(x, y, value, handle));
 }
 
 
 
-template <class T> int quadtree<T>::node::get_child_index(float x, float y)
+template <class T> void quadtree<T>::remove(int handle)
 {
-	return (x > _midX ? 1 : 0) + (y > _midY ? 2 : 0);
+	location l = _locations[handle];
+	node& n = _nodes[l._node];
+
+	int last = --n._count;
+	if (l._index != last)
+		set_item(l._node, l._index, _items[n._first + last]);
+
+	_freeHandles.push_back(handle);
+}
+
+
+
+template <class T> typename quadtree<T>::iterator quadtree<T>::find(float x, float y, float radius)
+{
+	return iterator(this, x, y, radius);
+}
+
+
+
+template <class T> void quadtree<T>::set_item(int index, int offset, const item& item)
+{
+	_items[_nodes[index]._first + offset] = item;
+	if (item._handle >= 0)
+	{
+		location& l = _locations[item._handle];
+		l._node = index;
+		l._index = offset;
+	}
+}
+
+
+
+template <class T> int quadtree<T>::add_node(int parent, float minX, float minY, float maxX, float maxY, int capacity)
+{
+	int result = (int)_nodes.size();
+	_nodes.push_back(node(parent, minX, minY, maxX, maxY));
+
+	node& n = _nodes.back();
+	n._first = (int)_items.size();
+	n._capacity = capacity;
+	_items.resize(_items.size() + capacity);
+
+	return result;
 }
 
 
 
-template <class T> void quadtree<T>::node::split()
+template <class T> void quadtree<T>::split(int index)
 {
-	if (!_children[0])
+	if (!_nodes[index]._children)
 	{
-		_children[0] = new node(this, _minX, _minY, _midX, _midY);
-		_children[1] = new node(this, _midX, _minY, _maxX, _midY);
-		_children[2] = new node(this, _minX, _midY, _midX, _maxY);
-		_children[3] = new node(this, _midX, _midY, _maxX, _maxY);
+		node n = _nodes[index];
+		int children = add_node(index, n._minX, n._minY, n._midX, n._midY, QuadTreeNodeItems);
+		add_node(index, n._midX, n._minY, n._maxX, n._midY, QuadTreeNodeItems);
+		add_node(index, n._minX, n._midY, n._midX, n._maxY, QuadTreeNodeItems);
+		add_node(index, n._midX, n._midY, n._maxX, n._maxY, QuadTreeNodeItems);
+		_nodes[index]._children = children;
 	}
 
-	for (int i = 0; i < _count; ++i)
+	int count = _nodes[index]._count;
+	for (int i = 0; i < count; ++i)
 	{
-		item& item = _items[i];
-		int index = get_child_index(item._x, item._y);
-		node* child = _children[index];
+		item it = _items[_nodes[index]._first + i];
+		int child = _nodes[index]._children + _nodes[index].get_child_index(it._x, it._y);
+
+		if (_nodes[child]._count == _nodes[child]._capacity)
+			split(child);
+
+		set_item(child, _nodes[child]._count++, it);
+	}
+
+	_nodes[index]._count = 0;
+}
 
-		if (child->_count == QuadTreeNodeItems)
-			child->split();
 
-		child->_items[child->_count++] = item;
+
+template <class T> void quadtree<T>::build(int index, int begin, int end, int level)
+{
+	if (end - begin <= QuadTreeNodeItems || level >= QuadTreeMaxLevel)
+	{
+		node& n = _nodes[index];
+		n._first = begin;
+		n._count = end - begin;
+		n._capacity = end - begin;
+		return;
 	}
 
-	_count = 0;
+	node n = _nodes[index];
+	int children = add_node(index, n._minX, n._minY, n._midX, n._midY, 0);
+	add_node(index, n._midX, n._minY, n._maxX, n._midY, 0);
+	add_node(index, n._minX, n._midY, n._midX, n._maxY, 0);
+	add_node(index, n._midX, n._midY, n._maxX, n._maxY, 0);
+	_nodes[index]._children = children;
+	_nodes[index]._first = begin;
+
+	// the two bits of the Morton code at this level select the child, in child index order
+	int shift = 30 - 2 * level;
+	int first = begin;
+	for (int quadrant = 0; quadrant < 4; ++quadrant)
+	{
+		int last = first;
+		while (last < end && (int)((_codes[last].first >> shift) & 3) == quadrant)
+			++last;
+		build(children + quadrant, first, last, level + 1);
+		first = last;
+	}
 }
 
 
 
-template <class T> void quadtree<T>::node::reset()
+template <class T> void quadtree<T>::sort_codes()
 {
-	_count = 0;
+	// stable radix sort, one byte per pass, so equal codes keep their add() order
+	int count = (int)_codes.size();
+	_sorted.resize(count);
 
-	if (_children[0])
+	for (int shift = 0; shift < 32; shift += 8)
 	{
-		for (int i = 0; i < 4; ++i)
-			_children[i]->reset();
+		int start[257] = { 0 };
+		for (int i = 0; i < count; ++i)
+			++start[((_codes[i].first >> shift) & 0xFF) + 1];
+		for (int digit = 0; digit < 256; ++digit)
+			start[digit + 1] += start[digit];
+		for (int i = 0; i < count; ++i)
+			_sorted[start[(_codes[i].first >> shift) & 0xFF]++] = _codes[i];
+		_codes.swap(_sorted);
 	}
 }
 
 
 
-template <class T> quadtree<T>::iterator::iterator(node* root, float x, float y, float radius)
+template <class T> unsigned int quadtree<T>::get_morton_code(float x, float y) const
+{
+	const node& root = _nodes[0];
+	float qx = 65536 * (x - root._minX) / (root._maxX - root._minX);
+	float qy = 65536 * (y - root._minY) / (root._maxY - root._minY);
+	unsigned int ix = qx <= 0 ? 0 : qx >= 65535 ? 65535 : (unsigned int)qx;
+	unsigned int iy = qy <= 0 ? 0 : qy >= 65535 ? 65535 : (unsigned int)qy;
+	return spread_bits(ix) | (spread_bits(iy) << 1);
+}
+
+
+
+template <class T> unsigned int quadtree<T>::spread_bits(unsigned int value)
+{
+	value = (value | (value << 8)) & 0x00FF00FF;
+	value = (value | (value << 4)) & 0x0F0F0F0F;
+	value = (value | (value << 2)) & 0x33333333;
+	value = (value | (value << 1)) & 0x55555555;
+	return value;
+}
+
+
+
+template <class T> quadtree<T>::node::node(int parent, float minX, float minY, float maxX, float maxY)
+: _parent(parent),
+_children(0),
+_minX(minX), _minY(minY),
+_maxX(maxX), _maxY(maxY),
+_midX((minX + maxX) / 2), _midY((minY + maxY) / 2),
+_minX100(convert(minX)), _maxX100(convert(maxX)), _minY100(convert(minY)), _maxY100(convert(maxY)),
+_first(0),
+_count(0),
+_capacity(0)
+{
+}
+
+
+
+template <class T> int quadtree<T>::node::get_child_index(float x, float y) const
+{
+	return (x > _midX ? 1 : 0) + (y > _midY ? 2 : 0);
+}
+
+
+
+template <class T> bool quadtree<T>::node::contains(float x, float y) const
+{
+	return _minX <= x && x <= _maxX && _minY <= y && y <= _maxY;
+}
+
+
+
+template <class T> quadtree<T>::iterator::iterator(const quadtree<T>* tree, float x, float y, float radius)
 : _x(x), _y(y),
 _x100(convert(x)), _y100(convert(y)),
 _radius100(convert(radius)),
 _radiusSquared(radius * radius),
-_node(root),
-_index(0)
+_tree(tree),
+_node(0),
+_index(-1)
 {
-	if (_node)
-	{
-		--_index;
-		move_next();
-	}
+	move_next();
 }
 
 
 
 template <class T> T* quadtree<T>::iterator::operator*()
 {
-	return _node ? &_node->_items[_index]._value : 0;
+	if (_node < 0)
+		return 0;
+
+	const node& n = _tree->_nodes[_node];
+	return const_cast<T*>(&_tree->_items[n._first + _index]._value);
 }
 
 
 
-template <class T> bool quadtree<T>::iterator::is_within_radius(item* item)
+template <class T> bool quadtree<T>::iterator::is_within_radius(const item& item) const
 {
-	return is_within_radius(item->_x, item->_y);
+	float dx = item._x - _x;
+	float dy = item._y - _y;
+	float distanceSquared = dx * dx + dy * dy;
+	return distanceSquared <= _radiusSquared;
 }
 
 
 
-template <class T> bool quadtree<T>::iterator::is_within_radius(node* node)
+template <class T> bool quadtree<T>::iterator::is_within_radius(const node& node) const
 {
-	int minX = node->_minX100 - _radius100;
+	int minX = node._minX100 - _radius100;
 	if (_x100 < minX)
 		return false;
 
-    int maxX = node->_maxX100 + _radius100;
+    int maxX = node._maxX100 + _radius100;
 	if (_x100 > maxX)
 		return false;
 
-    int minY = node->_minY100 - _radius100;
+    int minY = node._minY100 - _radius100;
 	if (_y100 < minY)
 		return false;
 
-    int maxY = node->_maxY100 + _radius100;
+    int maxY = node._maxY100 + _radius100;
     if (_y100 > maxY)
 		return false;
 
@@ -286,63 +526,58 @@ template <class T> bool quadtree<T>::iterator::is_within_radius(node* node)
 
 
 
-template <class T> bool quadtree<T>::iterator::is_within_radius(float x, float y)
-{
-	float dx = x - _x;
-	float dy = y - _y;
-	float distanceSquared = dx * dx + dy * dy;
-	return distanceSquared <= _radiusSquared;
-}
-
-
-
 template <class T> void quadtree<T>::iterator::move_next()
 {
-	while (_node)
+	while (_node >= 0)
 	{
-		if (++_index == _node->_count)
+		if (++_index >= _tree->_nodes[_node]._count)
 		{
 			_index = 0;
 			_node = get_next_node();
-			while (_node && !_node->_count)
+			while (_node >= 0 && !_tree->_nodes[_node]._count)
 				_node = get_next_node();
-			if (!_node)
+			if (_node < 0)
 				return;
 		}
-		if (is_within_radius(&_node->_items[_index]))
+
+		const node& n = _tree->_nodes[_node];
+		if (is_within_radius(_tree->_items[n._first + _index]))
 			return;
 	}
 }
 
 
 
-template <class T> typename quadtree<T>::node* quadtree<T>::iterator::get_next_node()
+template <class T> int quadtree<T>::iterator::get_next_node() const
 {
-	if (_node->_children[0])
+	const std::vector<node>& nodes = _tree->_nodes;
+
+	int children = nodes[_node]._children;
+	if (children)
 	{
 		for (int index = 0; index < 4; ++index)
-        {
-            node* child = _node->_children[index];
-			if (is_within_radius(child))
-				return child;
-        }
+		{
+			if (is_within_radius(nodes[children + index]))
+				return children + index;
+		}
 	}
 
-	node* current = _node;
-	while (current->_parent != nullptr)
+	int current = _node;
+	while (nodes[current]._parent >= 0)
 	{
-		int index = current->get_index();
+		int parent = nodes[current]._parent;
+		int siblings = nodes[parent]._children;
+		int index = current - siblings;
 		while (++index != 4)
-        {
-            node* sibling = current->_parent->_children[index];
-			if (is_within_radius(sibling))
-				return sibling;
+		{
+			if (is_within_radius(nodes[siblings + index]))
+				return siblings + index;
 		}
 
-		current = current->_parent;
+		current = parent;
 	}
 
-	return 0;
+	return -1;
 }
 
 
@@ -0,0 +1,13 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#include "spatialgrid.h"
+
+
+class Fighter;
+class Unit;
+
+template class spatialgrid<int>;
+template class spatialgrid<Fighter*>;
+template class spatialgrid<Unit*>;
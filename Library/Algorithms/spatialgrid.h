@@ -0,0 +1,279 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+
+// Uniform grid with the same insert/find interface as quadtree<T>. Items are
+// bucketed into cells with a counting sort, so each cell is a contiguous range.
+// The grid is built lazily by the first find() after an insert(); call build()
+// explicitly before querying from several threads.
+//
+// find_sector() returns the items within radius that also lie inside a cone
+// around a direction, visiting only the cells overlapping the cone's bounds.
+// The half angle must be less than 90 degrees.
+
+template <class T> class spatialgrid
+{
+	struct item
+	{
+		float _x, _y;
+		T _value;
+		item() : _x(), _y(), _value() {}
+		item(float x, float y, T value) : _x(x), _y(y), _value(value) {}
+	};
+
+	float _minX, _minY;
+	float _scale;
+	int _columns, _rows;
+	std::vector<item> _inserted;
+	std::vector<int> _insertedCells;
+	std::vector<item> _items; // sorted by cell
+	std::vector<int> _cellStart; // _items index of first item in each cell, plus end marker
+	bool _built;
+
+public:
+	class iterator
+	{
+		const spatialgrid<T>* _grid;
+		float _x, _y;
+		float _radiusSquared;
+		float _directionX, _directionY; // unit direction of the sector
+		float _cosineSquared; // squared cosine of the half angle, 0 for a full circle
+		int _minColumn, _maxColumn;
+		int _maxRow;
+		int _column, _row;
+		int _index, _end;
+
+	public:
+		iterator(const spatialgrid<T>* grid, float x, float y, float radius);
+		iterator(const spatialgrid<T>* grid, float x, float y, float radius, float directionX, float directionY, float halfAngle);
+
+		T* operator*()
+		{
+			return _index < _end ? const_cast<T*>(&_grid->_items[_index]._value) : 0;
+		}
+
+		iterator& operator++()
+		{
+			++_index;
+			move_next();
+			return *this;
+		}
+
+	private:
+		void move_first();
+		void move_next();
+		bool contains(float dx, float dy) const;
+	};
+
+public:
+	spatialgrid(float minX, float minY, float maxX, float maxY, float cellSize);
+
+	void insert(float x, float y, T value);
+	void clear();
+	void build();
+
+	iterator find(float x, float y, float radius);
+	iterator find_sector(float x, float y, float radius, float direction, float halfAngle);
+
+private:
+	int get_column(float x) const { return clamp((int)((x - _minX) * _scale), _columns); }
+	int get_row(float y) const { return clamp((int)((y - _minY) * _scale), _rows); }
+
+	static int clamp(int value, int count) { return value < 0 ? 0 : value >= count ? count - 1 : value; }
+};
+
+
+
+
+template <class T> spatialgrid<T>::spatialgrid(float minX, float minY, float maxX, float maxY, float cellSize) :
+_minX(minX), _minY(minY),
+_scale(1 / cellSize),
+_columns((int)ceilf((maxX - minX) / cellSize)),
+_rows((int)ceilf((maxY - minY) / cellSize)),
+_built(true)
+{
+	_cellStart.resize(_columns * _rows + 1, 0);
+}
+
+
+
+template <class T> void spatialgrid<T>::insert(float x, float y, T value)
+{
+	_inserted.push_back(item(x, y, value));
+	_insertedCells.push_back(get_column(x) + _columns * get_row(y));
+	_built = false;
+}
+
+
+
+template <class T> void spatialgrid<T>::clear()
+{
+	_inserted.clear();
+	_insertedCells.clear();
+	_built = false;
+}
+
+
+
+template <class T> void spatialgrid<T>::build()
+{
+	if (_built)
+		return;
+
+	int cells = _columns * _rows;
+	int count = (int)_inserted.size();
+
+	std::fill(_cellStart.begin(), _cellStart.end(), 0);
+	for (int i = 0; i < count; ++i)
+		++_cellStart[_insertedCells[i] + 1];
+
+	for (int cell = 0; cell < cells; ++cell)
+		_cellStart[cell + 1] += _cellStart[cell];
+
+	_items.resize(count);
+	for (int i = 0; i < count; ++i)
+	{
+		// _cellStart[cell] is used as the insertion cursor and ends up at the start of the next cell
+		int cell = _insertedCells[i];
+		_items[_cellStart[cell]++] = _inserted[i];
+	}
+
+	for (int cell = cells; cell > 0; --cell)
+		_cellStart[cell] = _cellStart[cell - 1];
+	_cellStart[0] = 0;
+
+	_built = true;
+}
+
+
+
+template <class T> typename spatialgrid<T>::iterator spatialgrid<T>::find(float x, float y, float radius)
+{
+	build();
+	return iterator(this, x, y, radius);
+}
+
+
+
+template <class T> typename spatialgrid<T>::iterator spatialgrid<T>::find_sector(float x, float y, float radius, float direction, float halfAngle)
+{
+	build();
+	return iterator(this, x, y, radius, cosf(direction), sinf(direction), halfAngle);
+}
+
+
+
+template <class T> spatialgrid<T>::iterator::iterator(const spatialgrid<T>* grid, float x, float y, float radius) :
+_grid(grid),
+_x(x), _y(y),
+_radiusSquared(radius * radius),
+_directionX(1), _directionY(0),
+_cosineSquared(0),
+_minColumn(grid->get_column(x - radius)),
+_maxColumn(grid->get_column(x + radius)),
+_maxRow(grid->get_row(y + radius)),
+_column(_minColumn),
+_row(grid->get_row(y - radius)),
+_index(0),
+_end(0)
+{
+	move_first();
+}
+
+
+
+template <class T> spatialgrid<T>::iterator::iterator(const spatialgrid<T>* grid, float x, float y, float radius, float directionX, float directionY, float halfAngle) :
+_grid(grid),
+_x(x), _y(y),
+_radiusSquared(radius * radius),
+_directionX(directionX), _directionY(directionY),
+_cosineSquared(cosf(halfAngle) * cosf(halfAngle)),
+_index(0),
+_end(0)
+{
+	// bounds of the apex, the two edge ends, and the arc's extremes along each axis
+	float c = cosf(halfAngle);
+	float s = sinf(halfAngle);
+	float leftX = x + radius * (directionX * c - directionY * s);
+	float leftY = y + radius * (directionY * c + directionX * s);
+	float rightX = x + radius * (directionX * c + directionY * s);
+	float rightY = y + radius * (directionY * c - directionX * s);
+
+	float minX = fminf(x, fminf(leftX, rightX));
+	float maxX = fmaxf(x, fmaxf(leftX, rightX));
+	float minY = fminf(y, fminf(leftY, rightY));
+	float maxY = fmaxf(y, fmaxf(leftY, rightY));
+
+	if (directionX >= c) maxX = x + radius;
+	if (-directionX >= c) minX = x - radius;
+	if (directionY >= c) maxY = y + radius;
+	if (-directionY >= c) minY = y - radius;
+
+	_minColumn = grid->get_column(minX);
+	_maxColumn = grid->get_column(maxX);
+	_maxRow = grid->get_row(maxY);
+	_column = _minColumn;
+	_row = grid->get_row(minY);
+
+	move_first();
+}
+
+
+
+template <class T> void spatialgrid<T>::iterator::move_first()
+{
+	int cell = _column + _grid->_columns * _row;
+	_index = _grid->_cellStart[cell];
+	_end = _grid->_cellStart[cell + 1];
+	move_next();
+}
+
+
+
+template <class T> bool spatialgrid<T>::iterator::contains(float dx, float dy) const
+{
+	float distanceSquared = dx * dx + dy * dy;
+	if (distanceSquared > _radiusSquared)
+		return false;
+
+	if (_cosineSquared == 0)
+		return true;
+
+	// within the half angle when the projection on the direction is long enough, no atan2 needed
+	float projection = dx * _directionX + dy * _directionY;
+	return projection >= 0 && projection * projection >= _cosineSquared * distanceSquared;
+}
+
+
+
+template <class T> void spatialgrid<T>::iterator::move_next()
+{
+	for (;;)
+	{
+		while (_index < _end)
+		{
+			const item& i = _grid->_items[_index];
+			if (contains(i._x - _x, i._y - _y))
+				return;
+			++_index;
+		}
+
+		if (++_column > _maxColumn)
+		{
+			_column = _minColumn;
+			if (++_row > _maxRow)
+				return;
+		}
+
+		int cell = _column + _grid->_columns * _row;
+		_index = _grid->_cellStart[cell];
+		_end = _grid->_cellStart[cell + 1];
+	}
+}
+
+
+#endif
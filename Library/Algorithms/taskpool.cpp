@@ -0,0 +1,151 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#include "taskpool.h"
+
+
+
+taskpool::taskpool(int threads) :
+_remaining(0),
+_generation(0),
+_busy(0),
+_stop(false)
+{
+	if (threads <= 0)
+		threads = (int)std::thread::hardware_concurrency();
+	if (threads <= 0)
+		threads = 1;
+
+	for (int i = 0; i < threads; ++i)
+		_queues.push_back(new queue());
+
+	for (int i = 1; i < threads; ++i)
+		_threads.push_back(std::thread(&taskpool::run, this, i));
+}
+
+
+
+taskpool::~taskpool()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stop = true;
+	}
+	_start.notify_all();
+
+	for (std::thread& thread : _threads)
+		thread.join();
+
+	for (queue* q : _queues)
+		delete q;
+}
+
+
+
+void taskpool::parallel_for(int begin, int end, int grain, const std::function<void(int, int)>& body)
+{
+	if (grain < 1)
+		grain = 1;
+
+	if (_threads.empty() || end - begin <= grain)
+	{
+		if (begin < end)
+			body(begin, end);
+		return;
+	}
+
+	int generation;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		generation = ++_generation;
+
+		// counted before the first range is published, a worker may run it right away
+		_remaining = (end - begin + grain - 1) / grain;
+
+		int count = 0;
+		for (int i = begin; i < end; i += grain, ++count)
+		{
+			queue* q = _queues[count % _queues.size()];
+			std::lock_guard<std::mutex> queueLock(q->_mutex);
+			q->_ranges.push_back(range(i, std::min(i + grain, end), generation, &body));
+		}
+	}
+	_start.notify_all();
+
+	work(0, generation);
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	_done.wait(lock, [this]() { return _remaining == 0 && _busy == 0; });
+}
+
+
+
+void taskpool::run(int index)
+{
+	int generation = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_start.wait(lock, [this, generation]() { return _stop || _generation != generation; });
+			if (_stop)
+				return;
+			generation = _generation;
+			++_busy;
+		}
+
+		work(index, generation);
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			--_busy;
+		}
+		_done.notify_all();
+	}
+}
+
+
+
+void taskpool::work(int index, int generation)
+{
+	range r;
+	while (pop(index, generation, r) || steal(index, generation, r))
+	{
+		(*r._body)(r._begin, r._end);
+		--_remaining;
+	}
+}
+
+
+
+bool taskpool::pop(int index, int generation, range& result)
+{
+	queue* q = _queues[index];
+	std::lock_guard<std::mutex> lock(q->_mutex);
+	if (q->_ranges.empty() || q->_ranges.front()._generation != generation)
+		return false;
+
+	result = q->_ranges.front();
+	q->_ranges.pop_front();
+	return true;
+}
+
+
+
+bool taskpool::steal(int index, int generation, range& result)
+{
+	int n = (int)_queues.size();
+	for (int i = 1; i < n; ++i)
+	{
+		queue* q = _queues[(index + i) % n];
+		std::lock_guard<std::mutex> lock(q->_mutex);
+		if (!q->_ranges.empty() && q->_ranges.back()._generation == generation)
+		{
+			result = q->_ranges.back();
+			q->_ranges.pop_back();
+			return true;
+		}
+	}
+	return false;
+}
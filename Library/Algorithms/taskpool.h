@@ -0,0 +1,56 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#ifndef TASKPOOL_H
+#define TASKPOOL_H
+
+
+class taskpool
+{
+	// stamped with the call it belongs to, a worker still busy with the previous call leaves it alone
+	struct range
+	{
+		int _begin, _end;
+		int _generation;
+		const std::function<void(int, int)>* _body;
+		range() : _begin(0), _end(0), _generation(0), _body(nullptr) {}
+		range(int begin, int end, int generation, const std::function<void(int, int)>* body) : _begin(begin), _end(end), _generation(generation), _body(body) {}
+	};
+
+	struct queue
+	{
+		std::mutex _mutex;
+		std::deque<range> _ranges;
+	};
+
+	std::vector<std::thread> _threads;
+	std::vector<queue*> _queues; // one per thread, the calling thread uses the first
+	std::mutex _mutex;
+	std::condition_variable _start;
+	std::condition_variable _done;
+	std::atomic<int> _remaining;
+	int _generation;
+	int _busy;
+	bool _stop;
+
+public:
+	taskpool(int threads = 0);
+	~taskpool();
+
+	int size() const { return (int)_queues.size(); }
+
+	void parallel_for(int begin, int end, int grain, const std::function<void(int, int)>& body);
+
+private:
+	taskpool(const taskpool&);
+	taskpool& operator=(const taskpool&);
+
+	void run(int index);
+	void work(int index, int generation);
+	bool pop(int index, int generation, range& result);
+	bool steal(int index, int generation, range& result);
+};
+
+
+#endif
@@ -0,0 +1,123 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#ifndef TIMINGWHEEL_H
+#define TIMINGWHEEL_H
+
+
+// Queue of values due at given ticks. Values are kept in a pooled buffer and
+// linked into one bucket per tick modulo the number of buckets, so expire()
+// only visits the bucket of the tick asked for. Values due a whole turn of the
+// wheel later share the bucket and are passed over until their tick comes.
+// Values due at the same tick are expired in the order they were scheduled.
+
+template <class T> class timingwheel
+{
+	struct node
+	{
+		T _value;
+		int _tick;
+		int _next;
+	};
+
+	std::vector<node> _nodes;
+	std::vector<int> _heads; // first node per bucket, -1 if empty
+	std::vector<int> _tails;
+	int _free; // first unused node, -1 if none
+	int _size;
+
+public:
+	explicit timingwheel(int buckets = 64) : _heads(buckets, -1), _tails(buckets, -1), _free(-1), _size(0) {}
+
+	int size() const { return _size; }
+	bool empty() const { return _size == 0; }
+
+	void clear()
+	{
+		_nodes.clear();
+		std::fill(_heads.begin(), _heads.end(), -1);
+		std::fill(_tails.begin(), _tails.end(), -1);
+		_free = -1;
+		_size = 0;
+	}
+
+	void schedule(int tick, const T& value)
+	{
+		int index = _free;
+		if (index != -1)
+		{
+			_free = _nodes[index]._next;
+		}
+		else
+		{
+			index = (int)_nodes.size();
+			_nodes.push_back(node());
+		}
+
+		node& n = _nodes[index];
+		n._value = value;
+		n._tick = tick;
+		n._next = -1;
+
+		int bucket = get_bucket(tick);
+		if (_tails[bucket] != -1)
+			_nodes[_tails[bucket]]._next = index;
+		else
+			_heads[bucket] = index;
+		_tails[bucket] = index;
+		++_size;
+	}
+
+	// calls f(value) for each value due at tick, or earlier if a tick was skipped, and removes them;
+	// f must not schedule new values
+	template <class F> void expire(int tick, F f)
+	{
+		int bucket = get_bucket(tick);
+		int previous = -1;
+		int index = _heads[bucket];
+		while (index != -1)
+		{
+			node& n = _nodes[index];
+			int next = n._next;
+			if (n._tick <= tick)
+			{
+				f(n._value);
+
+				if (previous != -1)
+					_nodes[previous]._next = next;
+				else
+					_heads[bucket] = next;
+				if (_tails[bucket] == index)
+					_tails[bucket] = previous;
+
+				n._next = _free;
+				_free = index;
+				--_size;
+			}
+			else
+			{
+				previous = index;
+			}
+			index = next;
+		}
+	}
+
+	// calls f(tick, value) for each value, bucket by bucket in the order scheduled
+	template <class F> void for_each(F f) const
+	{
+		for (int head : _heads)
+			for (int index = head; index != -1; index = _nodes[index]._next)
+				f(_nodes[index]._tick, _nodes[index]._value);
+	}
+
+private:
+	int get_bucket(int tick) const
+	{
+		int buckets = (int)_heads.size();
+		return ((tick % buckets) + buckets) % buckets;
+	}
+};
+
+
+#endif
@@ -0,0 +1,241 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#include "FighterKernels.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define FIGHTERKERNELS_X86
+#include <immintrin.h>
+#endif
+
+// products and sums are kept in separate statements, which stops clang from
+// contracting them into fused multiply-adds that the vector kernels do not do
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#endif
+
+
+static_assert(sizeof(glm::vec2) == 2 * sizeof(float), "kernels read glm::vec2 arrays as interleaved floats");
+
+
+static void NextVelocityScalar(const float* position, const float* destination, const float* speed, float* result, int count)
+{
+	for (int i = 0; i < count; ++i, position += 2, destination += 2, result += 2)
+	{
+		float dx = destination[0] - position[0];
+		float dy = destination[1] - position[1];
+		float xx = dx * dx;
+		float yy = dy * dy;
+		float diff_len = xx + yy;
+
+		// the largest float below 0.01 as a double is 0.01f
+		if (diff_len <= 0.01f)
+		{
+			result[0] = dx;
+			result[1] = dy;
+			continue;
+		}
+
+		float inverse = 1 / sqrtf(diff_len);
+		float vx = dx * inverse * speed[i];
+		float vy = dy * inverse * speed[i];
+		xx = vx * vx;
+		yy = vy * vy;
+		float delta_len = xx + yy;
+
+		result[0] = delta_len < diff_len ? vx : dx;
+		result[1] = delta_len < diff_len ? vy : dy;
+	}
+}
+
+
+static void IntegratePositionScalar(const float* position, const float* velocity, float timeStep, float* result, int count)
+{
+	for (int i = 0; i < 2 * count; ++i)
+	{
+		float delta = velocity[i] * timeStep;
+		result[i] = position[i] + delta;
+	}
+}
+
+
+#ifdef FIGHTERKERNELS_X86
+
+static int NextVelocitySSE(const float* position, const float* destination, const float* speed, float* result, int count)
+{
+	const __m128 one = _mm_set1_ps(1);
+	const __m128 near = _mm_set1_ps(0.01f);
+
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 p0 = _mm_loadu_ps(position + 2 * i);
+		__m128 p1 = _mm_loadu_ps(position + 2 * i + 4);
+		__m128 d0 = _mm_loadu_ps(destination + 2 * i);
+		__m128 d1 = _mm_loadu_ps(destination + 2 * i + 4);
+
+		__m128 dx = _mm_sub_ps(_mm_shuffle_ps(d0, d1, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(p0, p1, _MM_SHUFFLE(2, 0, 2, 0)));
+		__m128 dy = _mm_sub_ps(_mm_shuffle_ps(d0, d1, _MM_SHUFFLE(3, 1, 3, 1)), _mm_shuffle_ps(p0, p1, _MM_SHUFFLE(3, 1, 3, 1)));
+		__m128 diff_len = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+
+		__m128 inverse = _mm_div_ps(one, _mm_sqrt_ps(diff_len));
+		__m128 s = _mm_loadu_ps(speed + i);
+		__m128 vx = _mm_mul_ps(_mm_mul_ps(dx, inverse), s);
+		__m128 vy = _mm_mul_ps(_mm_mul_ps(dy, inverse), s);
+		__m128 delta_len = _mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy));
+
+		__m128 mask = _mm_and_ps(_mm_cmpgt_ps(diff_len, near), _mm_cmplt_ps(delta_len, diff_len));
+		__m128 rx = _mm_or_ps(_mm_and_ps(mask, vx), _mm_andnot_ps(mask, dx));
+		__m128 ry = _mm_or_ps(_mm_and_ps(mask, vy), _mm_andnot_ps(mask, dy));
+
+		_mm_storeu_ps(result + 2 * i, _mm_unpacklo_ps(rx, ry));
+		_mm_storeu_ps(result + 2 * i + 4, _mm_unpackhi_ps(rx, ry));
+	}
+	return i;
+}
+
+
+static int IntegratePositionSSE(const float* position, const float* velocity, float timeStep, float* result, int count)
+{
+	const __m128 t = _mm_set1_ps(timeStep);
+
+	int i = 0;
+	for (; i + 2 <= count; i += 2)
+	{
+		__m128 p = _mm_loadu_ps(position + 2 * i);
+		__m128 v = _mm_loadu_ps(velocity + 2 * i);
+		_mm_storeu_ps(result + 2 * i, _mm_add_ps(p, _mm_mul_ps(v, t)));
+	}
+	return i;
+}
+
+
+// lanes are shuffled within 128 bits, leaving fighters in the order 0 1 4 5 2 3 6 7
+// until the 64 bit pairs are permuted back
+static inline __attribute__((target("avx2"))) __m256 Deinterleave(__m256 a, __m256 b, int odd)
+{
+	__m256 result = odd ? _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)) : _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+	return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(result), _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+
+static __attribute__((target("avx2"))) int NextVelocityAVX2(const float* position, const float* destination, const float* speed, float* result, int count)
+{
+	const __m256 one = _mm256_set1_ps(1);
+	const __m256 near = _mm256_set1_ps(0.01f);
+
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 p0 = _mm256_loadu_ps(position + 2 * i);
+		__m256 p1 = _mm256_loadu_ps(position + 2 * i + 8);
+		__m256 d0 = _mm256_loadu_ps(destination + 2 * i);
+		__m256 d1 = _mm256_loadu_ps(destination + 2 * i + 8);
+
+		__m256 dx = _mm256_sub_ps(Deinterleave(d0, d1, 0), Deinterleave(p0, p1, 0));
+		__m256 dy = _mm256_sub_ps(Deinterleave(d0, d1, 1), Deinterleave(p0, p1, 1));
+		__m256 diff_len = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+
+		__m256 inverse = _mm256_div_ps(one, _mm256_sqrt_ps(diff_len));
+		__m256 s = _mm256_loadu_ps(speed + i);
+		__m256 vx = _mm256_mul_ps(_mm256_mul_ps(dx, inverse), s);
+		__m256 vy = _mm256_mul_ps(_mm256_mul_ps(dy, inverse), s);
+		__m256 delta_len = _mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy));
+
+		__m256 mask = _mm256_and_ps(_mm256_cmp_ps(diff_len, near, _CMP_GT_OQ), _mm256_cmp_ps(delta_len, diff_len, _CMP_LT_OQ));
+		__m256 rx = _mm256_blendv_ps(dx, vx, mask);
+		__m256 ry = _mm256_blendv_ps(dy, vy, mask);
+
+		// unpacking interleaves within 128 bits, fighters 0 1 4 5 and 2 3 6 7
+		__m256 lo = _mm256_unpacklo_ps(rx, ry);
+		__m256 hi = _mm256_unpackhi_ps(rx, ry);
+		_mm256_storeu_ps(result + 2 * i, _mm256_permute2f128_ps(lo, hi, 0x20));
+		_mm256_storeu_ps(result + 2 * i + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+	}
+	return i;
+}
+
+
+static __attribute__((target("avx2"))) int IntegratePositionAVX2(const float* position, const float* velocity, float timeStep, float* result, int count)
+{
+	const __m256 t = _mm256_set1_ps(timeStep);
+
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m256 p = _mm256_loadu_ps(position + 2 * i);
+		__m256 v = _mm256_loadu_ps(velocity + 2 * i);
+		_mm256_storeu_ps(result + 2 * i, _mm256_add_ps(p, _mm256_mul_ps(v, t)));
+	}
+	return i;
+}
+
+#endif
+
+
+/***/
+
+
+FighterKernelSet FighterKernels::GetBestSupported()
+{
+	static const FighterKernelSet result = IsSupported(FighterKernelAVX2) ? FighterKernelAVX2
+		: IsSupported(FighterKernelSSE) ? FighterKernelSSE
+		: FighterKernelScalar;
+	return result;
+}
+
+
+bool FighterKernels::IsSupported(FighterKernelSet set)
+{
+	switch (set)
+	{
+		case FighterKernelScalar: return true;
+#ifdef FIGHTERKERNELS_X86
+		case FighterKernelSSE: return true; // part of x86-64
+		case FighterKernelAVX2: return __builtin_cpu_supports("avx2");
+#endif
+		default: return false;
+	}
+}
+
+
+const char* FighterKernels::GetName(FighterKernelSet set)
+{
+	switch (set)
+	{
+		case FighterKernelScalar: return "scalar";
+		case FighterKernelSSE: return "sse";
+		case FighterKernelAVX2: return "avx2";
+		default: return "";
+	}
+}
+
+
+void FighterKernels::NextVelocity(FighterKernelSet set, const glm::vec2* position, const glm::vec2* destination, const float* speed, glm::vec2* result, int count)
+{
+	// kernel sets that are not supported run the scalar kernel
+	int done = 0;
+#ifdef FIGHTERKERNELS_X86
+	if (set == FighterKernelAVX2 && IsSupported(set))
+		done = NextVelocityAVX2(&position->x, &destination->x, speed, &result->x, count);
+	else if (set == FighterKernelSSE)
+		done = NextVelocitySSE(&position->x, &destination->x, speed, &result->x, count);
+#endif
+
+	NextVelocityScalar(&position[done].x, &destination[done].x, speed + done, &result[done].x, count - done);
+}
+
+
+void FighterKernels::IntegratePosition(FighterKernelSet set, const glm::vec2* position, const glm::vec2* velocity, float timeStep, glm::vec2* result, int count)
+{
+	int done = 0;
+#ifdef FIGHTERKERNELS_X86
+	if (set == FighterKernelAVX2 && IsSupported(set))
+		done = IntegratePositionAVX2(&position->x, &velocity->x, timeStep, &result->x, count);
+	else if (set == FighterKernelSSE)
+		done = IntegratePositionSSE(&position->x, &velocity->x, timeStep, &result->x, count);
+#endif
+
+	IntegratePositionScalar(&position[done].x, &velocity[done].x, timeStep, &result[done].x, count - done);
+}
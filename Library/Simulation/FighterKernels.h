@@ -0,0 +1,38 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#ifndef FIGHTERKERNELS_H
+#define FIGHTERKERNELS_H
+
+
+enum FighterKernelSet
+{
+	FighterKernelScalar,
+	FighterKernelSSE, // 4 fighters at a time
+	FighterKernelAVX2 // 8 fighters at a time
+};
+
+
+// Batch versions of the per fighter motion math in SimulationRules, run over
+// the consecutive slots of a unit. Every kernel set does the same IEEE single
+// precision operations in the same order, without fused multiply-adds, so the
+// results do not depend on the processor the simulation runs on.
+
+class FighterKernels
+{
+public:
+	static FighterKernelSet GetBestSupported(); // checked once at run time
+	static bool IsSupported(FighterKernelSet set);
+	static const char* GetName(FighterKernelSet set);
+
+	// velocity toward destination at speed, or all the way there if it is closer than that,
+	// normalizing as glm::normalize(x) does, x * inversesqrt(dot(x, x))
+	static void NextVelocity(FighterKernelSet set, const glm::vec2* position, const glm::vec2* destination, const float* speed, glm::vec2* result, int count);
+
+	// position + velocity * timeStep
+	static void IntegratePosition(FighterKernelSet set, const glm::vec2* position, const glm::vec2* velocity, float timeStep, glm::vec2* result, int count);
+};
+
+
+#endif
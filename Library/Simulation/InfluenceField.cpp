@@ -0,0 +1,231 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#include "InfluenceField.h"
+
+
+
+InfluenceField::InfluenceField(float size, float falloff, int levels) :
+_size(size),
+_falloff(falloff),
+_levels(levels),
+_leafColumns(1 << (levels - 1))
+{
+	int start = 0;
+	for (int level = 0; level < levels; ++level)
+	{
+		_levelStart.push_back(start);
+		start += (1 << level) * (1 << level);
+	}
+
+	for (int player = 0; player < 3; ++player)
+		_cells[player].resize(start);
+}
+
+
+void InfluenceField::Clear()
+{
+	for (int player = 0; player < 3; ++player)
+	{
+		_added[player].clear();
+		_addedCells[player].clear();
+	}
+}
+
+
+void InfluenceField::Add(Player player, glm::vec2 position, float mass)
+{
+	Source source;
+	source.position = position;
+	source.mass = mass;
+	_added[player].push_back(source);
+	_addedCells[player].push_back(GetLeafCell(position));
+}
+
+
+void InfluenceField::Build()
+{
+	for (int player = 0; player < 3; ++player)
+		BuildPlayer(player);
+}
+
+
+float InfluenceField::GetInfluence(Player player, glm::vec2 position, float tolerance) const
+{
+	const std::vector<Cell>& cells = _cells[player];
+	const std::vector<Source>& sources = _sources[player];
+
+	struct Visit { int level, x, y; };
+	Visit stack[64];
+	int top = 0;
+	stack[top++] = Visit { 0, 0, 0 };
+
+	float result = 0;
+	while (top != 0)
+	{
+		Visit visit = stack[--top];
+		const Cell& cell = cells[_levelStart[visit.level] + visit.x + (visit.y << visit.level)];
+		if (cell.absMass == 0)
+			continue;
+
+		float distance = glm::length(position - cell.centroid);
+		if (CanApproximate(cell, distance, tolerance))
+		{
+			result += cell.mass * GetWeight(distance);
+		}
+		else if (visit.level == _levels - 1)
+		{
+			for (int i = cell.first, end = cell.first + cell.count; i != end; ++i)
+				result += sources[i].mass * GetWeight(glm::length(position - sources[i].position));
+		}
+		else
+		{
+			for (int child = 3; child >= 0; --child)
+				stack[top++] = Visit { visit.level + 1, 2 * visit.x + (child & 1), 2 * visit.y + (child >> 1) };
+		}
+	}
+
+	return result;
+}
+
+
+void InfluenceField::BuildPlayer(int player)
+{
+	std::vector<Cell>& cells = _cells[player];
+	std::vector<Source>& sources = _sources[player];
+	const std::vector<Source>& added = _added[player];
+	const std::vector<int>& addedCells = _addedCells[player];
+
+	int leafStart = _levelStart[_levels - 1];
+	int leafCount = _leafColumns * _leafColumns;
+	int count = (int)added.size();
+
+	// counting sort of the sources into leaf cell ranges
+	for (int i = 0; i < leafCount; ++i)
+	{
+		cells[leafStart + i].first = 0;
+		cells[leafStart + i].count = 0;
+	}
+	for (int i = 0; i < count; ++i)
+		++cells[leafStart + addedCells[i]].count;
+
+	int first = 0;
+	for (int i = 0; i < leafCount; ++i)
+	{
+		cells[leafStart + i].first = first;
+		first += cells[leafStart + i].count;
+		cells[leafStart + i].count = 0;
+	}
+
+	sources.resize(count);
+	for (int i = 0; i < count; ++i)
+	{
+		Cell& cell = cells[leafStart + addedCells[i]];
+		sources[cell.first + cell.count++] = added[i];
+	}
+
+	for (int i = 0; i < leafCount; ++i)
+	{
+		Cell& cell = cells[leafStart + i];
+		cell.mass = 0;
+		cell.absMass = 0;
+		cell.centroid = glm::vec2();
+		cell.radius = 0;
+		cell.moment = 0;
+
+		for (int j = cell.first, end = cell.first + cell.count; j != end; ++j)
+		{
+			float absMass = fabsf(sources[j].mass);
+			cell.mass += sources[j].mass;
+			cell.absMass += absMass;
+			cell.centroid += absMass * sources[j].position;
+		}
+
+		if (cell.absMass != 0)
+		{
+			cell.centroid /= cell.absMass;
+			for (int j = cell.first, end = cell.first + cell.count; j != end; ++j)
+			{
+				if (sources[j].mass != 0)
+				{
+					glm::vec2 d = sources[j].position - cell.centroid;
+					cell.radius = fmaxf(cell.radius, glm::length(d));
+					cell.moment += fabsf(sources[j].mass) * glm::dot(d, d);
+				}
+			}
+		}
+	}
+
+	for (int level = _levels - 2; level >= 0; --level)
+	{
+		int columns = 1 << level;
+		for (int y = 0; y < columns; ++y)
+			for (int x = 0; x < columns; ++x)
+			{
+				Cell& cell = cells[_levelStart[level] + x + y * columns];
+				cell.mass = 0;
+				cell.absMass = 0;
+				cell.centroid = glm::vec2();
+				cell.radius = 0;
+				cell.moment = 0;
+				cell.first = 0;
+				cell.count = 0;
+
+				const Cell* children[4];
+				for (int child = 0; child < 4; ++child)
+				{
+					int cx = 2 * x + (child & 1);
+					int cy = 2 * y + (child >> 1);
+					children[child] = &cells[_levelStart[level + 1] + cx + cy * 2 * columns];
+					cell.mass += children[child]->mass;
+					cell.absMass += children[child]->absMass;
+					cell.centroid += children[child]->absMass * children[child]->centroid;
+				}
+
+				if (cell.absMass != 0)
+				{
+					cell.centroid /= cell.absMass;
+					for (int child = 0; child < 4; ++child)
+					{
+						if (children[child]->absMass != 0)
+						{
+							glm::vec2 d = children[child]->centroid - cell.centroid;
+							cell.radius = fmaxf(cell.radius, glm::length(d) + children[child]->radius);
+							cell.moment += children[child]->moment + children[child]->absMass * glm::dot(d, d);
+						}
+					}
+				}
+			}
+	}
+}
+
+
+bool InfluenceField::CanApproximate(const Cell& cell, float distance, float tolerance) const
+{
+	float nearest = distance - cell.radius;
+	if (nearest <= 0)
+		return false;
+
+	// bounds on the gradient and Hessian of the weight over the cell's disc
+	float a = nearest + _falloff;
+	float gradient = _falloff / (a * a);
+	float hessian = fmaxf(2 * _falloff / (a * a * a), _falloff / (a * a * nearest));
+
+	// the centroid is weighted by |mass|, so only negative masses leave a first order term
+	float negativeMass = (cell.absMass - cell.mass) / 2;
+	float error = hessian * cell.moment / 2 + 2 * negativeMass * cell.radius * gradient;
+
+	return error <= tolerance * cell.absMass * GetWeight(distance + cell.radius);
+}
+
+
+int InfluenceField::GetLeafCell(glm::vec2 position) const
+{
+	float scale = _leafColumns / _size;
+	int x = (int)(position.x * scale);
+	int y = (int)(position.y * scale);
+	x = x < 0 ? 0 : x >= _leafColumns ? _leafColumns - 1 : x;
+	y = y < 0 ? 0 : y >= _leafColumns ? _leafColumns - 1 : y;
+	return x + y * _leafColumns;
+}
@@ -0,0 +1,70 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#ifndef INFLUENCEFIELD_H
+#define INFLUENCEFIELD_H
+
+#include "SimulationState.h"
+
+
+// Sum over all sources of one player of mass * falloff / (distance + falloff).
+//
+// Sources are bucketed into a pyramid of square cells, from a single root cell
+// down to a fine leaf grid. GetInfluence() walks the pyramid from the root and
+// uses the aggregated mass at the centroid of any cell that is far enough away.
+// Cells that are too close are opened, and sources in close leaf cells are
+// summed exactly.
+//
+// A cell is far enough away when a second order bound on its error, from the
+// spread of its sources around the centroid, is within tolerance times the
+// cell's smallest possible contribution. The total error is then at most
+// tolerance times the sum of weight * |mass| over all sources.
+
+class InfluenceField
+{
+	struct Source
+	{
+		glm::vec2 position;
+		float mass;
+	};
+
+	struct Cell
+	{
+		float mass; // sum of source masses
+		float absMass; // sum of absolute masses, weighting the centroid
+		glm::vec2 centroid;
+		float radius; // largest distance from centroid to a source
+		float moment; // sum of |mass| * squared distance from centroid
+		int first; // index of first source in the leaf cell range
+		int count;
+	};
+
+	float _size;
+	float _falloff;
+	int _levels;
+	int _leafColumns;
+	std::vector<Source> _added[3]; // per player
+	std::vector<int> _addedCells[3];
+	std::vector<Source> _sources[3]; // sorted by leaf cell
+	std::vector<Cell> _cells[3]; // all levels, root first
+	std::vector<int> _levelStart;
+
+public:
+	InfluenceField(float size, float falloff, int levels);
+
+	void Clear();
+	void Add(Player player, glm::vec2 position, float mass);
+	void Build();
+
+	float GetInfluence(Player player, glm::vec2 position, float tolerance) const;
+
+private:
+	void BuildPlayer(int player);
+	bool CanApproximate(const Cell& cell, float distance, float tolerance) const;
+	float GetWeight(float distance) const { return _falloff / (distance + _falloff); }
+	int GetLeafCell(glm::vec2 position) const;
+};
+
+
+#endif
@@ -68,10 +68,22 @@ static bool IsForwardMotion(const std::vector<glm::vec2>& path, glm::vec2 positi
 
 
 
-void MovementRules::UpdateMovementPath(std::vector<glm::vec2>& path, glm::vec2 position, glm::vec2 destination, float velocity)
+static float GetSegmentSpacing(float velocity)
 {
-	float spacing = fminf(5, 2.5f + velocity / 15.0f); // length of each segment
-	float leading = fminf(25, spacing + velocity / 10.0f); // length of first segment
+	return fminf(5, 2.5f + velocity / 15.0f);
+}
+
+
+static float GetSegmentLeading(float velocity)
+{
+	return fminf(25, GetSegmentSpacing(velocity) + velocity / 10.0f);
+}
+
+
+// drops the end of the path that does not lead on toward destination
+static void TrimMovementPath(std::vector<glm::vec2>& path, glm::vec2 position, glm::vec2 destination, float velocity)
+{
+	float leading = GetSegmentLeading(velocity); // length of first segment
 
 	if (path.size() == 0)
 		path.push_back(position);
@@ -93,9 +105,18 @@ void MovementRules::UpdateMovementPath(std::vector<glm::vec2>& path, glm::vec2 p
 	{
 		path.pop_back();
 	}
+}
+
+
+// goes on straight from the end of the path to destination
+static void ExtendMovementPath(std::vector<glm::vec2>& path, glm::vec2 position, glm::vec2 destination, float velocity)
+{
+	float spacing = GetSegmentSpacing(velocity); // length of each segment
+	float leading = GetSegmentLeading(velocity);
 
-	int n = 20;
 	glm::vec2 p = path.size() != 0 ? *(path.end() - 1) : position;
+
+	int n = 20;
 	while (n-- != 0 && glm::length(p - destination) > leading)
 	{
 		p += spacing * glm::normalize(destination - p);
@@ -106,7 +127,71 @@ void MovementRules::UpdateMovementPath(std::vector<glm::vec2>& path, glm::vec2 p
 }
 
 
-void MovementRules::AdvanceTime(Unit* unit, float timeStep)
+// the planned path is due SimulationRules::pathDelay time steps later, see SimulationRules::TakePlannedPaths()
+static void RequestMovementPath(SimulationState* simulationState, Unit* unit, glm::vec2 start, glm::vec2 destination)
+{
+	Movement& movement = unit->movement;
+	movement.pathRequestTick = simulationState->tick;
+	movement.pathRequestStart = start;
+	movement.pathRequestDestination = destination;
+	movement.pathRequestTargetId = movement.target->unitId;
+}
+
+
+// the target moves, the path is trimmed and extended toward where it is now
+static void TrackMovementTarget(SimulationState* simulationState, Unit* unit)
+{
+	std::vector<glm::vec2>& path = unit->movement.path;
+	glm::vec2 destination = unit->movement.target->state.center;
+
+	TrimMovementPath(path, unit->state.center, destination, 200);
+
+	// the unit follows what is left of the path until the planned path is due
+	glm::vec2 p = path.size() != 0 ? *(path.end() - 1) : unit->state.center;
+	if (simulationState != nullptr && !PathPlanner::IsClear(simulationState->terrainGrid, p, destination))
+		RequestMovementPath(simulationState, unit, p, destination);
+	else
+		ExtendMovementPath(path, unit->state.center, destination, 200);
+}
+
+
+void MovementRules::UpdateMovementPath(SimulationState* simulationState, Unit* unit, std::vector<glm::vec2>& path, glm::vec2 position, glm::vec2 destination, float velocity)
+{
+	TrimMovementPath(path, position, destination, velocity);
+
+	// the planned path goes as far as the last corner, and on straight from there
+	glm::vec2 p = path.size() != 0 ? *(path.end() - 1) : position;
+	if (simulationState != nullptr && !PathPlanner::IsClear(simulationState->terrainGrid, p, destination))
+	{
+		std::vector<glm::vec2> planned;
+		float forestSpeedFactor = (float)GetForestSpeedFactor(unit->stats.unitPlatform);
+		if (simulationState->pathPlanner.FindPath(simulationState->terrainGrid, p, destination, forestSpeedFactor, planned) && planned.size() > 1)
+			path.insert(path.end(), planned.begin(), planned.end() - 1);
+	}
+
+	ExtendMovementPath(path, position, destination, velocity);
+}
+
+
+void MovementRules::FollowPlannedPath(Unit* unit, const std::vector<glm::vec2>& planned)
+{
+	Movement& movement = unit->movement;
+	std::vector<glm::vec2>& path = movement.path;
+
+	if (movement.target == nullptr || movement.target->unitId != movement.pathRequestTargetId)
+		return;
+
+	std::vector<glm::vec2>::iterator i = std::find(path.begin(), path.end(), movement.pathRequestStart);
+	if (i != path.end())
+		path.erase(i + 1, path.end());
+	else if (path.size() != 0)
+		return; // the unit has been given another path since
+
+	path.insert(path.end(), planned.begin(), planned.end());
+}
+
+
+void MovementRules::AdvanceTime(SimulationState* simulationState, Unit* unit, float timeStep)
 {
 	while (unit->movement.path.size() != 0 && glm::length(unit->state.center - unit->movement.path[0]) <= 10)
 	{
@@ -119,18 +204,21 @@ void MovementRules::AdvanceTime(Unit* unit, float timeStep)
 		unit->movement.path.erase(unit->movement.path.begin());
 	}
 
+	if (unit->movement.path.size() != 0 && unit->movement.target && unit->movement.pathRequestTick == -1)
+		TrackMovementTarget(simulationState, unit);
+
 	if (unit->movement.path.size() != 0)
 	{
-		if (unit->movement.target)
-		{
-			UpdateMovementPath(unit->movement.path, unit->state.center, unit->movement.target->state.center, 200);
-		}
-
 		unit->movement.destination = unit->movement.path[0];
 	}
 	else if (unit->movement.target)
 	{
-		unit->movement.destination = unit->movement.target->state.center;
+		// around the impassable terrain once the planned path is due, the path is then kept up to date as above
+		glm::vec2 destination = unit->movement.target->state.center;
+		if (simulationState != nullptr && unit->movement.pathRequestTick == -1 && !PathPlanner::IsClear(simulationState->terrainGrid, unit->state.center, destination))
+			RequestMovementPath(simulationState, unit, unit->state.center, destination);
+
+		unit->movement.destination = destination;
 	}
 
 	float count = unit->fightersCount;
@@ -154,8 +242,12 @@ void MovementRules::AdvanceTime(Unit* unit, float timeStep)
 
 	if (unit->timeUntilSwapFighters < timeStep)
 	{
-		SwapFighters(unit);
-		unit->timeUntilSwapFighters = 5;
+		// units asleep swap when they wake up
+		if (!unit->asleep)
+		{
+			SwapFighters(unit);
+			unit->timeUntilSwapFighters = 5;
+		}
 	}
 	else
 	{
@@ -164,51 +256,91 @@ void MovementRules::AdvanceTime(Unit* unit, float timeStep)
 }
 
 
-struct FighterPos
+static bool IsLeftOf(const FighterOrder& v1, const FighterOrder& v2)
 {
-	Fighter* fighter;
-	FighterState state;
-	glm::vec2 pos;
-};
+	return v1.file != v2.file ? v1.file < v2.file : v1.index < v2.index;
+}
 
 
-static bool SortLeftToRight(const FighterPos& v1, const FighterPos& v2) { return v1.pos.y > v2.pos.y; }
-static bool SortFrontToBack(const FighterPos& v1, const FighterPos& v2) { return v1.pos.x > v2.pos.x; }
+static bool IsInFrontOf(const FighterOrder& v1, const FighterOrder& v2)
+{
+	return v1.rank != v2.rank ? v1.rank < v2.rank : v1.index < v2.index;
+}
 
 
-void MovementRules::SwapFighters(Unit* unit)
+// the order is total, so the result is the same however it is sorted; after the last swap the fighters
+// are mostly in order, unless the unit has turned, and an insertion sort only moves the few that are not
+template <class Less> static void SortFighterOrder(std::vector<FighterOrder>::iterator begin, std::vector<FighterOrder>::iterator end, Less less)
 {
-	std::vector<FighterPos> fighters;
+	int moves = 4 * (int)(end - begin);
+	for (std::vector<FighterOrder>::iterator i = begin + 1; i < end; ++i)
+	{
+		FighterOrder value = *i;
+		std::vector<FighterOrder>::iterator j = i;
+		while (j != begin && less(value, *(j - 1)))
+		{
+			if (--moves < 0)
+			{
+				*j = value;
+				std::sort(begin, end, less);
+				return;
+			}
+			*j = *(j - 1);
+			--j;
+		}
+		*j = value;
+	}
+}
 
-	float direction = unit->formation._direction;
 
-	Fighter* fightersEnd = unit->fighters + unit->fightersCount;
+void MovementRules::SwapFighters(Unit* unit)
+{
+	int count = unit->fightersCount;
+	if (count == 0)
+		return;
+
+	// the formation axes order fighters as rotating their positions by the formation's direction would
+	glm::vec2 towardRight = unit->formation.towardRight;
+	glm::vec2 towardBack = unit->formation.towardBack;
 
-	for (Fighter* fighter = unit->fighters; fighter != fightersEnd; ++fighter)
+	std::vector<FighterOrder>& order = unit->fighterOrder;
+	order.resize(count);
+	for (int index = 0; index < count; ++index)
 	{
-		FighterPos fighterPos;
-		fighterPos.fighter = fighter;
-		fighterPos.state = fighter->state;
-		fighterPos.pos = rotate(fighter->state.position, -direction);
-		fighters.push_back(fighterPos);
+		glm::vec2 position = unit->fighters[index].GetPosition();
+		order[index].file = glm::dot(position, towardRight);
+		order[index].rank = glm::dot(position, towardBack);
+		order[index].index = index;
 	}
 
-	std::sort(fighters.begin(), fighters.end(), SortLeftToRight);
+	// files left to right, and each file front to back
+	SortFighterOrder(order.begin(), order.end(), IsLeftOf);
+	int ranks = std::max(unit->formation.numberOfRanks, 1);
+	for (int index = 0; index < count; index += ranks)
+		SortFighterOrder(order.begin() + index, order.begin() + std::min(index + ranks, count), IsInFrontOf);
 
-	int index = 0;
-	while (index < unit->fightersCount)
+	// only the fighters out of place move, a cycle at a time, opponents follow them by their handles
+	FighterStore* store = unit->fighters->store;
+	for (int index = 0; index < count; ++index)
 	{
-		int count = unit->fightersCount - index;
-		if (count > unit->formation.numberOfRanks)
-			count = unit->formation.numberOfRanks;
+		if (order[index].index == index || order[index].index == -1)
+			continue;
+
+		FighterState state = unit->fighters[index].GetState();
+		FighterHandle handle = store->handle[unit->fighters[index].slot];
 
-		std::vector<FighterPos>::iterator begin = fighters.begin() + index;
-		std::sort(begin, begin + count, SortFrontToBack);
-		while (count-- != 0)
+		int place = index;
+		while (order[place].index != index)
 		{
-			unit->fighters[index].state = fighters[index].state;
-			++index;
+			int source = order[place].index;
+			store->Move(unit->fighters[place].slot, unit->fighters[source].slot);
+			order[place].index = -1;
+			place = source;
 		}
+
+		unit->fighters[place].SetState(state);
+		store->SetHandle(unit->fighters[place].slot, handle);
+		order[place].index = -1;
 	}
 }
 
@@ -220,9 +352,9 @@ glm::vec2 MovementRules::NextFighterDestination(Fighter* fighter)
 	if (unit->state.IsRouting())
 	{
 		if (unit->player == Player1)
-			return glm::vec2(fighter->state.position.x * 3, -2000);
+			return glm::vec2(fighter->GetPosition().x * 3, -2000);
 		else
-			return glm::vec2(fighter->state.position.x * 3, 2000);
+			return glm::vec2(fighter->GetPosition().x * 3, 2000);
 	}
 
 	int rank = Unit::GetFighterRank(fighter);
@@ -232,14 +364,14 @@ glm::vec2 MovementRules::NextFighterDestination(Fighter* fighter)
 	{
 		if (unit->state.unitMode == UnitModeMoving)
 		{
-			destination = fighter->state.position;
+			destination = fighter->GetPosition();
 			int n = 1;
 			for (int i = 1; i <= 10; ++i)
 			{
 				Fighter* other = Unit::GetFighter(unit, rank, file - i);
 				if (other == 0)
 					break;
-				destination = (destination + other->state.position + (float)i * unit->formation.towardRight); // / 2;
+				destination = (destination + other->GetPosition() + (float)i * unit->formation.towardRight); // / 2;
 				++n;
 			}
 			for (int i = 1; i <= 10; ++i)
@@ -247,7 +379,7 @@ glm::vec2 MovementRules::NextFighterDestination(Fighter* fighter)
 				Fighter* other = Unit::GetFighter(unit, rank, file + i);
 				if (other == 0)
 					break;
-				destination = (destination + other->state.position - (float)i * unit->formation.towardRight); // / 2;
+				destination = (destination + other->GetPosition() - (float)i * unit->formation.towardRight); // / 2;
 				++n;
 			}
 			destination /= n;
@@ -272,14 +404,39 @@ glm::vec2 MovementRules::NextFighterDestination(Fighter* fighter)
 
 		if (fighterLeft == 0 || fighterRight == 0)
 		{
-			destination = fighterMiddle->state.destination;
+			destination = fighterMiddle->GetDestination();
 		}
 		else
 		{
-			destination = (fighterLeft->state.destination + fighterRight->state.destination) / 2.0f;
+			destination = (fighterLeft->GetDestination() + fighterRight->GetDestination()) / 2.0f;
 		}
 		destination += unit->formation.towardBack;
 	}
 
 	return destination;
 }
+
+
+glm::vec2 MovementRules::NextAggregateDestination(Fighter* fighter)
+{
+	Unit* unit = fighter->unit;
+
+	// the fighter's place in a formation a second ahead, which all fighters reach at the unit's speed
+	glm::vec2 center = unit->state.center;
+	if (unit->state.unitMode == UnitModeMoving)
+	{
+		glm::vec2 diff = unit->movement.destination - center;
+		float distance = glm::length(diff);
+		float speed = unit->GetSpeed();
+		center = distance > speed ? center + diff * (speed / distance) : unit->movement.destination;
+	}
+	else if (unit->state.unitMode != UnitModeTurning)
+	{
+		center = unit->movement.destination;
+	}
+
+	glm::vec2 frontLeft = unit->formation.GetFrontLeft(center);
+	glm::vec2 offsetRight = unit->formation.towardRight * (float)Unit::GetFighterFile(fighter);
+	glm::vec2 offsetBack = unit->formation.towardBack * (float)Unit::GetFighterRank(fighter);
+	return frontLeft + offsetRight + offsetBack;
+}
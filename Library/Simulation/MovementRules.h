@@ -7,6 +7,7 @@
 
 struct Fighter;
 struct Unit;
+struct SimulationState;
 
 
 struct Formation
@@ -25,13 +26,25 @@ struct Formation
 };
 
 
+struct FighterOrder
+{
+	float file; // position along the formation's towardRight
+	float rank; // position along the formation's towardBack
+	int index; // the fighter's place in the unit before swapping
+};
+
+
 class MovementRules
 {
 public:
-	static void UpdateMovementPath(std::vector<glm::vec2>& path, glm::vec2 position, glm::vec2 destination, float velocity);
-	static void AdvanceTime(Unit* unit, float timeStep);
+	// extends path toward destination, around impassable terrain in the way if simulationState is given
+	static void UpdateMovementPath(SimulationState* simulationState, Unit* unit, std::vector<glm::vec2>& path, glm::vec2 position, glm::vec2 destination, float velocity);
+	// continues the path from where the planned path was requested, unless the unit has other orders since
+	static void FollowPlannedPath(Unit* unit, const std::vector<glm::vec2>& planned);
+	static void AdvanceTime(SimulationState* simulationState, Unit* unit, float timeStep);
 	static void SwapFighters(Unit* unit);
 	static glm::vec2 NextFighterDestination(Fighter* fighter);
+	static glm::vec2 NextAggregateDestination(Fighter* fighter);
 };
 
 
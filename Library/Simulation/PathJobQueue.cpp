@@ -0,0 +1,153 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#include "PathJobQueue.h"
+
+
+PathJobQueue::PathJobQueue() :
+_stopping(false),
+_waits(0)
+{
+	_thread = std::thread(&PathJobQueue::Run, this);
+}
+
+
+PathJobQueue::~PathJobQueue()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_submitted.notify_all();
+	_thread.join();
+
+	for (Job* job : _jobs)
+		delete job;
+}
+
+
+void PathJobQueue::Submit(const void* owner, int tick, const TerrainGrid& terrainGrid, glm::vec2 position, glm::vec2 destination, float forestSpeedFactor)
+{
+	Job* job = new Job();
+	job->owner = owner;
+	job->tick = tick;
+	job->terrainGrid = terrainGrid;
+	job->position = position;
+	job->destination = destination;
+	job->forestSpeedFactor = forestSpeedFactor;
+	job->found = false;
+	job->started = false;
+	job->done = false;
+	job->discarded = false;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_jobs.push_back(job);
+	}
+	_submitted.notify_one();
+}
+
+
+bool PathJobQueue::Take(const void* owner, const TerrainGrid& terrainGrid, glm::vec2 position, glm::vec2 destination, float forestSpeedFactor, bool& found, std::vector<glm::vec2>& path)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+
+	std::deque<Job*>::iterator i = _jobs.begin();
+	while (i != _jobs.end())
+	{
+		Job* job = *i;
+		if (job->owner == owner && !job->discarded && job->position == position && job->destination == destination
+			&& job->forestSpeedFactor == forestSpeedFactor && job->terrainGrid.IsSharedWith(terrainGrid))
+			break;
+		++i;
+	}
+
+	if (i == _jobs.end())
+		return false;
+
+	Job* job = *i;
+	if (!job->started)
+	{
+		// searching it here is as fast as waiting for the thread to get to it
+		_jobs.erase(i);
+		delete job;
+		return false;
+	}
+
+	if (!job->done)
+	{
+		++_waits;
+		_done.wait(lock, [job]() { return job->done; });
+	}
+
+	found = job->found;
+	path.swap(job->path);
+	_jobs.erase(std::find(_jobs.begin(), _jobs.end(), job));
+	delete job;
+	return true;
+}
+
+
+void PathJobQueue::Discard(const void* owner, int tick)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	std::deque<Job*>::iterator i = _jobs.begin();
+	while (i != _jobs.end())
+	{
+		Job* job = *i;
+		if (job->owner != owner || job->tick >= tick)
+		{
+			++i;
+		}
+		else if (job->started && !job->done)
+		{
+			job->discarded = true;
+			++i;
+		}
+		else
+		{
+			i = _jobs.erase(i);
+			delete job;
+		}
+	}
+}
+
+
+void PathJobQueue::Run()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (true)
+	{
+		Job* job = nullptr;
+		_submitted.wait(lock, [this, &job]() {
+			if (_stopping)
+				return true;
+			for (Job* j : _jobs)
+				if (!j->started)
+				{
+					job = j;
+					return true;
+				}
+			return false;
+		});
+
+		if (job == nullptr)
+			return;
+
+		job->started = true;
+		lock.unlock();
+		bool found = _planner.FindPath(job->terrainGrid, job->position, job->destination, job->forestSpeedFactor, job->path);
+		lock.lock();
+
+		job->found = found;
+		job->done = true;
+		if (job->discarded)
+		{
+			_jobs.erase(std::find(_jobs.begin(), _jobs.end(), job));
+			delete job;
+		}
+		_done.notify_all();
+	}
+}
@@ -0,0 +1,68 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#ifndef PATHJOBQUEUE_H
+#define PATHJOBQUEUE_H
+
+#include "PathPlanner.h"
+
+
+// Searches the paths units request on a background thread. SimulationRules
+// submits the requests made during a time step and takes each path when it is
+// due, SimulationRules::pathDelay time steps later, so that the searches run
+// while the battle goes on. A path is the same whether it was searched in the
+// background or by the caller when it is due, so the battle does not depend on
+// how fast the thread is. The queue has its own planner, whose flow fields are
+// shared by all states submitting to it, e.g. the branches of a SimulationFork.
+
+class PathJobQueue
+{
+	struct Job
+	{
+		const void* owner;
+		int tick;
+		TerrainGrid terrainGrid;
+		glm::vec2 position;
+		glm::vec2 destination;
+		float forestSpeedFactor;
+		std::vector<glm::vec2> path;
+		bool found;
+		bool started;
+		bool done;
+		bool discarded; // deleted by the thread when done
+	};
+
+	PathPlanner _planner;
+	std::deque<Job*> _jobs; // submitted and not taken, oldest first
+	std::mutex _mutex;
+	std::condition_variable _submitted;
+	std::condition_variable _done;
+	std::thread _thread;
+	bool _stopping;
+	int _waits;
+
+public:
+	PathJobQueue();
+	~PathJobQueue();
+
+	void Submit(const void* owner, int tick, const TerrainGrid& terrainGrid, glm::vec2 position, glm::vec2 destination, float forestSpeedFactor);
+
+	// the path of a job the owner submitted with the same terrain and points, waits if it is being searched;
+	// false if there is no such job or it has not been started, then the caller searches instead
+	bool Take(const void* owner, const TerrainGrid& terrainGrid, glm::vec2 position, glm::vec2 destination, float forestSpeedFactor, bool& found, std::vector<glm::vec2>& path);
+
+	// drops the jobs an owner submitted before tick that were never taken, e.g. for units that died
+	void Discard(const void* owner, int tick);
+
+	int GetWaitCount() const { return _waits; } // times Take() waited for a search to finish
+
+private:
+	PathJobQueue(const PathJobQueue&);
+	PathJobQueue& operator=(const PathJobQueue&);
+
+	void Run();
+};
+
+
+#endif
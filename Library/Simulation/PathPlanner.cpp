@@ -0,0 +1,328 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#include "PathPlanner.h"
+
+
+const int PathPlanner::GridSize;
+const int PathPlanner::AreaSize;
+
+static const float CellSize = 1024.0f / PathPlanner::GridSize; // meters
+
+
+PathPlanner::PathPlanner(int maxFields) :
+_maxFields(maxFields),
+_uses(0),
+_searches(0)
+{
+}
+
+
+PathPlanner::~PathPlanner()
+{
+	for (std::map<FieldKey, Field*>::iterator i = _fields.begin(); i != _fields.end(); ++i)
+		delete (*i).second;
+}
+
+
+bool PathPlanner::FindPath(const TerrainGrid& terrainGrid, glm::vec2 position, glm::vec2 destination, float forestSpeedFactor, std::vector<glm::vec2>& result)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	if (_cells.empty() || !_terrainGrid.IsSharedWith(terrainGrid))
+		UpdateCells(terrainGrid);
+
+	result.clear();
+
+	int cell = GetCell(destination);
+	int x = cell % GridSize;
+	int y = cell / GridSize;
+
+	FieldKey area;
+	area.cell = (y - y % AreaSize) * GridSize + x - x % AreaSize;
+	area.size = AreaSize;
+	area.forestSpeedFactor = forestSpeedFactor;
+	if (FollowField(GetField(area), position, destination, forestSpeedFactor, result))
+		return true;
+
+	FieldKey exact;
+	exact.cell = cell;
+	exact.size = 1;
+	exact.forestSpeedFactor = forestSpeedFactor;
+	return FollowField(GetField(exact), position, destination, forestSpeedFactor, result);
+}
+
+
+bool PathPlanner::IsClear(const TerrainGrid& terrainGrid, glm::vec2 p1, glm::vec2 p2)
+{
+	int n = (int)ceilf(glm::length(p2 - p1));
+	for (int i = 0; i <= n; ++i)
+		if (terrainGrid.IsImpassable(n != 0 ? glm::mix(p1, p2, (float)i / n) : p1))
+			return false;
+	return true;
+}
+
+
+void PathPlanner::UpdateCells(const TerrainGrid& terrainGrid)
+{
+	_terrainGrid = terrainGrid;
+	_cells.assign(GridSize * GridSize, 0);
+
+	// a cell is blocked if any of its terrain pixels is impassable
+	for (int y = 0; y < GridSize; ++y)
+		for (int x = 0; x < GridSize; ++x)
+		{
+			int classes = 0;
+			for (int i = 0; i < 4; ++i)
+			{
+				glm::vec2 position = CellSize * glm::vec2(x, y) + glm::vec2(i & 1 ? 3 : 1, i & 2 ? 3 : 1);
+				classes |= terrainGrid.GetClasses(position);
+			}
+
+			unsigned char& value = _cells[y * GridSize + x];
+			if ((classes & TerrainClassForest) != 0)
+				value |= CellForest;
+			if ((classes & TerrainClassImpassable) != 0)
+				value |= CellBlocked;
+		}
+
+	// shores are passable but costly, so that paths keep off them where there is room
+	const int shore = 3;
+	for (int y = 0; y < GridSize; ++y)
+		for (int x = 0; x < GridSize; ++x)
+			if ((_cells[y * GridSize + x] & CellBlocked) != 0)
+				for (int ny = std::max(y - shore, 0); ny <= std::min(y + shore, GridSize - 1); ++ny)
+					for (int nx = std::max(x - shore, 0); nx <= std::min(x + shore, GridSize - 1); ++nx)
+						_cells[ny * GridSize + nx] |= CellShore;
+
+	for (std::map<FieldKey, Field*>::iterator i = _fields.begin(); i != _fields.end(); ++i)
+		delete (*i).second;
+	_fields.clear();
+}
+
+
+const PathPlanner::Field* PathPlanner::GetField(FieldKey key)
+{
+	std::map<FieldKey, Field*>::iterator i = _fields.find(key);
+	if (i != _fields.end())
+	{
+		(*i).second->lastUse = ++_uses;
+		return (*i).second;
+	}
+
+	Field* field = nullptr;
+	if ((int)_fields.size() >= _maxFields)
+	{
+		// the least recently used field makes room
+		std::map<FieldKey, Field*>::iterator oldest = _fields.begin();
+		for (i = _fields.begin(); i != _fields.end(); ++i)
+			if ((*i).second->lastUse < (*oldest).second->lastUse)
+				oldest = i;
+
+		field = (*oldest).second;
+		_fields.erase(oldest);
+	}
+	else
+	{
+		field = new Field();
+	}
+
+	SearchField(key, field);
+	field->lastUse = ++_uses;
+	_fields[key] = field;
+	return field;
+}
+
+
+void PathPlanner::SearchField(FieldKey key, Field* field)
+{
+	++_searches;
+
+	std::vector<float>& cost = field->cost;
+	cost.assign(GridSize * GridSize, INFINITY);
+
+	// ties are popped in cell order, so fields do not depend on anything but the key and the terrain
+	typedef std::pair<float, int> Item;
+	std::vector<Item> queue; // a heap, cheapest first
+
+	int x0 = key.cell % GridSize;
+	int y0 = key.cell / GridSize;
+	for (int y = y0; y < std::min(y0 + key.size, GridSize); ++y)
+		for (int x = x0; x < std::min(x0 + key.size, GridSize); ++x)
+			if ((_cells[y * GridSize + x] & CellBlocked) == 0)
+			{
+				cost[y * GridSize + x] = 0;
+				queue.push_back(Item(0.0f, y * GridSize + x));
+			}
+
+	const float diagonal = CellSize * sqrtf(2);
+
+	while (!queue.empty())
+	{
+		std::pop_heap(queue.begin(), queue.end(), std::greater<Item>());
+		Item item = queue.back();
+		queue.pop_back();
+
+		int cell = item.second;
+		if (item.first > cost[cell])
+			continue;
+
+		int x = cell % GridSize;
+		int y = cell / GridSize;
+		float cellCost = GetCellCost(cell, key.forestSpeedFactor);
+
+		for (int dy = -1; dy <= 1; ++dy)
+			for (int dx = -1; dx <= 1; ++dx)
+			{
+				int nx = x + dx;
+				int ny = y + dy;
+				if ((dx == 0 && dy == 0) || nx < 0 || nx >= GridSize || ny < 0 || ny >= GridSize)
+					continue;
+
+				int next = ny * GridSize + nx;
+				if ((_cells[next] & CellBlocked) != 0)
+					continue;
+
+				// no cutting corners of impassable terrain
+				if (dx != 0 && dy != 0 && ((_cells[y * GridSize + nx] & CellBlocked) != 0 || (_cells[ny * GridSize + x] & CellBlocked) != 0))
+					continue;
+
+				float step = dx != 0 && dy != 0 ? diagonal : CellSize;
+				float value = item.first + step * (cellCost + GetCellCost(next, key.forestSpeedFactor)) / 2;
+				if (value < cost[next])
+				{
+					cost[next] = value;
+					queue.push_back(Item(value, next));
+					std::push_heap(queue.begin(), queue.end(), std::greater<Item>());
+				}
+			}
+	}
+}
+
+
+bool PathPlanner::FollowField(const Field* field, glm::vec2 position, glm::vec2 destination, float forestSpeedFactor, std::vector<glm::vec2>& result)
+{
+	const std::vector<float>& cost = field->cost;
+
+	// a position on the shore may be in a blocked cell, start from the best cell next to it
+	int start = GetCell(position);
+	if (cost[start] == INFINITY)
+	{
+		int x0 = start % GridSize;
+		int y0 = start / GridSize;
+		for (int y = std::max(y0 - 1, 0); y <= std::min(y0 + 1, GridSize - 1); ++y)
+			for (int x = std::max(x0 - 1, 0); x <= std::min(x0 + 1, GridSize - 1); ++x)
+				if (cost[y * GridSize + x] < cost[start])
+					start = y * GridSize + x;
+		if (cost[start] == INFINITY)
+			return false;
+	}
+
+	// downhill to the area, the points and their costs to it
+	std::vector<glm::vec2> points;
+	std::vector<float> costs;
+	points.push_back(position);
+	costs.push_back(cost[start]);
+
+	int cell = start;
+	while (cost[cell] > 0)
+	{
+		int next = cell;
+		int x = cell % GridSize;
+		int y = cell / GridSize;
+		for (int ny = std::max(y - 1, 0); ny <= std::min(y + 1, GridSize - 1); ++ny)
+			for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, GridSize - 1); ++nx)
+				if (cost[ny * GridSize + nx] < cost[next])
+					next = ny * GridSize + nx;
+
+		if (next == cell)
+			return false;
+
+		cell = next;
+		points.push_back(GetCellCenter(cell));
+		costs.push_back(cost[cell]);
+	}
+
+	float finalCost;
+	if (!GetLineCost(points.back(), destination, forestSpeedFactor, finalCost))
+		return false;
+
+	// cuts corners where the straight line is clear and costs no more than the way along the field
+	size_t anchor = 0;
+	for (size_t i = anchor + 2; i < points.size(); ++i)
+	{
+		float lineCost;
+		float fieldCost = costs[anchor] - costs[i];
+		if (!GetLineCost(points[anchor], points[i], forestSpeedFactor, lineCost) || lineCost > fieldCost * 1.001f + 0.01f)
+		{
+			anchor = i - 1;
+			result.push_back(points[anchor]);
+		}
+	}
+
+	float lineCost;
+	if (points.size() > 1 && (!GetLineCost(points[anchor], destination, forestSpeedFactor, lineCost) || lineCost > (costs[anchor] + finalCost) * 1.001f + 0.01f))
+		result.push_back(points.back());
+
+	result.push_back(destination);
+	return true;
+}
+
+
+bool PathPlanner::GetLineCost(glm::vec2 p1, glm::vec2 p2, float forestSpeedFactor, float& result) const
+{
+	// every cell the line passes through, however little, so that no impassable pixel is missed
+	glm::vec2 a = p1 / CellSize;
+	glm::vec2 d = (p2 - p1) / CellSize;
+	float length = glm::length(p2 - p1);
+
+	int x = (int)floorf(a.x);
+	int y = (int)floorf(a.y);
+	int stepX = d.x > 0 ? 1 : -1;
+	int stepY = d.y > 0 ? 1 : -1;
+	float deltaX = d.x != 0 ? fabsf(1 / d.x) : INFINITY;
+	float deltaY = d.y != 0 ? fabsf(1 / d.y) : INFINITY;
+	float nextX = d.x != 0 ? (x + (d.x > 0 ? 1 : 0) - a.x) / d.x : INFINITY;
+	float nextY = d.y != 0 ? (y + (d.y > 0 ? 1 : 0) - a.y) / d.y : INFINITY;
+
+	result = 0;
+	float t = 0;
+	while (true)
+	{
+		int cell = std::min(std::max(y, 0), GridSize - 1) * GridSize + std::min(std::max(x, 0), GridSize - 1);
+		if ((_cells[cell] & CellBlocked) != 0)
+			return false;
+
+		float t2 = fminf(fminf(nextX, nextY), 1);
+		result += (t2 - t) * length * GetCellCost(cell, forestSpeedFactor);
+		if (t2 >= 1)
+			return true;
+
+		t = t2;
+		if (nextX < nextY)
+		{
+			x += stepX;
+			nextX += deltaX;
+		}
+		else
+		{
+			y += stepY;
+			nextY += deltaY;
+		}
+	}
+}
+
+
+int PathPlanner::GetCell(glm::vec2 position) const
+{
+	int x = std::min(std::max((int)floorf(position.x / CellSize), 0), GridSize - 1);
+	int y = std::min(std::max((int)floorf(position.y / CellSize), 0), GridSize - 1);
+	return y * GridSize + x;
+}
+
+
+glm::vec2 PathPlanner::GetCellCenter(int cell)
+{
+	return CellSize * glm::vec2(cell % GridSize + 0.5f, cell / GridSize + 0.5f);
+}
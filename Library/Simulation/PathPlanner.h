@@ -0,0 +1,103 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#ifndef PATHPLANNER_H
+#define PATHPLANNER_H
+
+#include "TerrainGrid.h"
+
+
+// Finds paths around impassable terrain on a grid of four meter cells over
+// the terrain grid, costing forest by the speed fighters keep in it, and the
+// shore by three times that, to keep the flanks of units out of the water where
+// there is room. A cell is impassable if any of its pixels is. Searches
+// run outward from the destination and leave a flow field, the cost of
+// reaching the destination from every cell, which is cached and shared by all
+// paths toward the same 32 meter area, so that units ordered to one place cost
+// one search between them. A path follows the field downhill into the area,
+// is smoothed by cutting corners where the straight line is no costlier, and
+// ends with a straight leg to the destination. If that leg is not clear, the
+// path is searched again toward the destination cell alone.
+//
+// The fields are searched again when the terrain grid has been updated.
+// FindPath() can be called from several threads.
+
+class PathPlanner
+{
+	struct FieldKey
+	{
+		int cell; // first cell of the area the field runs out from
+		int size; // cells per side of the area
+		float forestSpeedFactor;
+
+		bool operator<(const FieldKey& other) const
+		{
+			if (cell != other.cell)
+				return cell < other.cell;
+			if (size != other.size)
+				return size < other.size;
+			return forestSpeedFactor < other.forestSpeedFactor;
+		}
+	};
+
+	struct Field
+	{
+		std::vector<float> cost; // meters at walking speed to the area, infinity if it cannot be reached
+		int lastUse;
+	};
+
+	enum Cell
+	{
+		CellForest = 1,
+		CellBlocked = 2,
+		CellShore = 4 // near blocked cells, where the flanks of a unit would be in the water
+	};
+
+	TerrainGrid _terrainGrid; // the terrain the cells were classified from
+	std::vector<unsigned char> _cells;
+	std::map<FieldKey, Field*> _fields;
+	std::mutex _mutex;
+	int _maxFields;
+	int _uses;
+	int _searches;
+
+public:
+	static const int GridSize = 256; // cells per side
+	static const int AreaSize = 8; // cells per side of a shared field's area
+
+	PathPlanner(int maxFields = 16);
+	~PathPlanner();
+
+	// from position to destination, not including position, with no point on impassable terrain;
+	// false if there is no such path and result is left empty
+	bool FindPath(const TerrainGrid& terrainGrid, glm::vec2 position, glm::vec2 destination, float forestSpeedFactor, std::vector<glm::vec2>& result);
+
+	// no impassable terrain between the points, sampled every meter
+	static bool IsClear(const TerrainGrid& terrainGrid, glm::vec2 p1, glm::vec2 p2);
+
+	int GetSearchCount() const { return _searches; } // fields searched since the planner was created
+	int GetFieldCount() const { return (int)_fields.size(); }
+
+private:
+	PathPlanner(const PathPlanner&);
+	PathPlanner& operator=(const PathPlanner&);
+
+	void UpdateCells(const TerrainGrid& terrainGrid);
+	const Field* GetField(FieldKey key);
+	void SearchField(FieldKey key, Field* field);
+
+	bool FollowField(const Field* field, glm::vec2 position, glm::vec2 destination, float forestSpeedFactor, std::vector<glm::vec2>& result);
+	bool GetLineCost(glm::vec2 p1, glm::vec2 p2, float forestSpeedFactor, float& result) const;
+
+	int GetCell(glm::vec2 position) const;
+	float GetCellCost(int cell, float forestSpeedFactor) const
+	{
+		float result = (_cells[cell] & CellForest) != 0 ? 1 / forestSpeedFactor : 1;
+		return (_cells[cell] & CellShore) != 0 ? 3 * result : result;
+	}
+	static glm::vec2 GetCellCenter(int cell);
+};
+
+
+#endif
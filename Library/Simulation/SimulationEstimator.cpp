@@ -0,0 +1,167 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#include "SimulationEstimator.h"
+
+
+SimulationOutcome::SimulationOutcome() :
+seed(0),
+winner(PlayerNone),
+time(0)
+{
+	for (int player = PlayerNone; player <= Player2; ++player)
+		casualties[player] = 0;
+}
+
+
+/***/
+
+
+SimulationEstimate::SimulationEstimate() :
+seconds(0)
+{
+}
+
+
+float SimulationEstimate::GetProbability(Player winner) const
+{
+	if (outcomes.empty())
+		return 0;
+
+	int count = 0;
+	for (const SimulationOutcome& outcome : outcomes)
+		if (outcome.winner == winner)
+			++count;
+
+	return (float)count / outcomes.size();
+}
+
+
+float SimulationEstimate::GetMeanCasualties(Player player) const
+{
+	if (outcomes.empty())
+		return 0;
+
+	double sum = 0;
+	for (const SimulationOutcome& outcome : outcomes)
+		sum += outcome.casualties[player];
+
+	return (float)(sum / outcomes.size());
+}
+
+
+int SimulationEstimate::GetCasualtyQuantile(Player player, float q) const
+{
+	if (outcomes.empty())
+		return 0;
+
+	std::vector<int> casualties;
+	for (const SimulationOutcome& outcome : outcomes)
+		casualties.push_back(outcome.casualties[player]);
+
+	// nearest rank, so the quantile is always one of the outcomes
+	int n = (int)casualties.size();
+	int rank = std::min(std::max((int)ceilf(q * n) - 1, 0), n - 1);
+	std::nth_element(casualties.begin(), casualties.begin() + rank, casualties.end());
+	return casualties[rank];
+}
+
+
+std::vector<int> SimulationEstimate::GetCasualtyHistogram(Player player, int bucketSize) const
+{
+	std::vector<int> result;
+	for (const SimulationOutcome& outcome : outcomes)
+	{
+		size_t bucket = (size_t)(outcome.casualties[player] / bucketSize);
+		if (bucket >= result.size())
+			result.resize(bucket + 1, 0);
+		++result[bucket];
+	}
+	return result;
+}
+
+
+/***/
+
+
+SimulationEstimator::SimulationEstimator(const SimulationState* simulationState) :
+_fork(simulationState),
+workers(nullptr),
+maxTime(600),
+spatialIndex(SpatialIndexQuadTree),
+influenceTolerance(0),
+aggregateDistance(0),
+allowSleep(false)
+{
+	for (int player = PlayerNone; player <= Player2; ++player)
+		_fighters[player] = 0;
+	for (std::map<int, Unit*>::const_iterator i = simulationState->units.begin(); i != simulationState->units.end(); ++i)
+		_fighters[(*i).second->player] += (*i).second->fightersCount;
+}
+
+
+SimulationEstimate SimulationEstimator::Run(int battles, unsigned int seed)
+{
+	SimulationEstimate result;
+	result.outcomes.resize(std::max(battles, 0));
+	for (int battle = 0; battle < battles; ++battle)
+		result.outcomes[battle].seed = GetBattleSeed(seed, battle);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// one branch per worker, reset from battle to battle, battles are handed out one at a time
+	// since they take from seconds to minutes of simulated time
+	std::atomic<int> next(0);
+	std::function<void(int, int)> body = [this, battles, &next, &result](int begin, int end) {
+		for (int i = begin; i < end; ++i)
+		{
+			SimulationState simulationState;
+			for (int battle = next++; battle < battles; battle = next++)
+				RunBattle(&simulationState, result.outcomes[battle]);
+		}
+	};
+
+	int contexts = workers != nullptr ? std::min(workers->size(), battles) : 1;
+	if (workers != nullptr && contexts > 1)
+		workers->parallel_for(0, contexts, 1, body);
+	else
+		body(0, 1);
+
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return result;
+}
+
+
+unsigned int SimulationEstimator::GetBattleSeed(unsigned int seed, int battle)
+{
+	return (unsigned int)(counterrng::mix(((unsigned long long)seed << 32) | (unsigned int)battle) >> 32);
+}
+
+
+void SimulationEstimator::RunBattle(SimulationState* simulationState, SimulationOutcome& outcome)
+{
+	_fork.ResetBranch(simulationState);
+	simulationState->seed = outcome.seed;
+
+	SimulationRules simulationRules(simulationState);
+	simulationRules.spatialIndex = spatialIndex;
+	simulationRules.influenceTolerance = influenceTolerance;
+	simulationRules.aggregateDistance = aggregateDistance;
+	simulationRules.allowSleep = allowSleep;
+
+	float startTime = simulationState->time;
+	int endTick = simulationState->tick + (int)ceilf(maxTime / simulationState->timeStep);
+	while (simulationState->winner == PlayerNone && simulationState->tick < endTick)
+		simulationRules.AdvanceTime(simulationState->timeStep);
+
+	outcome.winner = simulationState->winner;
+	outcome.time = simulationState->time - startTime;
+
+	int fighters[3] = { 0, 0, 0 };
+	for (std::map<int, Unit*>::iterator i = simulationState->units.begin(); i != simulationState->units.end(); ++i)
+		fighters[(*i).second->player] += (*i).second->fightersCount;
+
+	for (int player = PlayerNone; player <= Player2; ++player)
+		outcome.casualties[player] = _fighters[player] - fighters[player];
+}
@@ -0,0 +1,74 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#ifndef SIMULATIONESTIMATOR_H
+#define SIMULATIONESTIMATOR_H
+
+#include "SimulationFork.h"
+#include "SimulationRules.h"
+
+
+struct SimulationOutcome
+{
+	unsigned int seed;
+	Player winner; // PlayerNone if the battle was not decided within the time limit
+	float time; // seconds simulated
+	int casualties[3]; // fighters lost, indexed by player
+
+	SimulationOutcome();
+};
+
+
+struct SimulationEstimate
+{
+	std::vector<SimulationOutcome> outcomes; // by battle index, whatever thread ran the battle
+	double seconds; // wall time
+
+	SimulationEstimate();
+
+	int GetBattleCount() const { return (int)outcomes.size(); }
+	double GetBattlesPerSecond() const { return seconds > 0 ? outcomes.size() / seconds : 0; }
+
+	float GetProbability(Player winner) const; // PlayerNone for undecided battles
+	float GetMeanCasualties(Player player) const;
+	int GetCasualtyQuantile(Player player, float q) const; // q = 0 to 1, 0.5 for the median
+	std::vector<int> GetCasualtyHistogram(Player player, int bucketSize) const; // battles by casualties / bucketSize
+};
+
+
+// Plays a battle out many times from the same state, each time with another
+// seed for the random rolls, and counts who wins and how many fighters each
+// side loses. Every worker plays its battles in a branch of its own, see
+// SimulationFork, so the battles share nothing that they write. Battles run
+// one per worker without commands, until a side has no unit left that is not
+// routing, or the time limit runs out.
+//
+// A battle's outcome only depends on the state and its seed, so estimates are
+// the same whatever the number of threads.
+
+class SimulationEstimator
+{
+	SimulationFork _fork;
+	int _fighters[3]; // in the state, indexed by player
+
+public:
+	taskpool* workers; // optional, runs battles in parallel
+	float maxTime; // seconds simulated per battle at most
+	SpatialIndex spatialIndex; // rules for the battles, see SimulationRules
+	float influenceTolerance;
+	float aggregateDistance;
+	bool allowSleep;
+
+	SimulationEstimator(const SimulationState* simulationState);
+
+	SimulationEstimate Run(int battles, unsigned int seed);
+
+	static unsigned int GetBattleSeed(unsigned int seed, int battle);
+
+private:
+	void RunBattle(SimulationState* simulationState, SimulationOutcome& outcome);
+};
+
+
+#endif
@@ -0,0 +1,35 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#include "SimulationFork.h"
+#include "SimulationSnapshot.h"
+
+
+SimulationFork::SimulationFork(const SimulationState* simulationState)
+{
+	Update(simulationState);
+}
+
+
+void SimulationFork::Update(const SimulationState* simulationState)
+{
+	SimulationSnapshot::Write(simulationState, _snapshot);
+	_terrainGrid = simulationState->terrainGrid;
+}
+
+
+SimulationState* SimulationFork::CreateBranch() const
+{
+	SimulationState* result = new SimulationState();
+	ResetBranch(result);
+	return result;
+}
+
+
+void SimulationFork::ResetBranch(SimulationState* branch) const
+{
+	// cannot fail, the snapshot was written by this build
+	SimulationSnapshot::Restore(_snapshot.data(), _snapshot.size(), branch);
+	branch->terrainGrid = _terrainGrid;
+}
@@ -0,0 +1,50 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#ifndef SIMULATIONFORK_H
+#define SIMULATIONFORK_H
+
+#include "SimulationState.h"
+
+
+// Forks a battle into branches that can be played out without touching it,
+// for looking ahead: reset a branch, give it an order, advance it a few
+// seconds with rules of its own and compare.
+//
+//   SimulationFork fork(state);
+//   SimulationState* branch = fork.CreateBranch();
+//   for (each candidate order)
+//   {
+//       fork.ResetBranch(branch);
+//       apply the order to branch->GetUnit(unitId)
+//       SimulationRules rules(branch);
+//       for (int i = 0; i < 45; ++i)
+//           rules.AdvanceTime(branch->timeStep);
+//       score the branch
+//   }
+//   delete branch;
+//
+// The trunk is kept as a snapshot, taken when the fork is created or updated.
+// Branches share the terrain grid with the trunk and have no map or terrain
+// model, which the rules do not use. Resetting a branch copies the fighter
+// blocks of the snapshot into the arrays it already has. Rules kept from
+// before a reset need SimulationRules::ResetSpatialIndex(), as after
+// SimulationSnapshot::Restore().
+
+class SimulationFork
+{
+	std::vector<unsigned char> _snapshot;
+	TerrainGrid _terrainGrid;
+
+public:
+	SimulationFork(const SimulationState* simulationState);
+
+	void Update(const SimulationState* simulationState); // takes the trunk again, after it has moved on
+
+	SimulationState* CreateBranch() const; // at the trunk, delete when done
+	void ResetBranch(SimulationState* branch) const; // back to the trunk
+};
+
+
+#endif
@@ -0,0 +1,261 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#include "SimulationHistory.h"
+#include "binarystream.h"
+
+
+enum DeltaBlock
+{
+	DeltaBlockWords, // same span as before, runs of changed words follow
+	DeltaBlockBytes // span changed, the whole block follows
+};
+
+
+static size_t GetStoredSize(const std::vector<unsigned char>& snapshot)
+{
+	return snapshot.size() + sizeof(snapshot);
+}
+
+
+
+SimulationHistory::SimulationHistory(size_t memoryBudget, int keyframeInterval) :
+_memoryBudget(memoryBudget),
+_keyframeInterval(keyframeInterval),
+_memoryUsed(0)
+{
+}
+
+
+void SimulationHistory::Record(const SimulationState* simulationState)
+{
+	int tick = simulationState->tick;
+	if (!_keyframes.empty() && tick <= GetLastTick())
+		Truncate(tick);
+
+	SimulationSnapshot::Write(simulationState, _current);
+
+	bool startKeyframe = _keyframes.empty()
+		|| _previous.empty()
+		|| tick != GetLastTick() + 1
+		|| tick - _keyframes.back().tick >= _keyframeInterval;
+
+	if (startKeyframe)
+	{
+		Keyframe keyframe;
+		keyframe.tick = tick;
+		keyframe.snapshot = _current;
+		_keyframes.push_back(keyframe);
+		_memoryUsed += GetStoredSize(_current);
+	}
+	else
+	{
+		std::vector<unsigned char> delta;
+		WriteDelta(_previous, _current, delta);
+		_memoryUsed += GetStoredSize(delta);
+		_keyframes.back().deltas.push_back(std::vector<unsigned char>());
+		_keyframes.back().deltas.back().swap(delta);
+	}
+
+	_previous.swap(_current);
+
+	while (_memoryUsed > _memoryBudget && _keyframes.size() > 1)
+		DropOldest();
+}
+
+
+bool SimulationHistory::Restore(int tick, SimulationState* simulationState)
+{
+	for (std::deque<Keyframe>::reverse_iterator i = _keyframes.rbegin(); i != _keyframes.rend(); ++i)
+	{
+		const Keyframe& keyframe = *i;
+		if (keyframe.tick <= tick)
+		{
+			if (tick > keyframe.tick + (int)keyframe.deltas.size())
+				return false;
+
+			std::vector<unsigned char>& snapshot = _current;
+			snapshot = keyframe.snapshot;
+			for (int j = 0; j < tick - keyframe.tick; ++j)
+				if (!ApplyDelta(snapshot, keyframe.deltas[j]))
+					return false;
+
+			return SimulationSnapshot::Restore(snapshot.data(), snapshot.size(), simulationState);
+		}
+	}
+
+	if (tick == 0 && !_start.empty())
+		return SimulationSnapshot::Restore(_start.data(), _start.size(), simulationState);
+
+	return false;
+}
+
+
+int SimulationHistory::GetStartTick() const
+{
+	return !_start.empty() || (!_keyframes.empty() && _keyframes.front().tick == 0) ? 0 : -1;
+}
+
+
+int SimulationHistory::GetFirstTick() const
+{
+	return _keyframes.empty() ? -1 : _keyframes.front().tick;
+}
+
+
+int SimulationHistory::GetLastTick() const
+{
+	return _keyframes.empty() ? -1 : _keyframes.back().tick + (int)_keyframes.back().deltas.size();
+}
+
+
+void SimulationHistory::Truncate(int tick)
+{
+	// drops the given tick and everything after it, the battle has taken another course
+	if (tick <= 0 && !_start.empty())
+	{
+		_memoryUsed -= GetStoredSize(_start);
+		_start.clear();
+	}
+
+	while (!_keyframes.empty() && _keyframes.back().tick >= tick)
+	{
+		Keyframe& keyframe = _keyframes.back();
+		_memoryUsed -= GetStoredSize(keyframe.snapshot);
+		for (const std::vector<unsigned char>& delta : keyframe.deltas)
+			_memoryUsed -= GetStoredSize(delta);
+		_keyframes.pop_back();
+	}
+
+	if (!_keyframes.empty())
+	{
+		std::vector<std::vector<unsigned char>>& deltas = _keyframes.back().deltas;
+		while (_keyframes.back().tick + (int)deltas.size() >= tick)
+		{
+			_memoryUsed -= GetStoredSize(deltas.back());
+			deltas.pop_back();
+		}
+	}
+
+	// the next tick starts a keyframe, the snapshot of the tick before is gone
+	_previous.clear();
+}
+
+
+void SimulationHistory::DropOldest()
+{
+	Keyframe& keyframe = _keyframes.front();
+	for (const std::vector<unsigned char>& delta : keyframe.deltas)
+		_memoryUsed -= GetStoredSize(delta);
+
+	// the start of the battle stays, for going back to it
+	if (keyframe.tick == 0)
+		_start.swap(keyframe.snapshot);
+	else
+		_memoryUsed -= GetStoredSize(keyframe.snapshot);
+
+	_keyframes.pop_front();
+}
+
+
+void SimulationHistory::WriteDelta(const std::vector<unsigned char>& previous, const std::vector<unsigned char>& current, std::vector<unsigned char>& delta)
+{
+	const SnapshotHeader& previousHeader = *reinterpret_cast<const SnapshotHeader*>(previous.data());
+	const SnapshotHeader& currentHeader = *reinterpret_cast<const SnapshotHeader*>(current.data());
+
+	binarywriter writer(delta);
+	writer.write(currentHeader);
+
+	for (int i = 0; i < SnapshotBlockCount; ++i)
+	{
+		SnapshotBlock block = (SnapshotBlock)i;
+		size_t span = SimulationSnapshot::GetBlockSpan(currentHeader, block);
+		const unsigned char* data = current.data() + currentHeader.offsets[block];
+
+		if (span != SimulationSnapshot::GetBlockSpan(previousHeader, block))
+		{
+			writer.write((unsigned char)DeltaBlockBytes);
+			writer.write_bytes(data, span);
+			continue;
+		}
+
+		// spans are multiples of 16 bytes, so they compare as words
+		const unsigned int* words = reinterpret_cast<const unsigned int*>(data);
+		const unsigned int* previousWords = reinterpret_cast<const unsigned int*>(previous.data() + previousHeader.offsets[block]);
+		unsigned int count = (unsigned int)(span / sizeof(unsigned int));
+
+		writer.write((unsigned char)DeltaBlockWords);
+		unsigned int first = 0;
+		while (first < count)
+		{
+			if (words[first] == previousWords[first])
+			{
+				++first;
+				continue;
+			}
+
+			unsigned int end = first + 1;
+			while (end < count && words[end] != previousWords[end])
+				++end;
+
+			writer.write(first);
+			writer.write(end - first);
+			writer.write_bytes(words + first, (end - first) * sizeof(unsigned int));
+			first = end;
+		}
+		writer.write(0u);
+		writer.write(0u); // end of runs
+	}
+}
+
+
+bool SimulationHistory::ApplyDelta(std::vector<unsigned char>& snapshot, const std::vector<unsigned char>& delta)
+{
+	binaryreader reader(delta.data(), delta.size());
+	SnapshotHeader header = reader.read<SnapshotHeader>();
+	SnapshotHeader previousHeader = *reinterpret_cast<const SnapshotHeader*>(snapshot.data());
+
+	// blocks from the first one that moved are rebuilt from a copy of the old tail
+	int moved = 0;
+	while (moved < SnapshotBlockCount
+		&& header.offsets[moved] == previousHeader.offsets[moved]
+		&& SimulationSnapshot::GetBlockSpan(header, (SnapshotBlock)moved) == SimulationSnapshot::GetBlockSpan(previousHeader, (SnapshotBlock)moved))
+		++moved;
+
+	size_t tail = moved < SnapshotBlockCount ? previousHeader.offsets[moved] : previousHeader.size;
+	_scratch.assign(snapshot.begin() + tail, snapshot.end());
+	snapshot.resize(header.size);
+	memcpy(snapshot.data(), &header, sizeof(header));
+
+	for (int i = 0; i < SnapshotBlockCount; ++i)
+	{
+		SnapshotBlock block = (SnapshotBlock)i;
+		size_t span = SimulationSnapshot::GetBlockSpan(header, block);
+		unsigned char* data = snapshot.data() + header.offsets[block];
+
+		if (reader.read<unsigned char>() == DeltaBlockBytes)
+		{
+			reader.read_bytes(data, span);
+			continue;
+		}
+
+		if (i >= moved)
+			memcpy(data, _scratch.data() + previousHeader.offsets[block] - tail, span);
+
+		unsigned int count = (unsigned int)(span / sizeof(unsigned int));
+		while (!reader.failed())
+		{
+			unsigned int first = reader.read<unsigned int>();
+			unsigned int length = reader.read<unsigned int>();
+			if (length == 0)
+				break;
+			if (first > count || length > count - first)
+				return false;
+
+			reader.read_bytes(data + first * sizeof(unsigned int), length * sizeof(unsigned int));
+		}
+	}
+
+	return !reader.failed() && reader.at_end();
+}
@@ -0,0 +1,61 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#ifndef SIMULATIONHISTORY_H
+#define SIMULATIONHISTORY_H
+
+#include "SimulationSnapshot.h"
+
+
+// Keeps recent states of a battle for rewinding, as a full snapshot every
+// keyframe interval followed by a delta per tick. A delta holds the snapshot
+// words that changed since the tick before, block by block, so fighters that
+// stand still cost nothing. Restoring a tick applies at most one keyframe
+// interval of deltas. When the stored bytes exceed the memory budget, the
+// oldest keyframe and its deltas are dropped, all but the snapshot of tick 0,
+// which is kept so the battle can always go back to its start.
+//
+// Set it as SimulationRules::history and rewind with SimulationRules::Rewind().
+
+class SimulationHistory
+{
+	struct Keyframe
+	{
+		int tick;
+		std::vector<unsigned char> snapshot;
+		std::vector<std::vector<unsigned char>> deltas; // for tick + 1, tick + 2, ...
+	};
+
+	size_t _memoryBudget;
+	int _keyframeInterval;
+	size_t _memoryUsed;
+	std::deque<Keyframe> _keyframes;
+	std::vector<unsigned char> _start; // snapshot of tick 0 once its keyframe is dropped
+	std::vector<unsigned char> _previous; // snapshot of the last recorded tick
+	std::vector<unsigned char> _current;
+	std::vector<unsigned char> _scratch;
+
+public:
+	SimulationHistory(size_t memoryBudget, int keyframeInterval);
+
+	void Record(const SimulationState* simulationState);
+	bool Restore(int tick, SimulationState* simulationState);
+
+	int GetStartTick() const; // 0 if tick 0 was recorded, -1 if not
+	int GetFirstTick() const; // of the ticks after the start still kept, -1 if empty
+	int GetLastTick() const; // -1 if empty
+	int GetKeyframeCount() const { return (int)_keyframes.size(); }
+	size_t GetMemoryUsed() const { return _memoryUsed; } // stored keyframes and deltas
+	size_t GetMemoryBudget() const { return _memoryBudget; }
+
+private:
+	void Truncate(int tick);
+	void DropOldest();
+
+	static void WriteDelta(const std::vector<unsigned char>& previous, const std::vector<unsigned char>& current, std::vector<unsigned char>& delta);
+	bool ApplyDelta(std::vector<unsigned char>& snapshot, const std::vector<unsigned char>& delta);
+};
+
+
+#endif
@@ -0,0 +1,273 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#include "SimulationRecorder.h"
+
+
+
+UnitDeployment::UnitDeployment() :
+unitId(0),
+player(PlayerNone),
+fightersCount(0)
+{
+}
+
+
+UnitDeployment::UnitDeployment(const Unit* unit) :
+unitId(unit->unitId),
+player(unit->player),
+stats(unit->stats),
+fightersCount(unit->fightersCount),
+center(unit->state.center)
+{
+}
+
+
+Unit* UnitDeployment::Apply(SimulationState* simulationState) const
+{
+	// AddUnit() assigns the next id, so step back to get the recorded one
+	int lastUnitId = simulationState->lastUnitId;
+	simulationState->lastUnitId = unitId - 1;
+	Unit* unit = simulationState->AddUnit(player, fightersCount, stats, center);
+	simulationState->lastUnitId = std::max(lastUnitId, unitId);
+	return unit;
+}
+
+
+void UnitDeployment::Write(binarywriter& writer) const
+{
+	writer.write(unitId);
+	writer.write((int)player);
+	writer.write(stats);
+	writer.write(fightersCount);
+	writer.write(center);
+}
+
+
+void UnitDeployment::Read(binaryreader& reader)
+{
+	unitId = reader.read<int>();
+	player = (Player)reader.read<int>();
+	stats = reader.read<UnitStats>();
+	fightersCount = reader.read<int>();
+	center = reader.read<glm::vec2>();
+}
+
+
+/***/
+
+
+UnitCommand::UnitCommand() :
+unitId(0),
+path_t0(0),
+direction(0),
+targetUnitId(0),
+running(false),
+missileTargetUnitId(0),
+missileTargetLocked(false),
+timeUntilSwapFighters(0)
+{
+}
+
+
+UnitCommand::UnitCommand(const Unit* unit) :
+unitId(unit->unitId),
+path(unit->movement.path),
+path_t0(unit->movement.path_t0),
+destination(unit->movement.destination),
+direction(unit->movement.direction),
+targetUnitId(unit->movement.target != nullptr ? unit->movement.target->unitId : 0),
+running(unit->movement.running),
+missileTargetUnitId(unit->missileTarget != nullptr ? unit->missileTarget->unitId : 0),
+missileTargetLocked(unit->missileTargetLocked),
+timeUntilSwapFighters(unit->timeUntilSwapFighters)
+{
+}
+
+
+bool UnitCommand::operator==(const UnitCommand& other) const
+{
+	return unitId == other.unitId
+		&& path == other.path
+		&& path_t0 == other.path_t0
+		&& destination == other.destination
+		&& direction == other.direction
+		&& targetUnitId == other.targetUnitId
+		&& running == other.running
+		&& missileTargetUnitId == other.missileTargetUnitId
+		&& missileTargetLocked == other.missileTargetLocked
+		&& timeUntilSwapFighters == other.timeUntilSwapFighters;
+}
+
+
+void UnitCommand::Apply(SimulationState* simulationState) const
+{
+	Unit* unit = simulationState->GetUnit(unitId);
+	if (unit == nullptr)
+		return;
+
+	unit->movement.path = path;
+	unit->movement.path_t0 = path_t0;
+	unit->movement.destination = destination;
+	unit->movement.direction = direction;
+	unit->movement.target = simulationState->GetUnit(targetUnitId);
+	unit->movement.running = running;
+	unit->missileTarget = simulationState->GetUnit(missileTargetUnitId);
+	unit->missileTargetLocked = missileTargetLocked;
+	unit->timeUntilSwapFighters = timeUntilSwapFighters;
+}
+
+
+void UnitCommand::Write(binarywriter& writer) const
+{
+	writer.write(unitId);
+	writer.write((int)path.size());
+	if (!path.empty())
+		writer.write_bytes(path.data(), path.size() * sizeof(glm::vec2));
+	writer.write(path_t0);
+	writer.write(destination);
+	writer.write(direction);
+	writer.write(targetUnitId);
+	writer.write((unsigned char)running);
+	writer.write(missileTargetUnitId);
+	writer.write((unsigned char)missileTargetLocked);
+	writer.write(timeUntilSwapFighters);
+}
+
+
+void UnitCommand::Read(binaryreader& reader)
+{
+	unitId = reader.read<int>();
+
+	int count = reader.read<int>();
+	path.clear();
+	for (int i = 0; i < count && !reader.failed(); ++i)
+		path.push_back(reader.read<glm::vec2>());
+
+	path_t0 = reader.read<float>();
+	destination = reader.read<glm::vec2>();
+	direction = reader.read<float>();
+	targetUnitId = reader.read<int>();
+	running = reader.read<unsigned char>() != 0;
+	missileTargetUnitId = reader.read<int>();
+	missileTargetLocked = reader.read<unsigned char>() != 0;
+	timeUntilSwapFighters = reader.read<float>();
+}
+
+
+/***/
+
+
+SimulationRecorder::SimulationRecorder(SimulationState* simulationState, bool recordHashes) :
+_simulationState(simulationState),
+_recordHashes(recordHashes)
+{
+	binarywriter writer(_log);
+	writer.write(SimulationLogMagic);
+	writer.write(SimulationLogVersion);
+	writer.write(_simulationState->seed);
+	writer.write(_simulationState->timeStep);
+	WriteMap(writer);
+}
+
+
+void SimulationRecorder::RecordCommands()
+{
+	binarywriter writer(_log);
+	int tick = _simulationState->tick;
+
+	for (std::map<int, Unit*>::iterator i = _simulationState->units.begin(); i != _simulationState->units.end(); ++i)
+	{
+		Unit* unit = (*i).second;
+		std::map<int, UnitCommand>::iterator j = _commands.find(unit->unitId);
+		if (j == _commands.end())
+		{
+			writer.write((unsigned char)SimulationLogRecordUnit);
+			writer.write(tick);
+			UnitDeployment(unit).Write(writer);
+			UnitCommand(unit).Write(writer);
+		}
+		else
+		{
+			UnitCommand command(unit);
+			if (command != (*j).second)
+			{
+				writer.write((unsigned char)SimulationLogRecordCommand);
+				writer.write(tick);
+				command.Write(writer);
+			}
+		}
+	}
+}
+
+
+void SimulationRecorder::EndTimeStep()
+{
+	_commands.clear();
+	for (std::map<int, Unit*>::iterator i = _simulationState->units.begin(); i != _simulationState->units.end(); ++i)
+		_commands[(*i).first] = UnitCommand((*i).second);
+
+	if (_recordHashes)
+	{
+		binarywriter writer(_log);
+		writer.write((unsigned char)SimulationLogRecordHash);
+		writer.write(_simulationState->tick);
+		writer.write(_simulationState->CalculateHash());
+	}
+}
+
+
+std::vector<unsigned char> SimulationRecorder::GetLog() const
+{
+	std::vector<unsigned char> result(_log);
+	result.push_back((unsigned char)SimulationLogRecordEnd);
+	return result;
+}
+
+
+bool SimulationRecorder::Save(const char* path) const
+{
+	std::vector<unsigned char> log = GetLog();
+
+	FILE* file = fopen(path, "wb");
+	if (file == nullptr)
+		return false;
+
+	bool result = fwrite(log.data(), 1, log.size(), file) == log.size();
+	return fclose(file) == 0 && result;
+}
+
+
+void SimulationRecorder::WriteMap(binarywriter& writer)
+{
+	const image* map = _simulationState->map;
+	if (map == nullptr)
+	{
+		writer.write(0);
+		writer.write(0);
+		return;
+	}
+
+	writer.write((int)map->_width);
+	writer.write((int)map->_height);
+	writer.write((unsigned int)map->_format);
+
+	// run-length encoded pixels, the maps are mostly large areas of one color
+	int components = map->components();
+	const GLubyte* pixel = map->_data;
+	const GLubyte* end = pixel + map->_width * map->_height * components;
+	while (pixel != end)
+	{
+		const GLubyte* next = pixel + components;
+		int run = 1;
+		while (next != end && run < 0xFFFF && memcmp(next, pixel, components) == 0)
+		{
+			next += components;
+			++run;
+		}
+		writer.write((unsigned short)run);
+		writer.write_bytes(pixel, components);
+		pixel = next;
+	}
+}
@@ -0,0 +1,102 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#ifndef SIMULATIONRECORDER_H
+#define SIMULATIONRECORDER_H
+
+#include "SimulationState.h"
+#include "binarystream.h"
+
+
+const unsigned int SimulationLogMagic = 0x4C52574F; // "OWRL"
+const unsigned int SimulationLogVersion = 1;
+
+
+enum SimulationLogRecord
+{
+	SimulationLogRecordEnd,
+	SimulationLogRecordUnit, // unit deployed, followed by its initial command
+	SimulationLogRecordCommand, // control attributes changed by a player
+	SimulationLogRecordHash // state hash after a time step
+};
+
+
+// The static attributes of a unit, enough to add it again with AddUnit().
+
+struct UnitDeployment
+{
+	int unitId;
+	Player player;
+	UnitStats stats;
+	int fightersCount;
+	glm::vec2 center;
+
+	UnitDeployment();
+	explicit UnitDeployment(const Unit* unit);
+
+	Unit* Apply(SimulationState* simulationState) const;
+
+	void Write(binarywriter& writer) const;
+	void Read(binaryreader& reader);
+};
+
+
+// The control attributes of a unit, with units referred to by id.
+
+struct UnitCommand
+{
+	int unitId;
+	std::vector<glm::vec2> path;
+	float path_t0;
+	glm::vec2 destination;
+	float direction;
+	int targetUnitId;
+	bool running;
+	int missileTargetUnitId;
+	bool missileTargetLocked;
+	float timeUntilSwapFighters;
+
+	UnitCommand();
+	explicit UnitCommand(const Unit* unit);
+
+	bool operator==(const UnitCommand& other) const;
+	bool operator!=(const UnitCommand& other) const { return !(*this == other); }
+
+	void Apply(SimulationState* simulationState) const;
+
+	void Write(binarywriter& writer) const;
+	void Read(binaryreader& reader);
+};
+
+
+// Records a battle as a compact log of the map, the deployed units and every
+// command given to them, keyed by tick, so that SimulationReplay can run it again
+// exactly. Set it as SimulationRules::recorder before the first time step.
+//
+// Commands are found by comparing the control attributes of each unit with their
+// values after the previous time step, so only changes made between time steps,
+// that is by the players, are recorded.
+
+class SimulationRecorder
+{
+	SimulationState* _simulationState;
+	std::vector<unsigned char> _log;
+	std::map<int, UnitCommand> _commands; // control attributes after the last time step
+	bool _recordHashes;
+
+public:
+	SimulationRecorder(SimulationState* simulationState, bool recordHashes);
+
+	void RecordCommands(); // called by SimulationRules before each time step
+	void EndTimeStep(); // called by SimulationRules after each time step
+
+	std::vector<unsigned char> GetLog() const;
+	bool Save(const char* path) const;
+
+private:
+	void WriteMap(binarywriter& writer);
+};
+
+
+#endif
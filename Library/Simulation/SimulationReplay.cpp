@@ -0,0 +1,190 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#include "SimulationReplay.h"
+
+
+
+SimulationReplay::SimulationReplay() :
+_seed(0),
+_timeStep(0),
+_map(nullptr),
+_next(0)
+{
+}
+
+
+SimulationReplay::~SimulationReplay()
+{
+	delete _map;
+}
+
+
+bool SimulationReplay::Load(const unsigned char* data, size_t size)
+{
+	_entries.clear();
+	_hashes.clear();
+	_next = 0;
+
+	binaryreader reader(data, size);
+	if (reader.read<unsigned int>() != SimulationLogMagic || reader.read<unsigned int>() != SimulationLogVersion)
+		return false;
+
+	_seed = reader.read<unsigned int>();
+	_timeStep = reader.read<float>();
+	if (!ReadMap(reader))
+		return false;
+
+	while (!reader.failed())
+	{
+		Entry entry;
+		entry.record = (SimulationLogRecord)reader.read<unsigned char>();
+		if (entry.record == SimulationLogRecordEnd)
+			return !reader.failed();
+
+		entry.tick = reader.read<int>();
+		entry.hash = 0;
+		switch (entry.record)
+		{
+			case SimulationLogRecordUnit:
+				entry.deployment.Read(reader);
+				entry.command.Read(reader);
+				break;
+			case SimulationLogRecordCommand:
+				entry.command.Read(reader);
+				break;
+			case SimulationLogRecordHash:
+				entry.hash = reader.read<unsigned long long>();
+				_hashes[entry.tick] = entry.hash;
+				continue;
+			default:
+				return false;
+		}
+
+		if (!_entries.empty() && entry.tick < _entries.back().tick)
+			return false;
+
+		_entries.push_back(entry);
+	}
+
+	return false;
+}
+
+
+bool SimulationReplay::Load(const char* path)
+{
+	FILE* file = fopen(path, "rb");
+	if (file == nullptr)
+		return false;
+
+	std::vector<unsigned char> data;
+	unsigned char buffer[4096];
+	size_t count;
+	while ((count = fread(buffer, 1, sizeof(buffer), file)) != 0)
+		data.insert(data.end(), buffer, buffer + count);
+	fclose(file);
+
+	return Load(data.data(), data.size());
+}
+
+
+SimulationState* SimulationReplay::CreateSimulationState()
+{
+	SimulationState* result = new SimulationState();
+	result->seed = _seed;
+	result->timeStep = _timeStep;
+
+	if (_map != nullptr)
+	{
+		result->map = new image(_map->_width, _map->_height, _map->_format);
+		memcpy(result->map->_data, _map->_data, _map->_width * _map->_height * _map->components());
+		result->UpdateTerrainGrid();
+	}
+
+	_next = 0;
+	return result;
+}
+
+
+void SimulationReplay::ApplyCommands(SimulationState* simulationState)
+{
+	size_t end = _next;
+	while (end != _entries.size() && _entries[end].tick <= simulationState->tick)
+		++end;
+
+	// deploy first, commands may refer to units deployed after them
+	for (size_t i = _next; i != end; ++i)
+		if (_entries[i].record == SimulationLogRecordUnit)
+			_entries[i].deployment.Apply(simulationState);
+
+	for (size_t i = _next; i != end; ++i)
+		_entries[i].command.Apply(simulationState);
+
+	_next = end;
+}
+
+
+int SimulationReplay::GetLastTick() const
+{
+	int result = _entries.empty() ? 0 : _entries.back().tick;
+	if (!_hashes.empty())
+		result = std::max(result, (*_hashes.rbegin()).first);
+	return result;
+}
+
+
+int SimulationReplay::GetCommandCount() const
+{
+	int result = 0;
+	for (const Entry& entry : _entries)
+		if (entry.record == SimulationLogRecordCommand)
+			++result;
+	return result;
+}
+
+
+bool SimulationReplay::GetHash(int tick, unsigned long long& hash) const
+{
+	std::map<int, unsigned long long>::const_iterator i = _hashes.find(tick);
+	if (i == _hashes.end())
+		return false;
+
+	hash = (*i).second;
+	return true;
+}
+
+
+bool SimulationReplay::ReadMap(binaryreader& reader)
+{
+	delete _map;
+	_map = nullptr;
+
+	int width = reader.read<int>();
+	int height = reader.read<int>();
+	if (width == 0 || height == 0)
+		return !reader.failed();
+
+	GLenum format = (GLenum)reader.read<unsigned int>();
+	if (reader.failed() || width < 0 || height < 0)
+		return false;
+
+	_map = new image(width, height, format);
+
+	int components = _map->components();
+	GLubyte* pixel = _map->_data;
+	GLubyte* end = pixel + _map->_width * _map->_height * components;
+	while (pixel != end)
+	{
+		int run = reader.read<unsigned short>();
+		reader.read_bytes(pixel, components);
+		if (reader.failed() || run == 0 || run * components > end - pixel)
+			return false;
+
+		for (int i = 1; i < run; ++i)
+			memcpy(pixel + i * components, pixel, components);
+		pixel += run * components;
+	}
+
+	return true;
+}
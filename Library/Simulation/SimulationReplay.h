@@ -0,0 +1,60 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#ifndef SIMULATIONREPLAY_H
+#define SIMULATIONREPLAY_H
+
+#include "SimulationRecorder.h"
+
+
+// Plays back a log written by SimulationRecorder. Create a state, then call
+// ApplyCommands() before every time step:
+//
+//   SimulationState* state = replay.CreateSimulationState();
+//   SimulationRules rules(state);
+//   while (state->tick < replay.GetLastTick())
+//   {
+//       replay.ApplyCommands(state);
+//       rules.AdvanceTime(state->timeStep);
+//   }
+
+class SimulationReplay
+{
+	struct Entry
+	{
+		SimulationLogRecord record;
+		int tick;
+		UnitDeployment deployment;
+		UnitCommand command;
+		unsigned long long hash;
+	};
+
+	unsigned int _seed;
+	float _timeStep;
+	image* _map;
+	std::vector<Entry> _entries;
+	std::map<int, unsigned long long> _hashes;
+	size_t _next;
+
+public:
+	SimulationReplay();
+	~SimulationReplay();
+
+	bool Load(const unsigned char* data, size_t size);
+	bool Load(const char* path);
+
+	SimulationState* CreateSimulationState();
+	void ApplyCommands(SimulationState* simulationState);
+
+	int GetLastTick() const;
+	int GetCommandCount() const;
+	bool HasHashes() const { return !_hashes.empty(); }
+	bool GetHash(int tick, unsigned long long& hash) const;
+
+private:
+	bool ReadMap(binaryreader& reader);
+};
+
+
+#endif
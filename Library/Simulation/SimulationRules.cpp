@@ -3,6 +3,8 @@
 // This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
 
 #include "SimulationRules.h"
+#include "SimulationHistory.h"
+#include "SimulationRecorder.h"
 
 
 
@@ -11,15 +13,99 @@ SimulationListener::~SimulationListener()
 }
 
 
+SimulationProfile::SimulationProfile()
+{
+	Reset();
+}
+
+
+void SimulationProfile::Reset()
+{
+	timeSteps = 0;
+	for (int i = 0; i < SimulationPhaseCount; ++i)
+		seconds[i] = 0;
+	fighters = 0;
+	fightersAsleep = 0;
+}
+
+
+double SimulationProfile::GetTotalSeconds() const
+{
+	double result = 0;
+	for (int i = 0; i < SimulationPhaseCount; ++i)
+		result += seconds[i];
+	return result;
+}
+
+
+const char* SimulationProfile::GetPhaseName(SimulationPhase phase)
+{
+	switch (phase)
+	{
+		case SimulationPhaseRebuildQuadTree: return "RebuildQuadTree";
+		case SimulationPhaseMovementRules: return "MovementRules::AdvanceTime";
+		case SimulationPhaseComputeNextState: return "ComputeNextState";
+		case SimulationPhaseAssignNextState: return "AssignNextState";
+		case SimulationPhaseResolveMeleeCombat: return "ResolveMeleeCombat";
+		case SimulationPhaseResolveMissileCombat: return "ResolveMissileCombat";
+		case SimulationPhaseRemoveCasualties: return "RemoveCasualties";
+		case SimulationPhaseRemoveDeadUnits: return "RemoveDeadUnits";
+		default: return "";
+	}
+}
+
+
+class SimulationProfileTimer
+{
+	SimulationProfile* _profile;
+	std::chrono::steady_clock::time_point _time;
+
+public:
+	SimulationProfileTimer(SimulationProfile* profile) : _profile(profile)
+	{
+		if (_profile != nullptr)
+			_time = std::chrono::steady_clock::now();
+	}
+
+	void Lap(SimulationPhase phase)
+	{
+		if (_profile != nullptr)
+		{
+			std::chrono::steady_clock::time_point time = std::chrono::steady_clock::now();
+			_profile->seconds[phase] += std::chrono::duration<double>(time - _time).count();
+			_time = time;
+		}
+	}
+};
+
+
 SimulationRules::SimulationRules(SimulationState* simulationState) :
 _simulationState(simulationState),
 _fighterQuadTree(0, 0, 1024, 1024),
 _weaponQuadTree(0, 0, 1024, 1024),
+_fighterGrid(0, 0, 1024, 1024, 2),
+_weaponGrid(0, 0, 1024, 1024, 2),
+_influenceField(1024, 50, 5),
 _secondsSinceLastTimeStep(0),
 listener(0),
+profile(nullptr),
+workers(nullptr),
+spatialIndex(SpatialIndexQuadTree),
+influenceTolerance(0),
+recorder(nullptr),
+history(nullptr),
+maxTimeStepsPerUpdate(4),
+fighterKernels(FighterKernels::GetBestSupported()),
+aggregateDistance(0),
+allowSleep(false),
+pathJobs(nullptr),
+pathDelay(4),
+maxPlannedPathsPerTimeStep(4),
 currentPlayer(PlayerNone),
 practice(false)
 {
+	for (int player = PlayerNone; player <= Player2; ++player)
+		_unitGrids.push_back(spatialgrid<Unit*>(0, 0, 1024, 1024, 32));
 }
 
 
@@ -32,10 +118,19 @@ void SimulationRules::AdvanceTime(float secondsSinceLastTime)
 	recentCasualties.clear();
 
 	_secondsSinceLastTimeStep += secondsSinceLastTime;
+	int timeSteps = 0;
 	while (_secondsSinceLastTimeStep >= _simulationState->timeStep)
 	{
+		if (maxTimeStepsPerUpdate > 0 && timeSteps == maxTimeStepsPerUpdate)
+		{
+			// catching up would make the next update even longer, let the battle fall behind instead
+			_secondsSinceLastTimeStep = fmodf(_secondsSinceLastTimeStep, _simulationState->timeStep);
+			break;
+		}
+
 		SimulateOneTimeStep();
 		_secondsSinceLastTimeStep -= _simulationState->timeStep;
+		++timeSteps;
 	}
 
 	if (listener != 0)
@@ -46,65 +141,97 @@ void SimulationRules::AdvanceTime(float secondsSinceLastTime)
 		for (const Casualty casualty : recentCasualties)
 			listener->OnCasualty(casualty);
 	}
+}
 
-	if (_simulationState->winner == PlayerNone)
-	{
-		int count1 = 0;
-		int count2 = 0;
 
-		for (std::map<int, Unit*>::iterator i = _simulationState->units.begin(); i != _simulationState->units.end(); ++i)
-		{
-			Unit* unit = (*i).second;
-			if (!unit->state.IsRouting())
-			{
-				switch (unit->player)
-				{
-					case Player1:
-						++count1;
-						break;
-					case Player2:
-						++count2;
-						break;
-					default:
-						break;
-				}
-			}
-		}
+void SimulationRules::ResetSpatialIndex()
+{
+	// the incremental trees start over from the current fighters on the next time step
+	_fighterHandles.clear();
+	_weaponHandles.clear();
+}
 
-		if (count1 == 0)
-			_simulationState->winner = Player2;
-		else if (count2 == 0)
-			_simulationState->winner = Player1;
-	}
+
+bool SimulationRules::Rewind(int tick)
+{
+	if (history == nullptr || !history->Restore(tick, _simulationState))
+		return false;
+
+	ResetSpatialIndex();
+	_secondsSinceLastTimeStep = 0;
+	recentShootings.clear();
+	recentCasualties.clear();
+	return true;
 }
 
 
 void SimulationRules::SimulateOneTimeStep()
 {
+	if (recorder != nullptr)
+		recorder->RecordCommands();
+
+	// the first tick, or the tick rewound to, where the battle may now take another course
+	if (history != nullptr && history->GetLastTick() != _simulationState->tick)
+		history->Record(_simulationState);
+
+	SimulationProfileTimer timer(profile);
+
 	RebuildQuadTree();
+	timer.Lap(SimulationPhaseRebuildQuadTree);
 
-	for (std::map<int, Unit*>::iterator i = _simulationState->units.begin(); i != _simulationState->units.end(); ++i)
-	{
-		Unit* unit = (*i).second;
-		MovementRules::AdvanceTime(unit, _simulationState->timeStep);
-	}
+	AdvanceMovement();
+	timer.Lap(SimulationPhaseMovementRules);
 
 	ComputeNextState();
+	timer.Lap(SimulationPhaseComputeNextState);
 	AssignNextState();
+	timer.Lap(SimulationPhaseAssignNextState);
 
 	ResolveMeleeCombat();
+	timer.Lap(SimulationPhaseResolveMeleeCombat);
 	ResolveMissileCombat();
+	timer.Lap(SimulationPhaseResolveMissileCombat);
 	RemoveCasualties();
+	timer.Lap(SimulationPhaseRemoveCasualties);
 	RemoveDeadUnits();
+	timer.Lap(SimulationPhaseRemoveDeadUnits);
 
 	_simulationState->time += _simulationState->timeStep;
+	++_simulationState->tick;
+
+	// decided every time step, so that the outcome does not depend on the frame rate
+	UpdateWinner();
+
+	if (recorder != nullptr)
+		recorder->EndTimeStep();
+
+	if (history != nullptr)
+		history->Record(_simulationState);
+
+	if (profile != nullptr)
+		++profile->timeSteps;
 }
 
 
 void SimulationRules::RebuildQuadTree()
 {
+	if (spatialIndex == SpatialIndexIncrementalQuadTree)
+	{
+		UpdateQuadTree();
+		return;
+	}
+
+	const FighterStateArrays& state = _simulationState->fighterStore.state;
+
+	bool useGrid = spatialIndex == SpatialIndexGrid;
+
+	_fighterHandles.clear();
+	_weaponHandles.clear();
+
 	_fighterQuadTree.clear();
 	_weaponQuadTree.clear();
+	_fighterGrid.clear();
+	_weaponGrid.clear();
 
 	for (std::map<int, Unit*>::iterator i = _simulationState->units.begin(); i != _simulationState->units.end(); ++i)
 	{
@@ -113,35 +240,297 @@ void SimulationRules::RebuildQuadTree()
 		{
 			for (Fighter* fighter = unit->fighters, * end = fighter + unit->fightersCount; fighter != end; ++fighter)
 			{
-				_fighterQuadTree.insert(fighter->state.position.x, fighter->state.position.y, fighter);
+				glm::vec2 position = state.position[fighter->slot];
+				if (useGrid)
+					_fighterGrid.insert(position.x, position.y, fighter);
+				else
+					_fighterQuadTree.add(position.x, position.y, fighter);
 
 				if (unit->stats.weaponReach > 0)
 				{
-					glm::vec2 d = unit->stats.weaponReach * vector2_from_angle(fighter->state.direction);
-					glm::vec2 p = fighter->state.position + d;
-					_weaponQuadTree.insert(p.x, p.y, fighter);
+					glm::vec2 d = unit->stats.weaponReach * vector2_from_angle(state.direction[fighter->slot]);
+					glm::vec2 p = position + d;
+					if (useGrid)
+						_weaponGrid.insert(p.x, p.y, fighter);
+					else
+						_weaponQuadTree.add(p.x, p.y, fighter);
 				}
 			}
 		}
 	}
+
+	// build now so that the parallel passes only read the indexes
+	if (useGrid)
+	{
+		_fighterGrid.build();
+		_weaponGrid.build();
+	}
+	else
+	{
+		_fighterQuadTree.build();
+		_weaponQuadTree.build();
+	}
+}
+
+
+void SimulationRules::UpdateQuadTree()
+{
+	const FighterStore& store = _simulationState->fighterStore;
+	const FighterStateArrays& state = store.state;
+
+	if (_fighterHandles.empty())
+	{
+		// the trees hold a rebuilt index, start tracking from scratch
+		_fighterQuadTree.clear();
+		_weaponQuadTree.clear();
+	}
+
+	_fighterHandles.resize(store.size, -1);
+	_weaponHandles.resize(store.size, -1);
+
+	for (std::map<int, Unit*>::iterator i = _simulationState->units.begin(); i != _simulationState->units.end(); ++i)
+	{
+		Unit* unit = (*i).second;
+		if (unit->state.unitMode != UnitModeInitializing)
+		{
+			for (Fighter* fighter = unit->fighters, * end = fighter + unit->fightersCount; fighter != end; ++fighter)
+			{
+				int slot = fighter->slot;
+				glm::vec2 position = state.position[slot];
+				if (_fighterHandles[slot] < 0)
+					_fighterHandles[slot] = _fighterQuadTree.track(position.x, position.y, fighter);
+				else
+					_fighterQuadTree.move(_fighterHandles[slot], position.x, position.y);
+
+				if (unit->stats.weaponReach > 0)
+				{
+					glm::vec2 d = unit->stats.weaponReach * vector2_from_angle(state.direction[slot]);
+					glm::vec2 p = position + d;
+					if (_weaponHandles[slot] < 0)
+						_weaponHandles[slot] = _weaponQuadTree.track(p.x, p.y, fighter);
+					else
+						_weaponQuadTree.move(_weaponHandles[slot], p.x, p.y);
+				}
+			}
+		}
+	}
+}
+
+
+void SimulationRules::UntrackFighter(int slot)
+{
+	if (slot < (int)_fighterHandles.size() && _fighterHandles[slot] >= 0)
+	{
+		_fighterQuadTree.remove(_fighterHandles[slot]);
+		_fighterHandles[slot] = -1;
+	}
+
+	if (slot < (int)_weaponHandles.size() && _weaponHandles[slot] >= 0)
+	{
+		_weaponQuadTree.remove(_weaponHandles[slot]);
+		_weaponHandles[slot] = -1;
+	}
+}
+
+
+void SimulationRules::AdvanceMovement()
+{
+	TakePlannedPaths();
+
+	_units.clear();
+	for (std::map<int, Unit*>::iterator i = _simulationState->units.begin(); i != _simulationState->units.end(); ++i)
+		_units.push_back((*i).second);
+
+	// each unit only writes its own movement, formation and fighter slots
+	std::function<void(int, int)> body = [this](int begin, int end) {
+		for (int i = begin; i < end; ++i)
+			MovementRules::AdvanceTime(_simulationState, _units[i], _simulationState->timeStep);
+	};
+
+	if (workers != nullptr)
+		workers->parallel_for(0, (int)_units.size(), 1, body);
+	else
+		body(0, (int)_units.size());
+
+	SubmitPathRequests();
+}
+
+
+void SimulationRules::TakePlannedPaths()
+{
+	// in unit order and due at a set tick, so the battle is the same however long the searches take
+	int tick = _simulationState->tick;
+	int count = 0;
+	for (std::map<int, Unit*>::iterator i = _simulationState->units.begin(); i != _simulationState->units.end(); ++i)
+	{
+		Unit* unit = (*i).second;
+		Movement& movement = unit->movement;
+		if (movement.pathRequestTick == -1 || tick < movement.pathRequestTick + pathDelay)
+			continue;
+		if (maxPlannedPathsPerTimeStep > 0 && count == maxPlannedPathsPerTimeStep)
+			break;
+		++count;
+
+		bool found = false;
+		std::vector<glm::vec2> planned;
+		float forestSpeedFactor = (float)GetForestSpeedFactor(unit->stats.unitPlatform);
+		if (pathJobs == nullptr || !pathJobs->Take(_simulationState, _simulationState->terrainGrid, movement.pathRequestStart, movement.pathRequestDestination, forestSpeedFactor, found, planned))
+			found = _simulationState->pathPlanner.FindPath(_simulationState->terrainGrid, movement.pathRequestStart, movement.pathRequestDestination, forestSpeedFactor, planned);
+
+		// if there is no way, the path is requested again while the target is out of reach
+		if (found)
+			MovementRules::FollowPlannedPath(unit, planned);
+		movement.pathRequestTick = -1;
+	}
+
+	// left by units that died or were restored to an earlier tick, long after they were due
+	if (pathJobs != nullptr)
+		pathJobs->Discard(_simulationState, tick - pathDelay - 150);
+}
+
+
+void SimulationRules::SubmitPathRequests()
+{
+	if (pathJobs == nullptr)
+		return;
+
+	for (Unit* unit : _units)
+	{
+		const Movement& movement = unit->movement;
+		if (movement.pathRequestTick == _simulationState->tick)
+		{
+			float forestSpeedFactor = (float)GetForestSpeedFactor(unit->stats.unitPlatform);
+			pathJobs->Submit(_simulationState, movement.pathRequestTick, _simulationState->terrainGrid, movement.pathRequestStart, movement.pathRequestDestination, forestSpeedFactor);
+		}
+	}
 }
 
 
 void SimulationRules::ComputeNextState()
 {
+	FighterStateArrays& nextState = _simulationState->fighterStore.nextState;
+
+	if (influenceTolerance > 0)
+		BuildInfluenceField();
+	BuildUnitGrids();
+
+	// unit states run serially since NextUnitState updates missileTarget
+	_units.clear();
+	_fighters.clear();
+	int fightersAsleep = 0;
 	for (std::map<int, Unit*>::iterator i = _simulationState->units.begin(); i != _simulationState->units.end(); ++i)
 	{
 		Unit* unit = (*i).second;
 		unit->nextState = NextUnitState(unit);
+		unit->aggregate = NextUnitAggregate(unit);
+		unit->asleep = NextUnitAsleep(unit);
+		if (unit->asleep)
+		{
+			fightersAsleep += unit->fightersCount;
+			continue;
+		}
 
+		_units.push_back(unit);
 		for (Fighter* fighter = unit->fighters, * end = fighter + unit->fightersCount; fighter != end; ++fighter)
-			fighter->nextState = NextFighterState(fighter);
+			_fighters.push_back(fighter);
+	}
+
+	if (profile != nullptr)
+	{
+		profile->fighters += (int)_fighters.size() + fightersAsleep;
+		profile->fightersAsleep += fightersAsleep;
 	}
+
+	// velocities and integrated positions are computed a unit at a time, over its consecutive slots
+	_fighterSpeeds.resize(_simulationState->fighterStore.size);
+	std::function<void(int, int)> motion = [this](int begin, int end) {
+		for (int i = begin; i < end; ++i)
+			NextFighterMotion(_units[i]);
+	};
+
+	if (workers != nullptr)
+		workers->parallel_for(0, (int)_units.size(), 1, motion);
+	else
+		motion(0, (int)_units.size());
+
+	// fighter states only read state and write their own nextState slot
+	std::function<void(int, int)> body = [this, &nextState](int begin, int end) {
+		for (int i = begin; i < end; ++i)
+		{
+			Fighter* fighter = _fighters[i];
+			nextState.Set(fighter->slot, NextFighterState(fighter));
+		}
+	};
+
+	if (workers != nullptr)
+		workers->parallel_for(0, (int)_fighters.size(), 256, body);
+	else
+		body(0, (int)_fighters.size());
+}
+
+
+float SimulationRules::NextUnitInfluence(Unit* unit)
+{
+	float result = 0;
+
+	if (influenceTolerance > 0)
+	{
+		result = -(1 - unit->stats.trainingLevel)
+				* _influenceField.GetInfluence(unit->player, unit->state.center, influenceTolerance);
+	}
+	else
+	{
+		for (std::map<int, Unit*>::iterator i = _simulationState->units.begin(); i != _simulationState->units.end(); ++i)
+		{
+			Unit* other = (*i).second;
+			float distance = glm::length(other->state.center - unit->state.center);
+			float weight = 1.0f * 50.0f / (distance + 50.0f);
+			if (other->player == unit->player)
+			{
+				result -= weight
+						* (1 - other->state.morale)
+						* (1 - unit->stats.trainingLevel)
+						* other->stats.trainingLevel;
+			}
+		}
+	}
+
+	return result;
+}
+
+
+void SimulationRules::BuildInfluenceField()
+{
+	_influenceField.Clear();
+	for (std::map<int, Unit*>::iterator i = _simulationState->units.begin(); i != _simulationState->units.end(); ++i)
+	{
+		Unit* unit = (*i).second;
+		_influenceField.Add(unit->player, unit->state.center, (1 - unit->state.morale) * unit->stats.trainingLevel);
+	}
+	_influenceField.Build();
+}
+
+
+void SimulationRules::BuildUnitGrids()
+{
+	for (spatialgrid<Unit*>& grid : _unitGrids)
+		grid.clear();
+
+	for (std::map<int, Unit*>::iterator i = _simulationState->units.begin(); i != _simulationState->units.end(); ++i)
+	{
+		Unit* unit = (*i).second;
+		_unitGrids[unit->player].insert(unit->state.center.x, unit->state.center.y, unit);
+	}
+
+	for (spatialgrid<Unit*>& grid : _unitGrids)
+		grid.build();
 }
 
 
 void SimulationRules::AssignNextState()
 {
+	FighterStore& store = _simulationState->fighterStore;
+
 	for (std::map<int, Unit*>::iterator i = _simulationState->units.begin(); i != _simulationState->units.end(); ++i)
 	{
 		Unit* unit = (*i).second;
@@ -154,9 +543,18 @@ void SimulationRules::AssignNextState()
 			unit->movement.target = 0;
 		}
 
-		for (Fighter* fighter = unit->fighters, * end = fighter + unit->fightersCount; fighter != end; ++fighter)
+		if (unit->asleep)
 		{
-			fighter->state = fighter->nextState;
+			// not simulated, so nextState was not written
+			for (Fighter* fighter = unit->fighters, * end = fighter + unit->fightersCount; fighter != end; ++fighter)
+			{
+				store.state.velocity[fighter->slot] = glm::vec2();
+				store.state.previousPosition[fighter->slot] = store.state.position[fighter->slot];
+			}
+		}
+		else if (unit->fightersCount != 0)
+		{
+			store.state.Assign(store.nextState, unit->fighters->slot, unit->fightersCount);
 		}
 	}
 }
@@ -164,13 +562,16 @@ void SimulationRules::AssignNextState()
 
 void SimulationRules::ResolveMeleeCombat()
 {
+	FighterStore& store = _simulationState->fighterStore;
+	FighterStateArrays& state = store.state;
+
 	for (std::map<int, Unit*>::iterator i = _simulationState->units.begin(); i != _simulationState->units.end(); ++i)
 	{
 		Unit* unit = (*i).second;
 		bool isMissile = unit->stats.unitWeapon == UnitWeaponArq || unit->stats.unitWeapon == UnitWeaponBow;
 		for (Fighter* fighter = unit->fighters, * end = fighter + unit->fightersCount; fighter != end; ++fighter)
 		{
-			Fighter* meleeTarget = fighter->state.meleeTarget;
+			Fighter* meleeTarget = store.GetFighter(state.meleeTarget[fighter->slot]);
 			if (meleeTarget != 0)
 			{
 				Unit* enemyUnit = meleeTarget->unit;
@@ -182,22 +583,23 @@ void SimulationRules::ResolveMeleeCombat()
 				if (isMissile)
 					killProbability *= 0.15;
 
-				float speed = glm::length(fighter->state.velocity);
+				float speed = glm::length(state.velocity[fighter->slot]);
 				killProbability *= (0.9f + speed / 10.0f);
 
-				float roll = (rand() & 0x7FFF) / (float)0x7FFF;
+				int fighterIndex = (int)(fighter - unit->fighters);
+				float roll = (_simulationState->Roll(SimulationRollMeleeKill, unit->unitId, fighterIndex) & 0x7FFF) / (float)0x7FFF;
 
 				if (roll < killProbability)
 				{
-					meleeTarget->casualty = true;
+					store.casualty[meleeTarget->slot] = 1;
 				}
 				else
 				{
-					meleeTarget->state.readyState = ReadyStateStunned;
-					meleeTarget->state.stunnedTimer = 0.6f;
+					state.readyState[meleeTarget->slot] = ReadyStateStunned;
+					state.stunnedTimer[meleeTarget->slot] = 0.6f;
 				}
 
-				fighter->state.readyingTimer = fighter->unit->stats.readyingDuration;
+				state.readyingTimer[fighter->slot] = unit->stats.readyingDuration;
 			}
 		}
 	}
@@ -229,17 +631,20 @@ void SimulationRules::TriggerShooting(Unit* unit)
 	Shooting shooting;
 	shooting.unitWeapon = unit->stats.unitWeapon;
 
+	const FighterStateArrays& state = _simulationState->fighterStore.state;
+
 	bool arq = shooting.unitWeapon == UnitWeaponArq;
 	float distance = 0;
 
 	for (Fighter* fighter = unit->fighters, * end = fighter + unit->fightersCount; fighter != end; ++fighter)
 	{
-		if (fighter->state.readyState == ReadyStatePrepared)
+		if (state.readyState[fighter->slot] == ReadyStatePrepared)
 		{
 			Projectile projectile;
-			projectile.position1 = fighter->state.position;
+			projectile.position1 = state.position[fighter->slot];
 			projectile.position2 = CalculateFighterMissileTarget(fighter);
-			projectile.delay = (arq ? 0.5f : 0.2f) * ((rand() & 0x7FFF) / (float)0x7FFF);
+			int fighterIndex = (int)(fighter - unit->fighters);
+			projectile.delay = (arq ? 0.5f : 0.2f) * ((_simulationState->Roll(SimulationRollProjectileDelay, unit->unitId, fighterIndex) & 0x7FFF) / (float)0x7FFF);
 			shooting.projectiles.push_back(projectile);
 			distance += glm::length(projectile.position1 - projectile.position2) / unit->fightersCount;
 		}
@@ -248,54 +653,37 @@ void SimulationRules::TriggerShooting(Unit* unit)
 	float speed = arq ? 750 : 75; // meters per second
 	shooting.timeToImpact = distance / speed;
 
-	_simulationState->shootings.push_back(shooting);
+	// counted down one time step at a time, starting with this one, so that
+	// the projectiles hit at the same tick as with the rounding of the countdown
+	float timeToImpact = shooting.timeToImpact;
+	int impactTick = _simulationState->tick;
+	while ((timeToImpact -= _simulationState->timeStep) > 0)
+		++impactTick;
+
+	for (const Projectile& projectile : shooting.projectiles)
+		_simulationState->projectiles.schedule(impactTick, projectile);
+
 	recentShootings.push_back(shooting);
 }
 
 
 void SimulationRules::ResolveProjectileCasualties()
 {
-	for (std::vector<Shooting>::iterator s = _simulationState->shootings.begin(); s != _simulationState->shootings.end(); ++s)
-	{
-		Shooting& shooting = *s;
-
-		shooting.timeToImpact -= _simulationState->timeStep;
-
-		std::vector<Projectile>::iterator i = shooting.projectiles.begin();
-		while (i != shooting.projectiles.end())
-		{
-			Projectile& projectile = *i;
-			if (shooting.timeToImpact <= 0)
-			{
-				glm::vec2 hitpoint = projectile.position2;
-				for (quadtree<Fighter*>::iterator j(_fighterQuadTree.find(hitpoint.x, hitpoint.y, 0.5f)); *j; ++j)
-				{
-					Fighter* fighter = **j;
-					fighter->casualty = true;
-				}
-				shooting.projectiles.erase(i);
-			}
-			else
-			{
-				++i;
-			}
-		}
-	}
+	_simulationState->projectiles.expire(_simulationState->tick, [this](const Projectile& projectile) {
+		if (spatialIndex == SpatialIndexGrid)
+			MarkProjectileCasualties(_fighterGrid, projectile.position2);
+		else
+			MarkProjectileCasualties(_fighterQuadTree, projectile.position2);
+	});
 }
 
 
 void SimulationRules::RemoveCasualties()
 {
-	for (std::map<int, Unit*>::iterator i = _simulationState->units.begin(); i != _simulationState->units.end(); ++i)
-	{
-		Unit* unit = (*i).second;
-		for (Fighter* fighter = unit->fighters, * end = fighter + unit->fightersCount; fighter != end; ++fighter)
-		{
-			if (fighter->state.opponent != 0 && fighter->state.opponent->casualty)
-				fighter->state.opponent = 0;
-		}
-	}
+	FighterStore& store = _simulationState->fighterStore;
+	FighterStateArrays& state = store.state;
 
+	// handles of removed fighters stop resolving, opponents need not be cleared
 	for (std::map<int, Unit*>::iterator i = _simulationState->units.begin(); i != _simulationState->units.end(); ++i)
 	{
 		Unit* unit = (*i).second;
@@ -303,27 +691,42 @@ void SimulationRules::RemoveCasualties()
 		int n = unit->fightersCount;
 		for (int j = 0; j < n; ++j)
 		{
-			if (unit->fighters[j].terrainWater && unit->state.IsRouting())
-				unit->fighters[j].casualty = true;
+			int slot = unit->fighters[j].slot;
+
+			if (unit->state.IsRouting() && _simulationState->terrainGrid.IsWater(state.position[slot]))
+				store.casualty[slot] = 1;
 
-			if (unit->fighters[j].casualty)
+			if (store.casualty[slot])
 			{
 				++unit->state.recentCasualties;
-				recentCasualties.push_back(Casualty(unit->fighters[j].state.position, unit->player, unit->stats.unitPlatform));
+				recentCasualties.push_back(Casualty(state.position[slot], unit->player, unit->stats.unitPlatform));
+				store.Remove(slot);
 			}
 			else
 			{
-				glm::vec2 diff = unit->fighters[j].state.position - glm::vec2(512, 512);
+				glm::vec2 diff = state.position[slot] - glm::vec2(512, 512);
 				if (glm::dot(diff, diff) < 512 * 512)
 				{
+					int indexSlot = unit->fighters[index].slot;
 					if (index < j)
-						unit->fighters[index].state = unit->fighters[j].state;
-					unit->fighters[index].casualty = false;
+						store.Move(indexSlot, slot);
+					store.casualty[indexSlot] = 0;
 					index++;
 				}
+				else
+				{
+					store.Remove(slot);
+				}
 			}
 		}
 
+		// the slots past the new count are no longer in use, their handles have moved or are removed
+		for (int j = index; j < n; ++j)
+		{
+			UntrackFighter(unit->fighters[j].slot);
+			store.handle[unit->fighters[j].slot] = NoFighterHandle;
+		}
+
 		unit->fightersCount = index;
 	}
 }
@@ -360,6 +763,40 @@ void SimulationRules::RemoveDeadUnits()
 }
 
 
+void SimulationRules::UpdateWinner()
+{
+	if (_simulationState->winner == PlayerNone)
+	{
+		int count1 = 0;
+		int count2 = 0;
+
+		for (std::map<int, Unit*>::iterator i = _simulationState->units.begin(); i != _simulationState->units.end(); ++i)
+		{
+			Unit* unit = (*i).second;
+			if (!unit->state.IsRouting())
+			{
+				switch (unit->player)
+				{
+					case Player1:
+						++count1;
+						break;
+					case Player2:
+						++count2;
+						break;
+					default:
+						break;
+				}
+			}
+		}
+
+		if (count1 == 0)
+			_simulationState->winner = Player2;
+		else if (count2 == 0)
+			_simulationState->winner = Player1;
+	}
+}
+
+
 UnitState SimulationRules::NextUnitState(Unit* unit)
 {
 	UnitState result;
@@ -398,7 +835,7 @@ UnitState SimulationRules::NextUnitState(Unit* unit)
 				++result.shootingCounter;
 			}
 
-			result.shootingTimer = 4 + (rand() % 100) / 200.0f;
+			result.shootingTimer = 4 + (_simulationState->Roll(SimulationRollShootingTimer, unit->unitId, 0) % 100) / 200.0f;
 		}
 	}
 	else
@@ -416,19 +853,7 @@ UnitState SimulationRules::NextUnitState(Unit* unit)
 		result.morale += (0.1f + unit->stats.trainingLevel) / 2000;
 	}
 
-	for (std::map<int, Unit*>::iterator i = _simulationState->units.begin(); i != _simulationState->units.end(); ++i)
-	{
-		Unit* other = (*i).second;
-		float distance = glm::length(other->state.center - unit->state.center);
-		float weight = 1.0f * 50.0f / (distance + 50.0f);
-		if (other->player == unit->player)
-		{
-			result.influence -= weight
-					* (1 - other->state.morale)
-					* (1 - unit->stats.trainingLevel)
-					* other->stats.trainingLevel;
-		}
-	}
+	result.influence = NextUnitInfluence(unit);
 
 	if (_simulationState->winner != PlayerNone && unit->player != _simulationState->winner)
 	{
@@ -457,15 +882,24 @@ UnitState SimulationRules::NextUnitState(Unit* unit)
 
 Unit* SimulationRules::ClosestEnemyWithinLineOfFire(Unit* unit)
 {
+	glm::vec2 center = unit->state.center;
 	Unit* closestEnemy = 0;
 	float closestDistance = 10000;
-	for (std::map<int, Unit*>::iterator i = _simulationState->units.begin(); i != _simulationState->units.end(); ++i)
+	for (int player = 0; player < (int)_unitGrids.size(); ++player)
 	{
-		Unit* target = (*i).second;
-		if (target->player != unit->player && IsWithinLineOfFire(unit, target->state.center))
+		if (player == unit->player)
+			continue;
+
+		spatialgrid<Unit*>& grid = _unitGrids[player];
+		for (spatialgrid<Unit*>::iterator i(grid.find_sector(center.x, center.y, unit->stats.maximumRange, unit->state.direction, (float)M_PI_4)); *i; ++i)
 		{
-			float distance = glm::length(target->state.center - unit->state.center);
-			if (distance < closestDistance)
+			Unit* target = **i;
+			float distance = glm::length(target->state.center - center);
+			if (distance < 15)
+				continue;
+
+			// ties go to the lowest unit id, as when scanning the unit map in order
+			if (distance < closestDistance || (distance == closestDistance && closestEnemy != nullptr && target->unitId < closestEnemy->unitId))
 			{
 				closestEnemy = target;
 				closestDistance = distance;
@@ -514,6 +948,71 @@ UnitMode SimulationRules::NextUnitMode(Unit* unit)
 }
 
 
+bool SimulationRules::NextUnitAggregate(Unit* unit)
+{
+	if (aggregateDistance <= 0 || unit->state.unitMode == UnitModeInitializing || unit->state.IsRouting())
+		return false;
+
+	// aggregated units come out at aggregateDistance but only go back a quarter farther out,
+	// so units at the edge do not switch every time step
+	float distance = unit->aggregate ? aggregateDistance : 1.25f * aggregateDistance;
+	glm::vec2 center = unit->state.center;
+	for (int player = 0; player < (int)_unitGrids.size(); ++player)
+	{
+		if (player != unit->player && *_unitGrids[player].find(center.x, center.y, distance))
+			return false;
+	}
+
+	return true;
+}
+
+
+bool SimulationRules::NextUnitAsleep(Unit* unit)
+{
+	if (!allowSleep || unit->fightersCount == 0
+			|| unit->state.unitMode != UnitModeStanding || unit->nextState.unitMode != UnitModeStanding
+			|| unit->nextState.IsRouting() || unit->movement.target != 0 || unit->state.recentCasualties != 0)
+		return false;
+
+	if (unit->asleep && (unit->movement.destination != unit->sleepDestination || unit->formation._direction != unit->sleepDirection))
+		return false;
+
+	// fighters at rest are ready, in place and not fighting, and stay so while asleep
+	const FighterStateArrays& state = _simulationState->fighterStore.state;
+	glm::vec2 center = unit->nextState.center;
+	float radius = 0;
+	for (Fighter* fighter = unit->fighters, * end = fighter + unit->fightersCount; fighter != end; ++fighter)
+	{
+		int slot = fighter->slot;
+		glm::vec2 diff = state.destination[slot] - state.position[slot];
+		if (!unit->asleep && (state.readyState[slot] != ReadyStatePrepared
+				|| state.opponent[slot] != NoFighterHandle
+				|| state.meleeTarget[slot] != NoFighterHandle
+				|| glm::dot(diff, diff) >= 0.01f))
+			return false;
+
+		radius = fmaxf(radius, glm::length(state.position[slot] - center));
+	}
+
+	// other fighters wake the unit before they can strike it or need to get past it,
+	// the margin covers the longest weapon reach and a time step of running
+	const float margin = 10;
+	bool near = spatialIndex == SpatialIndexGrid
+		? IsNearOtherUnits(_fighterGrid, unit, center, radius + margin)
+		: IsNearOtherUnits(_fighterQuadTree, unit, center, radius + margin);
+	if (near)
+		return false;
+
+	if (!unit->asleep)
+	{
+		unit->sleepDestination = unit->movement.destination;
+		unit->sleepDirection = unit->formation._direction;
+	}
+
+	return true;
+}
+
+
 float SimulationRules::NextUnitDirection(Unit* unit)
 {
 	if (true) // unit->movement
@@ -523,25 +1022,51 @@ float SimulationRules::NextUnitDirection(Unit* unit)
 }
 
 
+void SimulationRules::NextFighterMotion(Unit* unit)
+{
+	if (unit->fightersCount == 0)
+		return;
+
+	FighterStore& store = _simulationState->fighterStore;
+	int first = unit->fighters->slot;
+	for (Fighter* fighter = unit->fighters, * end = fighter + unit->fightersCount; fighter != end; ++fighter)
+		_fighterSpeeds[fighter->slot] = NextFighterSpeed(fighter);
+
+	// written to nextState ahead of NextFighterState, which reads them back
+	FighterKernels::NextVelocity(fighterKernels, &store.state.position[first], &store.state.destination[first],
+		&_fighterSpeeds[first], &store.nextState.velocity[first], unit->fightersCount);
+	FighterKernels::IntegratePosition(fighterKernels, &store.state.position[first], &store.state.velocity[first],
+		_simulationState->timeStep, &store.nextState.position[first], unit->fightersCount);
+}
+
+
 FighterState SimulationRules::NextFighterState(Fighter* fighter)
 {
-	const FighterState& original = fighter->state;
+	const FighterStore& store = _simulationState->fighterStore;
+	const FighterStateArrays& original = store.state;
+	int slot = fighter->slot;
 	FighterState result;
 
-	result.readyState = original.readyState;
+	result.readyState = original.readyState[slot];
 	result.position = NextFighterPosition(fighter);
-	result.velocity = NextFighterVelocity(fighter);
+	result.velocity = store.nextState.velocity[slot];
+
+	// fighters placed in formation by this time step do not move there from the origin
+	result.previousPosition = fighter->unit->state.unitMode == UnitModeInitializing ? result.position : original.position[slot];
+
+	Fighter* opponent = store.GetFighter(original.opponent[slot]);
+	glm::vec2 position = original.position[slot];
 
 
 	// DIRECTION
 
 	if (fighter->unit->state.unitMode == UnitModeMoving)
 	{
-		result.direction = angle(original.velocity);
+		result.direction = angle(original.velocity[slot]);
 	}
-	else if (original.opponent != 0)
+	else if (opponent != 0)
 	{
-		result.direction = angle(original.opponent->state.position - original.position);
+		result.direction = angle(original.position[opponent->slot] - position);
 	}
 	else
 	{
@@ -551,41 +1076,44 @@ FighterState SimulationRules::NextFighterState(Fighter* fighter)
 
 	// OPPONENT
 
-	if (original.opponent != 0 && glm::length(original.position - original.opponent->state.position) <= fighter->unit->stats.weaponReach * 2)
+	if (opponent != 0 && glm::length(position - original.position[opponent->slot]) <= fighter->unit->stats.weaponReach * 2)
 	{
-		result.opponent = original.opponent;
+		result.opponent = store.GetHandle(opponent);
 	}
-	else if (fighter->unit->state.unitMode != UnitModeMoving && !fighter->unit->state.IsRouting())
+	else if (fighter->unit->state.unitMode != UnitModeMoving && !fighter->unit->state.IsRouting() && !fighter->unit->aggregate)
 	{
-		result.opponent = FindFighterStrikingTarget(fighter);
+		result.opponent = store.GetHandle(FindFighterStrikingTarget(fighter));
 	}
 
 	// DESTINATION
 
-	if (original.opponent != 0)
+	if (opponent != 0)
 	{
-		result.destination = original.opponent->state.position
-				- fighter->unit->stats.weaponReach * vector2_from_angle(original.direction);
+		result.destination = original.position[opponent->slot]
+				- fighter->unit->stats.weaponReach * vector2_from_angle(original.direction[slot]);
 	}
 	else
 	{
-		switch (original.readyState)
+		switch (original.readyState[slot])
 		{
 			case ReadyStateUnready:
 			case ReadyStateReadying:
 			case ReadyStatePrepared:
-				result.destination = MovementRules::NextFighterDestination(fighter);
+				if (fighter->unit->aggregate)
+					result.destination = MovementRules::NextAggregateDestination(fighter);
+				else
+					result.destination = MovementRules::NextFighterDestination(fighter);
 				break;
 
 			default:
-				result.destination = original.position;
+				result.destination = position;
 				break;
 		}
 	}
 
 	// READY STATE
 
-	switch (original.readyState)
+	switch (original.readyState[slot])
 	{
 		case ReadyStateUnready:
 			if (fighter->unit->movement.target != 0)
@@ -600,9 +1128,9 @@ FighterState SimulationRules::NextFighterState(Fighter* fighter)
 			break;
 
 		case ReadyStateReadying:
-			if (original.readyingTimer > _simulationState->timeStep)
+			if (original.readyingTimer[slot] > _simulationState->timeStep)
 			{
-				result.readyingTimer = original.readyingTimer - _simulationState->timeStep;
+				result.readyingTimer = original.readyingTimer[slot] - _simulationState->timeStep;
 			}
 			else
 			{
@@ -616,7 +1144,7 @@ FighterState SimulationRules::NextFighterState(Fighter* fighter)
 			{
 				result.readyState = ReadyStateUnready;
 			}
-			else if (result.opponent != 0)
+			else if (result.opponent != NoFighterHandle)
 			{
 				result.readyState = ReadyStateStriking;
 				result.strikingTimer = fighter->unit->stats.strikingDuration;
@@ -624,14 +1152,14 @@ FighterState SimulationRules::NextFighterState(Fighter* fighter)
 			break;
 
 		case ReadyStateStriking:
-			if (original.strikingTimer > _simulationState->timeStep)
+			if (original.strikingTimer[slot] > _simulationState->timeStep)
 			{
-				result.strikingTimer = original.strikingTimer - _simulationState->timeStep;
-				result.opponent = original.opponent;
+				result.strikingTimer = original.strikingTimer[slot] - _simulationState->timeStep;
+				result.opponent = store.GetHandle(opponent);
 			}
 			else
 			{
-				result.meleeTarget = original.opponent;
+				result.meleeTarget = store.GetHandle(opponent);
 				result.strikingTimer = 0;
 				result.readyState = ReadyStateReadying;
 				result.readyingTimer = fighter->unit->stats.readyingDuration;
@@ -639,9 +1167,9 @@ FighterState SimulationRules::NextFighterState(Fighter* fighter)
 			break;
 
 		case ReadyStateStunned:
-			if (original.stunnedTimer > _simulationState->timeStep)
+			if (original.stunnedTimer[slot] > _simulationState->timeStep)
 			{
-				result.stunnedTimer = original.stunnedTimer - _simulationState->timeStep;
+				result.stunnedTimer = original.stunnedTimer[slot] - _simulationState->timeStep;
 			}
 			else
 			{
@@ -670,62 +1198,81 @@ glm::vec2 SimulationRules::NextFighterPosition(Fighter* fighter)
 	}
 	else
 	{
-		glm::vec2 result = fighter->state.position + fighter->state.velocity * _simulationState->timeStep;
-		glm::vec2 adjust;
-		int count = 0;
+		glm::vec2 result = _simulationState->fighterStore.nextState.position[fighter->slot]; // integrated by NextFighterMotion
+		if (unit->aggregate)
+			return result;
+
+		if (spatialIndex == SpatialIndexGrid)
+			return AvoidFighterObstacles(_fighterGrid, _weaponGrid, fighter, result);
+		else
+			return AvoidFighterObstacles(_fighterQuadTree, _weaponQuadTree, fighter, result);
+	}
+}
+
+
+template <class Index> glm::vec2 SimulationRules::AvoidFighterObstacles(Index& fighterIndex, Index& weaponIndex, Fighter* fighter, glm::vec2 result)
+{
+	const FighterStateArrays& state = _simulationState->fighterStore.state;
+	Unit* unit = fighter->unit;
 
-		const float fighterDistance = 0.9f;
+	glm::vec2 adjust;
+	int count = 0;
 
-		for (quadtree<Fighter*>::iterator i(_fighterQuadTree.find(result.x, result.y, fighterDistance)); *i; ++i)
+	const float fighterDistance = 0.9f;
+
+	for (typename Index::iterator i(fighterIndex.find(result.x, result.y, fighterDistance)); *i; ++i)
+	{
+		Fighter* obstacle = **i;
+		if (obstacle != fighter)
 		{
-			Fighter* obstacle = **i;
-			if (obstacle != fighter)
+			glm::vec2 position = state.position[obstacle->slot];
+			glm::vec2 diff = position - result;
+			if (glm::dot(diff, diff) < fighterDistance * fighterDistance)
 			{
-				glm::vec2 position = obstacle->state.position;
-				glm::vec2 diff = position - result;
-				if (glm::dot(diff, diff) < fighterDistance * fighterDistance)
-				{
-					adjust -= glm::normalize(diff) * fighterDistance;
-					++count;
-				}
+				adjust -= glm::normalize(diff) * fighterDistance;
+				++count;
 			}
 		}
+	}
 
-		const float weaponDistance = 0.75f;
+	const float weaponDistance = 0.75f;
 
-		for (quadtree<Fighter*>::iterator i(_weaponQuadTree.find(result.x, result.y, weaponDistance)); *i; ++i)
+	for (typename Index::iterator i(weaponIndex.find(result.x, result.y, weaponDistance)); *i; ++i)
+	{
+		Fighter* obstacle = **i;
+		if (obstacle->unit->player != unit->player)
 		{
-			Fighter* obstacle = **i;
-			if (obstacle->unit->player != unit->player)
+			glm::vec2 r = obstacle->unit->stats.weaponReach * vector2_from_angle(state.direction[obstacle->slot]);
+			glm::vec2 position = state.position[obstacle->slot] + r;
+			glm::vec2 diff = position - result;
+			if (glm::dot(diff, diff) < weaponDistance * weaponDistance)
 			{
-				glm::vec2 r = obstacle->unit->stats.weaponReach * vector2_from_angle(obstacle->state.direction);
-				glm::vec2 position = obstacle->state.position + r;
-				glm::vec2 diff = position - result;
-				if (glm::dot(diff, diff) < weaponDistance * weaponDistance)
-				{
-					diff = obstacle->state.position - result;
-					adjust -= glm::normalize(diff) * weaponDistance;
-					++count;
-				}
+				diff = state.position[obstacle->slot] - result;
+				adjust -= glm::normalize(diff) * weaponDistance;
+				++count;
 			}
 		}
+	}
 
-		if (count != 0)
-		{
-			result += adjust / (float)count;
-		}
-
-		return result;
+	if (count != 0)
+	{
+		result += adjust / (float)count;
 	}
+
+	return result;
 }
 
 
-glm::vec2 SimulationRules::NextFighterVelocity(Fighter* fighter)
+float SimulationRules::NextFighterSpeed(Fighter* fighter)
 {
+	const FighterStore& store = _simulationState->fighterStore;
+	const FighterStateArrays& state = store.state;
+	int slot = fighter->slot;
+
 	Unit* unit = fighter->unit;
 	float speed = unit->GetSpeed();
 
-	switch (fighter->state.readyState)
+	switch (state.readyState[slot])
 	{
 		case ReadyStateStriking:
 			speed = unit->stats.walkingSpeed / 4;
@@ -739,45 +1286,31 @@ glm::vec2 SimulationRules::NextFighterVelocity(Fighter* fighter)
 			break;
 	}
 
-	if (glm::length(fighter->state.position - fighter->terrainPosition) > 5)
-	{
-		int x = (int)(512 * fighter->state.position.x / 1024);
-		int y = (int)(512 * fighter->state.position.y / 1024);
-		glm::vec4 c = _simulationState->map->get_pixel(x, y);
+	if (_simulationState->terrainGrid.IsForest(state.position[slot]))
+		speed *= GetForestSpeedFactor(unit->stats.unitPlatform);
 
-		fighter->terrainPosition = fighter->state.position;
-		fighter->terrainForest = c.g > 0.5;
-		fighter->terrainWater = c.b > 0.5;
-	}
-
-	if (fighter->terrainForest)
-	{
-		if (unit->stats.unitPlatform == UnitPlatformCav || unit->stats.unitPlatform == UnitPlatformGen)
-			speed *= 0.5;
-		else
-			speed *= 0.9;
-	}
-
-	glm::vec2 diff = fighter->state.destination - fighter->state.position;
-	float diff_len = glm::dot(diff, diff);
-	if (diff_len < 0.01)
-		return diff;
+	return speed;
+}
 
-	glm::vec2 delta = glm::normalize(diff) * speed;
-	float delta_len = glm::dot(delta, delta);
 
-	return delta_len < diff_len ? delta : diff;
+Fighter* SimulationRules::FindFighterStrikingTarget(Fighter* fighter)
+{
+	if (spatialIndex == SpatialIndexGrid)
+		return FindFighterStrikingTarget(_fighterGrid, fighter);
+	else
+		return FindFighterStrikingTarget(_fighterQuadTree, fighter);
 }
 
 
-Fighter* SimulationRules::FindFighterStrikingTarget(Fighter* fighter)
+template <class Index> Fighter* SimulationRules::FindFighterStrikingTarget(Index& fighterIndex, Fighter* fighter)
 {
+	const FighterStateArrays& state = _simulationState->fighterStore.state;
 	Unit* unit = fighter->unit;
 
-	glm::vec2 position = fighter->state.position + unit->stats.weaponReach * vector2_from_angle(fighter->state.direction);
+	glm::vec2 position = state.position[fighter->slot] + unit->stats.weaponReach * vector2_from_angle(state.direction[fighter->slot]);
 	float radius = 1.1f;
 
-	for (quadtree<Fighter*>::iterator i(_fighterQuadTree.find(position.x, position.y, radius)); *i; ++i)
+	for (typename Index::iterator i(fighterIndex.find(position.x, position.y, radius)); *i; ++i)
 	{
 		Fighter* target = **i;
 		if (target != fighter && target->unit->player != unit->player)
@@ -790,14 +1323,38 @@ Fighter* SimulationRules::FindFighterStrikingTarget(Fighter* fighter)
 }
 
 
+template <class Index> bool SimulationRules::IsNearOtherUnits(Index& fighterIndex, Unit* unit, glm::vec2 center, float radius)
+{
+	for (typename Index::iterator i(fighterIndex.find(center.x, center.y, radius)); *i; ++i)
+	{
+		Fighter* fighter = **i;
+		if (fighter->unit != unit)
+			return true;
+	}
+
+	return false;
+}
+
+
+template <class Index> void SimulationRules::MarkProjectileCasualties(Index& fighterIndex, glm::vec2 hitpoint)
+{
+	for (typename Index::iterator i(fighterIndex.find(hitpoint.x, hitpoint.y, 0.5f)); *i; ++i)
+	{
+		Fighter* fighter = **i;
+		fighter->SetCasualty(true);
+	}
+}
+
+
 glm::vec2 SimulationRules::CalculateFighterMissileTarget(Fighter* fighter)
 {
 	Unit* unit = fighter->unit;
 
 	if (unit->missileTarget)
 	{
-		float dx = 10.0f * ((rand() & 255) / 128.0f - 1.0f);
-		float dy = 10.0f * ((rand() & 255) / 127.0f - 1.0f);
+		int fighterIndex = (int)(fighter - unit->fighters);
+		float dx = 10.0f * ((_simulationState->Roll(SimulationRollMissileTargetX, unit->unitId, fighterIndex) & 255) / 128.0f - 1.0f);
+		float dy = 10.0f * ((_simulationState->Roll(SimulationRollMissileTargetY, unit->unitId, fighterIndex) & 255) / 127.0f - 1.0f);
 		return unit->missileTarget->state.center + glm::vec2(dx, dy);
 	}
 
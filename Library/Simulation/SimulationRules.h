@@ -6,11 +6,18 @@
 #define SIMULATIONRULES_H
 
 #include "SimulationState.h"
+#include "FighterKernels.h"
+#include "InfluenceField.h"
+#include "PathJobQueue.h"
 #include "quadtree.h"
+#include "spatialgrid.h"
+#include "taskpool.h"
 
 class BattleModel;
 class Fighter;
 class Unit;
+class SimulationHistory;
+class SimulationRecorder;
 
 
 class SimulationListener
@@ -23,13 +30,60 @@ public:
 };
 
 
+enum SimulationPhase
+{
+	SimulationPhaseRebuildQuadTree,
+	SimulationPhaseMovementRules,
+	SimulationPhaseComputeNextState,
+	SimulationPhaseAssignNextState,
+	SimulationPhaseResolveMeleeCombat,
+	SimulationPhaseResolveMissileCombat,
+	SimulationPhaseRemoveCasualties,
+	SimulationPhaseRemoveDeadUnits,
+	SimulationPhaseCount
+};
+
+
+struct SimulationProfile
+{
+	int timeSteps;
+	double seconds[SimulationPhaseCount];
+	long long fighters; // summed over time steps
+	long long fightersAsleep; // skipped by the fighter passes, summed over time steps
+
+	SimulationProfile();
+
+	void Reset();
+	double GetTotalSeconds() const;
+
+	static const char* GetPhaseName(SimulationPhase phase);
+};
+
+
+enum SpatialIndex
+{
+	SpatialIndexQuadTree,
+	SpatialIndexIncrementalQuadTree, // only fighters leaving their quadtree node are relocated
+	SpatialIndexGrid
+};
+
+
 class SimulationRules
 {
 public:
 	SimulationState* _simulationState;
 	quadtree<Fighter*> _weaponQuadTree;
 	quadtree<Fighter*> _fighterQuadTree;
+	spatialgrid<Fighter*> _weaponGrid;
+	spatialgrid<Fighter*> _fighterGrid;
+	std::vector<int> _fighterHandles; // quadtree handle per fighter slot, -1 if not in the tree
+	std::vector<int> _weaponHandles;
+	InfluenceField _influenceField;
+	std::vector<spatialgrid<Unit*>> _unitGrids; // unit centers, indexed by player
 	float _secondsSinceLastTimeStep;
+	std::vector<Unit*> _units;
+	std::vector<Fighter*> _fighters;
+	std::vector<float> _fighterSpeeds; // by slot, input to FighterKernels::NextVelocity()
 
 public:
 	Player currentPlayer;
@@ -37,17 +91,47 @@ public:
 	SimulationListener* listener;
 	std::vector<Shooting> recentShootings;
 	std::vector<Casualty> recentCasualties;
+	SimulationProfile* profile; // optional, accumulates time spent in each phase
+	taskpool* workers; // optional, runs the per-unit and per-fighter passes in parallel
+	SpatialIndex spatialIndex; // structure used for fighter lookups
+	float influenceTolerance; // relative error allowed in unit morale influence, 0 for the exact sum, faster below some 100 units
+	SimulationRecorder* recorder; // optional, logs the commands given before each time step
+	SimulationHistory* history; // optional, keeps recent states for Rewind()
+	int maxTimeStepsPerUpdate; // time steps run by one AdvanceTime() at most, 0 for no limit
+	FighterKernelSet fighterKernels; // the best supported by default, all give the same results
+	float aggregateDistance; // units with no enemy unit this close move as a formation, see Unit::aggregate, 0 for never
+	bool allowSleep; // standing units with all fighters at rest skip the fighter passes, see Unit::asleep
+	PathJobQueue* pathJobs; // optional, searches planned paths in the background, else they are searched when due
+	int pathDelay; // time steps from a unit requesting a planned path to following it
+	int maxPlannedPathsPerTimeStep; // planned paths followed in one time step at most, the rest wait, 0 for no limit
 
 	SimulationRules(SimulationState* simulationState);
 
 	void AdvanceTime(float secondsSinceLastTime);
+	void ResetSpatialIndex(); // call when the fighters are replaced, e.g. by SimulationSnapshot::Restore()
+	bool Rewind(int tick); // restores a tick kept by history
+
+	// the pull of the morale of a unit's friends on it, as each time step computes it; the field is built
+	// by each time step when influenceTolerance is not 0, and must be built before NextUnitInfluence() then
+	void BuildInfluenceField();
+	float NextUnitInfluence(Unit* unit);
+
+	// how far the time since the last time step is into the next one, 0 to 1, for rendering fighters
+	// at Fighter::GetInterpolatedPosition()
+	float GetInterpolationFactor() const { return fminf(_secondsSinceLastTimeStep / _simulationState->timeStep, 1); }
 
 private:
 	void SimulateOneTimeStep();
 
 	void RebuildQuadTree();
+	void UpdateQuadTree();
+	void UntrackFighter(int slot);
+	void AdvanceMovement();
+	void TakePlannedPaths();
+	void SubmitPathRequests();
 
 	void ComputeNextState();
+	void BuildUnitGrids();
 	void AssignNextState();
 
 	void ResolveMeleeCombat();
@@ -58,17 +142,27 @@ private:
 
 	void RemoveCasualties();
 	void RemoveDeadUnits();
+	void UpdateWinner();
 
 	UnitState NextUnitState(Unit* unit);
 	UnitMode NextUnitMode(Unit* unit);
+	bool NextUnitAggregate(Unit* unit);
+	bool NextUnitAsleep(Unit* unit);
 	//glm::vec2 CalculateUnitCenter(Unit* unit);
 	float NextUnitDirection(Unit* unit);
 
+	void NextFighterMotion(Unit* unit);
 	FighterState NextFighterState(Fighter* fighter);
 	glm::vec2 NextFighterPosition(Fighter* fighter);
-	glm::vec2 NextFighterVelocity(Fighter* fighter);
+	float NextFighterSpeed(Fighter* fighter);
 
 	Fighter* FindFighterStrikingTarget(Fighter* fighter);
+
+	template <class Index> glm::vec2 AvoidFighterObstacles(Index& fighterIndex, Index& weaponIndex, Fighter* fighter, glm::vec2 result);
+	template <class Index> Fighter* FindFighterStrikingTarget(Index& fighterIndex, Fighter* fighter);
+	template <class Index> bool IsNearOtherUnits(Index& fighterIndex, Unit* unit, glm::vec2 center, float radius);
+	template <class Index> void MarkProjectileCasualties(Index& fighterIndex, glm::vec2 hitpoint);
+
 	glm::vec2 CalculateFighterMissileTarget(Fighter* fighter);
 
 	bool IsWithinLineOfFire(Unit* unit, glm::vec2 position);
@@ -0,0 +1,382 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#include "SimulationSnapshot.h"
+
+
+static_assert(sizeof(ReadyState) == sizeof(int), "ready states are stored as int");
+
+
+static size_t AlignBlock(size_t offset)
+{
+	return (offset + 15) & ~(size_t)15;
+}
+
+
+static size_t GetBlockSize(const SnapshotHeader& header, SnapshotBlock block)
+{
+	size_t fighters = (size_t)header.fighterCount;
+	switch (block)
+	{
+		case SnapshotBlockUnits: return header.unitCount * sizeof(SnapshotUnit);
+		case SnapshotBlockPath: return header.pathCount * sizeof(glm::vec2);
+		case SnapshotBlockProjectiles: return header.projectileCount * sizeof(SnapshotProjectile);
+		case SnapshotBlockPosition: return fighters * sizeof(glm::vec2);
+		case SnapshotBlockReadyState: return fighters * sizeof(int);
+		case SnapshotBlockReadyingTimer: return fighters * sizeof(float);
+		case SnapshotBlockStrikingTimer: return fighters * sizeof(float);
+		case SnapshotBlockStunnedTimer: return fighters * sizeof(float);
+		case SnapshotBlockOpponent: return fighters * sizeof(FighterHandle);
+		case SnapshotBlockDestination: return fighters * sizeof(glm::vec2);
+		case SnapshotBlockVelocity: return fighters * sizeof(glm::vec2);
+		case SnapshotBlockDirection: return fighters * sizeof(float);
+		case SnapshotBlockMeleeTarget: return fighters * sizeof(FighterHandle);
+		case SnapshotBlockHandle: return fighters * sizeof(FighterHandle);
+		case SnapshotBlockCasualty: return fighters;
+		default: return 0;
+	}
+}
+
+
+template <class T> static T* GetBlock(unsigned char* data, const SnapshotHeader& header, SnapshotBlock block)
+{
+	return reinterpret_cast<T*>(data + header.offsets[block]);
+}
+
+
+template <class T> static const T* GetBlock(const unsigned char* data, const SnapshotHeader& header, SnapshotBlock block)
+{
+	return reinterpret_cast<const T*>(data + header.offsets[block]);
+}
+
+
+template <class T> static void WriteBlock(unsigned char* data, const SnapshotHeader& header, SnapshotBlock block, const std::vector<T>& values)
+{
+	if (!values.empty())
+		memcpy(data + header.offsets[block], values.data(), values.size() * sizeof(T));
+}
+
+
+template <class T> static void ReadBlock(const unsigned char* data, const SnapshotHeader& header, SnapshotBlock block, std::vector<T>& values)
+{
+	if (!values.empty())
+		memcpy(values.data(), data + header.offsets[block], values.size() * sizeof(T));
+}
+
+
+static bool IsHandleBlock(const unsigned char* data, const SnapshotHeader& header, SnapshotBlock block)
+{
+	// there is a handle per slot, handed out as slots are allocated
+	const FighterHandle* handles = GetBlock<FighterHandle>(data, header, block);
+	for (int i = 0; i < header.fighterCount; ++i)
+		if (handles[i] < NoFighterHandle || handles[i] >= header.fighterCount)
+			return false;
+	return true;
+}
+
+
+static void DeleteUnit(Unit* unit)
+{
+	delete[] unit->fighters;
+	delete unit;
+}
+
+
+/***/
+
+
+void SimulationSnapshot::Write(const SimulationState* simulationState, std::vector<unsigned char>& buffer)
+{
+	const FighterStore& store = simulationState->fighterStore;
+
+	SnapshotHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = SimulationSnapshotMagic;
+	header.version = SimulationSnapshotVersion;
+	header.unitSize = sizeof(SnapshotUnit);
+	header.tick = simulationState->tick;
+	header.time = simulationState->time;
+	header.timeStep = simulationState->timeStep;
+	header.seed = simulationState->seed;
+	header.lastUnitId = simulationState->lastUnitId;
+	header.winner = simulationState->winner;
+	header.unitCount = (int)simulationState->units.size();
+	header.fighterCount = store.size;
+	header.projectileCount = simulationState->projectiles.size();
+
+	// a unit's slots run up to the first slot of the next unit, including the
+	// slots of removed fighters
+	std::vector<int> firstSlots;
+	for (std::map<int, Unit*>::const_iterator i = simulationState->units.begin(); i != simulationState->units.end(); ++i)
+	{
+		const Unit* unit = (*i).second;
+		header.pathCount += (int)unit->movement.path.size();
+		if (unit->fightersCount != 0)
+			firstSlots.push_back(unit->fighters[0].slot);
+	}
+	firstSlots.push_back(store.size);
+	std::sort(firstSlots.begin(), firstSlots.end());
+
+	size_t size = AlignBlock(sizeof(SnapshotHeader));
+	for (int block = 0; block < SnapshotBlockCount; ++block)
+	{
+		header.offsets[block] = (unsigned int)size;
+		size = AlignBlock(size + GetBlockSize(header, (SnapshotBlock)block));
+	}
+	header.size = (unsigned int)size;
+
+	buffer.resize(size);
+	unsigned char* data = buffer.data();
+	memcpy(data, &header, sizeof(header));
+
+	// clear the alignment padding, so that equal states give equal bytes
+	memset(data + sizeof(header), 0, header.offsets[0] - sizeof(header));
+	for (int block = 0; block < SnapshotBlockCount; ++block)
+	{
+		size_t end = header.offsets[block] + GetBlockSize(header, (SnapshotBlock)block);
+		memset(data + end, 0, header.offsets[block] + GetBlockSpan(header, (SnapshotBlock)block) - end);
+	}
+
+	SnapshotUnit* units = GetBlock<SnapshotUnit>(data, header, SnapshotBlockUnits);
+	glm::vec2* path = GetBlock<glm::vec2>(data, header, SnapshotBlockPath);
+	int pathFirst = 0;
+
+	for (std::map<int, Unit*>::const_iterator i = simulationState->units.begin(); i != simulationState->units.end(); ++i)
+	{
+		const Unit* unit = (*i).second;
+		SnapshotUnit* snapshotUnit = units++;
+		memset(static_cast<void*>(snapshotUnit), 0, sizeof(SnapshotUnit)); // no stray padding bytes
+
+		snapshotUnit->unitId = unit->unitId;
+		snapshotUnit->player = unit->player;
+		snapshotUnit->fightersCount = unit->fightersCount;
+		if (unit->fightersCount != 0)
+		{
+			int firstSlot = unit->fighters[0].slot;
+			snapshotUnit->firstSlot = firstSlot;
+			snapshotUnit->fighterCapacity = *std::upper_bound(firstSlots.begin(), firstSlots.end(), firstSlot) - firstSlot;
+		}
+
+		snapshotUnit->shootingCounter = unit->shootingCounter;
+		snapshotUnit->timeUntilSwapFighters = unit->timeUntilSwapFighters;
+		snapshotUnit->aggregate = unit->aggregate ? 1 : 0;
+		snapshotUnit->asleep = unit->asleep ? 1 : 0;
+		snapshotUnit->sleepDestination = unit->sleepDestination;
+		snapshotUnit->sleepDirection = unit->sleepDirection;
+		snapshotUnit->stats = unit->stats;
+		snapshotUnit->state = unit->state;
+		snapshotUnit->formation = unit->formation;
+
+		const Movement& movement = unit->movement;
+		snapshotUnit->pathFirst = pathFirst;
+		snapshotUnit->pathCount = (int)movement.path.size();
+		snapshotUnit->path_t0 = movement.path_t0;
+		snapshotUnit->destination = movement.destination;
+		snapshotUnit->direction = movement.direction;
+		snapshotUnit->targetUnitId = movement.target != nullptr ? movement.target->unitId : 0;
+		snapshotUnit->running = movement.running ? 1 : 0;
+		snapshotUnit->pathRequestTick = movement.pathRequestTick;
+		snapshotUnit->pathRequestStart = movement.pathRequestStart;
+		snapshotUnit->pathRequestDestination = movement.pathRequestDestination;
+		snapshotUnit->pathRequestTargetId = movement.pathRequestTargetId;
+		snapshotUnit->missileTargetUnitId = unit->missileTarget != nullptr ? unit->missileTarget->unitId : 0;
+		snapshotUnit->missileTargetLocked = unit->missileTargetLocked ? 1 : 0;
+
+		for (glm::vec2 point : movement.path)
+			path[pathFirst++] = point;
+	}
+
+	// restored by scheduling in the same order, so projectiles due at the same tick keep their order
+	SnapshotProjectile* projectiles = GetBlock<SnapshotProjectile>(data, header, SnapshotBlockProjectiles);
+	simulationState->projectiles.for_each([&projectiles](int tick, const Projectile& projectile) {
+		projectiles->projectile = projectile;
+		projectiles->impactTick = tick;
+		++projectiles;
+	});
+
+	const FighterStateArrays& state = store.state;
+	WriteBlock(data, header, SnapshotBlockPosition, state.position);
+	WriteBlock(data, header, SnapshotBlockReadyState, state.readyState);
+	WriteBlock(data, header, SnapshotBlockReadyingTimer, state.readyingTimer);
+	WriteBlock(data, header, SnapshotBlockStrikingTimer, state.strikingTimer);
+	WriteBlock(data, header, SnapshotBlockStunnedTimer, state.stunnedTimer);
+	WriteBlock(data, header, SnapshotBlockOpponent, state.opponent);
+	WriteBlock(data, header, SnapshotBlockDestination, state.destination);
+	WriteBlock(data, header, SnapshotBlockVelocity, state.velocity);
+	WriteBlock(data, header, SnapshotBlockDirection, state.direction);
+	WriteBlock(data, header, SnapshotBlockMeleeTarget, state.meleeTarget);
+	WriteBlock(data, header, SnapshotBlockHandle, store.handle);
+	WriteBlock(data, header, SnapshotBlockCasualty, store.casualty);
+}
+
+
+bool SimulationSnapshot::Restore(const unsigned char* data, size_t size, SimulationState* simulationState)
+{
+	const SnapshotHeader* header = GetHeader(data, size);
+	if (header == nullptr)
+		return false;
+
+	const SnapshotUnit* units = GetBlock<SnapshotUnit>(data, *header, SnapshotBlockUnits);
+
+	for (const SnapshotUnit* unit = units, * end = units + header->unitCount; unit != end; ++unit)
+	{
+		if (unit->fightersCount < 0 || unit->fightersCount > unit->fighterCapacity
+			|| unit->firstSlot < 0 || unit->fighterCapacity > header->fighterCount - unit->firstSlot
+			|| unit->pathFirst < 0 || unit->pathCount < 0 || unit->pathCount > header->pathCount - unit->pathFirst)
+			return false;
+	}
+
+	if (!IsHandleBlock(data, *header, SnapshotBlockOpponent)
+		|| !IsHandleBlock(data, *header, SnapshotBlockMeleeTarget)
+		|| !IsHandleBlock(data, *header, SnapshotBlockHandle))
+		return false;
+
+	simulationState->tick = header->tick;
+	simulationState->time = header->time;
+	simulationState->timeStep = header->timeStep;
+	simulationState->seed = header->seed;
+	simulationState->lastUnitId = header->lastUnitId;
+	simulationState->winner = (Player)header->winner;
+
+	FighterStore& store = simulationState->fighterStore;
+	store.size = header->fighterCount;
+	store.state.Resize(store.size);
+	store.nextState.Resize(store.size);
+	store.casualty.resize(store.size);
+	store.fighters.assign(store.size, nullptr);
+	store.handle.resize(store.size);
+	store.slotByHandle.assign(store.size, -1);
+
+	std::map<int, Unit*> previousUnits;
+	previousUnits.swap(simulationState->units);
+
+	const glm::vec2* path = GetBlock<glm::vec2>(data, *header, SnapshotBlockPath);
+
+	for (const SnapshotUnit* snapshotUnit = units, * end = units + header->unitCount; snapshotUnit != end; ++snapshotUnit)
+	{
+		Unit* unit;
+		std::map<int, Unit*>::iterator i = previousUnits.find(snapshotUnit->unitId);
+		if (i != previousUnits.end())
+		{
+			unit = (*i).second;
+			previousUnits.erase(i);
+			delete[] unit->fighters;
+		}
+		else
+		{
+			unit = new Unit();
+		}
+
+		unit->unitId = snapshotUnit->unitId;
+		unit->player = (Player)snapshotUnit->player;
+		unit->stats = snapshotUnit->stats;
+		unit->fighters = new Fighter[snapshotUnit->fighterCapacity];
+		for (int j = 0; j < snapshotUnit->fighterCapacity; ++j)
+		{
+			Fighter* fighter = unit->fighters + j;
+			fighter->unit = unit;
+			fighter->store = &store;
+			fighter->slot = snapshotUnit->firstSlot + j;
+			store.fighters[fighter->slot] = fighter;
+		}
+
+		unit->fightersCount = snapshotUnit->fightersCount;
+		unit->shootingCounter = snapshotUnit->shootingCounter;
+		unit->timeUntilSwapFighters = snapshotUnit->timeUntilSwapFighters;
+		unit->aggregate = snapshotUnit->aggregate != 0;
+		unit->asleep = snapshotUnit->asleep != 0;
+		unit->sleepDestination = snapshotUnit->sleepDestination;
+		unit->sleepDirection = snapshotUnit->sleepDirection;
+		unit->state = snapshotUnit->state;
+		unit->formation = snapshotUnit->formation;
+
+		unit->movement.path.assign(path + snapshotUnit->pathFirst, path + snapshotUnit->pathFirst + snapshotUnit->pathCount);
+		unit->movement.path_t0 = snapshotUnit->path_t0;
+		unit->movement.destination = snapshotUnit->destination;
+		unit->movement.direction = snapshotUnit->direction;
+		unit->movement.running = snapshotUnit->running != 0;
+		unit->movement.pathRequestTick = snapshotUnit->pathRequestTick;
+		unit->movement.pathRequestStart = snapshotUnit->pathRequestStart;
+		unit->movement.pathRequestDestination = snapshotUnit->pathRequestDestination;
+		unit->movement.pathRequestTargetId = snapshotUnit->pathRequestTargetId;
+		unit->missileTargetLocked = snapshotUnit->missileTargetLocked != 0;
+
+		simulationState->units[unit->unitId] = unit;
+	}
+
+	for (const SnapshotUnit* snapshotUnit = units, * end = units + header->unitCount; snapshotUnit != end; ++snapshotUnit)
+	{
+		Unit* unit = simulationState->GetUnit(snapshotUnit->unitId);
+		unit->movement.target = simulationState->GetUnit(snapshotUnit->targetUnitId);
+		unit->missileTarget = simulationState->GetUnit(snapshotUnit->missileTargetUnitId);
+	}
+
+	for (std::map<int, Unit*>::iterator i = previousUnits.begin(); i != previousUnits.end(); ++i)
+		DeleteUnit((*i).second);
+
+	const SnapshotProjectile* projectiles = GetBlock<SnapshotProjectile>(data, *header, SnapshotBlockProjectiles);
+	simulationState->projectiles.clear();
+	for (const SnapshotProjectile* projectile = projectiles, * end = projectiles + header->projectileCount; projectile != end; ++projectile)
+		simulationState->projectiles.schedule(projectile->impactTick, projectile->projectile);
+
+	FighterStateArrays& state = store.state;
+	ReadBlock(data, *header, SnapshotBlockPosition, state.position);
+	ReadBlock(data, *header, SnapshotBlockReadyState, state.readyState);
+	ReadBlock(data, *header, SnapshotBlockReadyingTimer, state.readyingTimer);
+	ReadBlock(data, *header, SnapshotBlockStrikingTimer, state.strikingTimer);
+	ReadBlock(data, *header, SnapshotBlockStunnedTimer, state.stunnedTimer);
+	ReadBlock(data, *header, SnapshotBlockOpponent, state.opponent);
+	ReadBlock(data, *header, SnapshotBlockDestination, state.destination);
+	ReadBlock(data, *header, SnapshotBlockVelocity, state.velocity);
+	ReadBlock(data, *header, SnapshotBlockDirection, state.direction);
+	ReadBlock(data, *header, SnapshotBlockMeleeTarget, state.meleeTarget);
+	ReadBlock(data, *header, SnapshotBlockHandle, store.handle);
+	ReadBlock(data, *header, SnapshotBlockCasualty, store.casualty);
+
+	// not part of the snapshot, a restored state is rendered where it is
+	state.previousPosition = state.position;
+
+	for (std::pair<int, Unit*> item : simulationState->units)
+	{
+		Unit* unit = item.second;
+		for (Fighter* fighter = unit->fighters, * end = fighter + unit->fightersCount; fighter != end; ++fighter)
+			if (store.handle[fighter->slot] != NoFighterHandle)
+				store.slotByHandle[store.handle[fighter->slot]] = fighter->slot;
+	}
+
+	return true;
+}
+
+
+const SnapshotHeader* SimulationSnapshot::GetHeader(const unsigned char* data, size_t size)
+{
+	if (data == nullptr || size < sizeof(SnapshotHeader))
+		return nullptr;
+
+	const SnapshotHeader* header = reinterpret_cast<const SnapshotHeader*>(data);
+	if (header->magic != SimulationSnapshotMagic
+		|| header->version != SimulationSnapshotVersion
+		|| header->unitSize != sizeof(SnapshotUnit)
+		|| header->size > size)
+		return nullptr;
+
+	if (header->unitCount < 0 || header->fighterCount < 0 || header->pathCount < 0 || header->projectileCount < 0)
+		return nullptr;
+
+	for (int block = 0; block < SnapshotBlockCount; ++block)
+	{
+		size_t offset = header->offsets[block];
+		if (offset < sizeof(SnapshotHeader) || offset > header->size || GetBlockSize(*header, (SnapshotBlock)block) > header->size - offset)
+			return nullptr;
+	}
+
+	return header;
+}
+
+
+size_t SimulationSnapshot::GetBlockSpan(const SnapshotHeader& header, SnapshotBlock block)
+{
+	size_t end = block + 1 < SnapshotBlockCount ? header.offsets[block + 1] : header.size;
+	return end - header.offsets[block];
+}
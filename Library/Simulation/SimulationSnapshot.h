@@ -0,0 +1,127 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#ifndef SIMULATIONSNAPSHOT_H
+#define SIMULATIONSNAPSHOT_H
+
+#include "SimulationState.h"
+
+
+const unsigned int SimulationSnapshotMagic = 0x5353574F; // "OWSS"
+const unsigned int SimulationSnapshotVersion = 8;
+
+
+// Fighter blocks come first, their offsets only change with the number of
+// fighter slots, the blocks whose sizes change from tick to tick come last.
+
+enum SnapshotBlock
+{
+	SnapshotBlockPosition,
+	SnapshotBlockReadyState,
+	SnapshotBlockReadyingTimer,
+	SnapshotBlockStrikingTimer,
+	SnapshotBlockStunnedTimer,
+	SnapshotBlockOpponent,
+	SnapshotBlockDestination,
+	SnapshotBlockVelocity,
+	SnapshotBlockDirection,
+	SnapshotBlockMeleeTarget,
+	SnapshotBlockHandle,
+	SnapshotBlockCasualty,
+	SnapshotBlockUnits,
+	SnapshotBlockPath,
+	SnapshotBlockProjectiles,
+	SnapshotBlockCount
+};
+
+
+// The snapshot starts with this header, followed by the blocks at the given
+// offsets. Fighter blocks hold one element per fighter store slot. Fighters
+// are referred to by handle and units by id, -1 and 0 for none.
+
+struct SnapshotHeader
+{
+	unsigned int magic;
+	unsigned int version;
+	unsigned int size; // bytes, including the header
+	unsigned int unitSize; // sizeof(SnapshotUnit), so builds with another layout are rejected
+
+	int tick;
+	float time;
+	float timeStep;
+	unsigned int seed;
+	int lastUnitId;
+	int winner;
+
+	int unitCount;
+	int fighterCount; // fighter store slots
+	int pathCount;
+	int projectileCount;
+
+	unsigned int offsets[SnapshotBlockCount];
+};
+
+
+struct SnapshotUnit
+{
+	int unitId;
+	int player;
+	int firstSlot;
+	int fighterCapacity; // slots up to the next unit, including removed fighters
+	int fightersCount;
+	int shootingCounter;
+	float timeUntilSwapFighters;
+	int aggregate;
+	int asleep;
+	glm::vec2 sleepDestination;
+	float sleepDirection;
+	UnitStats stats;
+	UnitState state;
+	Formation formation;
+
+	int pathFirst;
+	int pathCount;
+	float path_t0;
+	glm::vec2 destination;
+	float direction;
+	int targetUnitId;
+	int running;
+	int pathRequestTick;
+	glm::vec2 pathRequestStart;
+	glm::vec2 pathRequestDestination;
+	int pathRequestTargetId;
+	int missileTargetUnitId;
+	int missileTargetLocked;
+};
+
+
+struct SnapshotProjectile
+{
+	Projectile projectile;
+	int impactTick;
+};
+
+
+// Saves and restores the dynamic part of a SimulationState as a flat block of
+// memory, which can be written to a file and mapped back in without parsing.
+// The map, terrain model and terrain grid are static and not part of the
+// snapshot; restore into a state that already has them. Intermediate attributes are recomputed
+// by the next time step and are not saved either.
+//
+// Restore() keeps the Unit objects of units that are in both the state and the
+// snapshot, so pointers to units stay valid, but all Fighter objects are
+// replaced. Call SimulationRules::ResetSpatialIndex() after restoring.
+
+class SimulationSnapshot
+{
+public:
+	static void Write(const SimulationState* simulationState, std::vector<unsigned char>& buffer);
+	static bool Restore(const unsigned char* data, size_t size, SimulationState* simulationState);
+
+	static const SnapshotHeader* GetHeader(const unsigned char* data, size_t size);
+	static size_t GetBlockSpan(const SnapshotHeader& header, SnapshotBlock block); // bytes up to the next block
+};
+
+
+#endif
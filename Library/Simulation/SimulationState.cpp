@@ -12,7 +12,11 @@ path_t0(0),
 destination(),
 direction(0),
 target(0),
-running(false)
+running(false),
+pathRequestTick(-1),
+pathRequestStart(),
+pathRequestDestination(),
+pathRequestTargetId(0)
 {
 }
 
@@ -39,8 +43,9 @@ destination(),
 position(),
 velocity(),
 direction(0),
-opponent(0),
-meleeTarget(0),
+opponent(NoFighterHandle),
+meleeTarget(NoFighterHandle),
+previousPosition(),
 readyingTimer(0),
 strikingTimer(0),
 stunnedTimer(0)
@@ -48,14 +53,133 @@ stunnedTimer(0)
 }
 
 
+void FighterStateArrays::Resize(int size)
+{
+	position.resize(size);
+	readyState.resize(size, ReadyStateUnready);
+	readyingTimer.resize(size);
+	strikingTimer.resize(size);
+	stunnedTimer.resize(size);
+	opponent.resize(size, NoFighterHandle);
+	destination.resize(size);
+	velocity.resize(size);
+	direction.resize(size);
+	meleeTarget.resize(size, NoFighterHandle);
+	previousPosition.resize(size);
+}
+
+
+FighterState FighterStateArrays::Get(int slot) const
+{
+	FighterState result;
+	result.position = position[slot];
+	result.readyState = readyState[slot];
+	result.readyingTimer = readyingTimer[slot];
+	result.strikingTimer = strikingTimer[slot];
+	result.stunnedTimer = stunnedTimer[slot];
+	result.opponent = opponent[slot];
+	result.destination = destination[slot];
+	result.velocity = velocity[slot];
+	result.direction = direction[slot];
+	result.meleeTarget = meleeTarget[slot];
+	result.previousPosition = previousPosition[slot];
+	return result;
+}
+
+
+void FighterStateArrays::Set(int slot, const FighterState& value)
+{
+	position[slot] = value.position;
+	readyState[slot] = value.readyState;
+	readyingTimer[slot] = value.readyingTimer;
+	strikingTimer[slot] = value.strikingTimer;
+	stunnedTimer[slot] = value.stunnedTimer;
+	opponent[slot] = value.opponent;
+	destination[slot] = value.destination;
+	velocity[slot] = value.velocity;
+	direction[slot] = value.direction;
+	meleeTarget[slot] = value.meleeTarget;
+	previousPosition[slot] = value.previousPosition;
+}
+
+
+void FighterStateArrays::Copy(int dst, int src)
+{
+	position[dst] = position[src];
+	readyState[dst] = readyState[src];
+	readyingTimer[dst] = readyingTimer[src];
+	strikingTimer[dst] = strikingTimer[src];
+	stunnedTimer[dst] = stunnedTimer[src];
+	opponent[dst] = opponent[src];
+	destination[dst] = destination[src];
+	velocity[dst] = velocity[src];
+	direction[dst] = direction[src];
+	meleeTarget[dst] = meleeTarget[src];
+	previousPosition[dst] = previousPosition[src];
+}
+
+
+void FighterStateArrays::Assign(const FighterStateArrays& other, int slot, int count)
+{
+	std::copy(other.position.begin() + slot, other.position.begin() + slot + count, position.begin() + slot);
+	std::copy(other.readyState.begin() + slot, other.readyState.begin() + slot + count, readyState.begin() + slot);
+	std::copy(other.readyingTimer.begin() + slot, other.readyingTimer.begin() + slot + count, readyingTimer.begin() + slot);
+	std::copy(other.strikingTimer.begin() + slot, other.strikingTimer.begin() + slot + count, strikingTimer.begin() + slot);
+	std::copy(other.stunnedTimer.begin() + slot, other.stunnedTimer.begin() + slot + count, stunnedTimer.begin() + slot);
+	std::copy(other.opponent.begin() + slot, other.opponent.begin() + slot + count, opponent.begin() + slot);
+	std::copy(other.destination.begin() + slot, other.destination.begin() + slot + count, destination.begin() + slot);
+	std::copy(other.velocity.begin() + slot, other.velocity.begin() + slot + count, velocity.begin() + slot);
+	std::copy(other.direction.begin() + slot, other.direction.begin() + slot + count, direction.begin() + slot);
+	std::copy(other.meleeTarget.begin() + slot, other.meleeTarget.begin() + slot + count, meleeTarget.begin() + slot);
+	std::copy(other.previousPosition.begin() + slot, other.previousPosition.begin() + slot + count, previousPosition.begin() + slot);
+}
+
+
+FighterStore::FighterStore() :
+size(0)
+{
+}
+
+
+int FighterStore::Allocate(int count)
+{
+	int result = size;
+	size += count;
+
+	state.Resize(size);
+	nextState.Resize(size);
+	casualty.resize(size);
+	fighters.resize(size);
+
+	for (int slot = result; slot < size; ++slot)
+	{
+		handle.push_back(slot);
+		slotByHandle.push_back(slot);
+	}
+
+	return result;
+}
+
+
+void FighterStore::Move(int dst, int src)
+{
+	state.Copy(dst, src);
+	SetHandle(dst, handle[src]);
+}
+
+
+void FighterStore::Remove(int slot)
+{
+	if (handle[slot] != NoFighterHandle)
+		slotByHandle[handle[slot]] = -1;
+	handle[slot] = NoFighterHandle;
+}
+
+
 Fighter::Fighter() :
 unit(0),
-state(),
-nextState(),
-casualty(false),
-terrainForest(false),
-terrainWater(false),
-terrainPosition()
+store(0),
+slot(0)
 {
 }
 
@@ -64,8 +188,9 @@ FighterUpdate Fighter::GetFighterUpdate(const UnitUpdate& unitUpdate)
 {
 	FighterUpdate result;
 
-	result.positionX = (unsigned char)(255.0f * (state.position.x - unitUpdate.minX) / (unitUpdate.maxX - unitUpdate.minX));
-	result.positionY = (unsigned char)(255.0f * (state.position.y - unitUpdate.minY) / (unitUpdate.maxY - unitUpdate.minY));
+	glm::vec2 position = GetPosition();
+	result.positionX = (unsigned char)(255.0f * (position.x - unitUpdate.minX) / (unitUpdate.maxX - unitUpdate.minX));
+	result.positionY = (unsigned char)(255.0f * (position.y - unitUpdate.minY) / (unitUpdate.maxY - unitUpdate.minY));
 
 	return result;
 }
@@ -76,10 +201,7 @@ void Fighter::SetFighterUpdate(const UnitUpdate& unitUpdate, const FighterUpdate
 	float positionX = unitUpdate.minX + (unitUpdate.maxX - unitUpdate.minX) * (float)fighterUpdate.positionX / 255.0f;
 	float positionY = unitUpdate.minY + (unitUpdate.maxY - unitUpdate.minY) * (float)fighterUpdate.positionY / 255.0f;
 
-	if (positionX == 0)
-		state.position = glm::vec2(positionX, positionY);
-	else
-		state.position = glm::vec2(positionX, positionY);
+	store->state.position[slot] = glm::vec2(positionX, positionY);
 }
 
 
@@ -121,7 +243,7 @@ UnitUpdate Unit::GetUnitUpdate()
 
 	for (int i = 0; i < fightersCount; ++i)
 	{
-		glm::vec2 p = fighters[i].state.position;
+		glm::vec2 p = fighters[i].GetPosition();
 		result.minX = fminf(result.minX, p.x);
 		result.maxX = fmaxf(result.maxX, p.x);
 		result.minY = fminf(result.minY, p.y);
@@ -173,6 +295,9 @@ movement(),
 fighters(0),
 fightersCount(0),
 timeUntilSwapFighters(0),
+aggregate(false),
+asleep(false),
+sleepDirection(0),
 missileTarget(0),
 missileTargetLocked(false),
 shootingCounter(0)
@@ -190,7 +315,7 @@ glm::vec2 Unit::CalculateUnitCenter()
 
 	for (Fighter* fighter = fighters, * end = fighter + fightersCount; fighter != end; ++fighter)
 	{
-		p += fighter->state.position;
+		p += fighter->GetPosition();
 		++count;
 	}
 
@@ -238,6 +363,8 @@ lastUnitId(0),
 winner(PlayerNone),
 time(0),
 timeStep(1.0f / 15.0f),
+tick(0),
+seed(0),
 terrainModel(nullptr),
 map(nullptr)
 {
@@ -258,38 +385,69 @@ SimulationState::~SimulationState()
 }
 
 
-bool SimulationState::IsMelee() const
+template <class T> static void HashValue(unsigned long long& hash, const T& value)
+{
+	// FNV-1a
+	const unsigned char* p = reinterpret_cast<const unsigned char*>(&value);
+	for (size_t i = 0; i < sizeof(T); ++i)
+	{
+		hash ^= p[i];
+		hash *= 0x100000001B3ULL;
+	}
+}
+
+
+unsigned long long SimulationState::CalculateHash() const
 {
+	const FighterStateArrays& state = fighterStore.state;
+
+	unsigned long long result = 0xCBF29CE484222325ULL;
+	HashValue(result, tick);
+	HashValue(result, (int)winner);
+
 	for (std::map<int, Unit*>::const_iterator i = units.begin(); i != units.end(); ++i)
 	{
 		const Unit* unit = (*i).second;
+		HashValue(result, unit->unitId);
+		HashValue(result, unit->fightersCount);
+		HashValue(result, (int)unit->state.unitMode);
+		HashValue(result, unit->state.center);
+		HashValue(result, unit->state.direction);
+		HashValue(result, unit->state.morale);
+		HashValue(result, unit->state.shootingTimer);
+		HashValue(result, unit->state.shootingCounter);
+
 		for (Fighter* fighter = unit->fighters, * end = fighter + unit->fightersCount; fighter != end; ++fighter)
 		{
-			if (fighter->state.opponent)
-			{
-				return true;
-			}
+			int slot = fighter->slot;
+			Fighter* opponent = fighterStore.GetFighter(state.opponent[slot]);
+			HashValue(result, state.position[slot]);
+			HashValue(result, (int)state.readyState[slot]);
+			HashValue(result, state.readyingTimer[slot]);
+			HashValue(result, state.strikingTimer[slot]);
+			HashValue(result, state.stunnedTimer[slot]);
+			HashValue(result, opponent != 0 ? opponent->slot : -1);
 		}
 	}
-	return false;
-}
-
 
-bool SimulationState::IsForest(glm::vec2 position) const
-{
-	int x = (int)(512 * position.x / 1024);
-	int y = (int)(512 * position.y / 1024);
-	glm::vec4 c = map->get_pixel(x, y);
-	return c.g >= 0.5;
+	return result;
 }
 
 
-bool SimulationState::IsImpassable(glm::vec2 position) const
+bool SimulationState::IsMelee() const
 {
-	int x = (int)(512 * position.x / 1024);
-	int y = (int)(512 * position.y / 1024);
-	glm::vec4 c = map->get_pixel(x, y);
-	return c.b >= 0.5 && c.r < 0.5;
+	for (std::map<int, Unit*>::const_iterator i = units.begin(); i != units.end(); ++i)
+	{
+		const Unit* unit = (*i).second;
+		for (Fighter* fighter = unit->fighters, * end = fighter + unit->fightersCount; fighter != end; ++fighter)
+		{
+			if (fighter->GetOpponent())
+			{
+				return true;
+			}
+		}
+	}
+	return false;
 }
 
 
@@ -304,8 +462,14 @@ Unit* SimulationState::AddUnit(Player player, int numberOfFighters, UnitStats st
 	unit->fightersCount = numberOfFighters;
 	unit->fighters = new Fighter[numberOfFighters];
 
+	int slot = fighterStore.Allocate(numberOfFighters);
 	for (Fighter* i = unit->fighters, * end = i + numberOfFighters; i != end; ++i)
+	{
 		i->unit = unit;
+		i->store = &fighterStore;
+		i->slot = slot++;
+		fighterStore.fighters[i->slot] = i;
+	}
 
 	unit->movement.direction = player == Player1 ? (float)M_PI_2 : (float)M_PI_2 * 3;
 	unit->movement.destination = position;
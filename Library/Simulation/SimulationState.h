@@ -8,6 +8,10 @@
 #include "MovementRules.h"
 #include "SmoothTerrainModel.h"
 #include "image.h"
+#include "counterrng.h"
+#include "timingwheel.h"
+#include "TerrainGrid.h"
+#include "PathPlanner.h"
 
 
 struct Fighter;
@@ -57,6 +61,13 @@ enum UnitPlatform
 };
 
 
+// fighters keep this much of their speed in forest, see also PathPlanner
+inline double GetForestSpeedFactor(UnitPlatform unitPlatform)
+{
+	return unitPlatform == UnitPlatformCav || unitPlatform == UnitPlatformGen ? 0.5 : 0.9;
+}
+
+
 enum UnitWeapon
 {
 	UnitWeaponYari = 0,
@@ -84,6 +95,10 @@ struct Movement
 	float direction;
 	Unit* target;
 	bool running;
+	int pathRequestTick; // when a planned path toward target was requested, -1 if none, see SimulationRules::pathDelay
+	glm::vec2 pathRequestStart; // the point the planned path goes on from
+	glm::vec2 pathRequestDestination;
+	int pathRequestTargetId;
 
 	Movement();
 
@@ -140,6 +155,11 @@ enum ReadyState
 };
 
 
+// Refers to a fighter whatever slot its state is moved to, see FighterStore.
+typedef int FighterHandle;
+const FighterHandle NoFighterHandle = -1;
+
+
 struct FighterState
 {
 	// dynamic attributes
@@ -148,13 +168,16 @@ struct FighterState
 	float readyingTimer;
 	float strikingTimer;
 	float stunnedTimer;
-	Fighter* opponent;
+	FighterHandle opponent;
 
 	// intermediate attributes
 	glm::vec2 destination;
 	glm::vec2 velocity;
 	float direction;
-	Fighter* meleeTarget;
+	FighterHandle meleeTarget;
+
+	// render attributes
+	glm::vec2 previousPosition; // position before the last time step
 
 
 	FighterState();
@@ -168,30 +191,116 @@ struct FighterUpdate
 };
 
 
+struct FighterStateArrays
+{
+	// dynamic attributes
+	std::vector<glm::vec2> position;
+	std::vector<ReadyState> readyState;
+	std::vector<float> readyingTimer;
+	std::vector<float> strikingTimer;
+	std::vector<float> stunnedTimer;
+	std::vector<FighterHandle> opponent;
+
+	// intermediate attributes
+	std::vector<glm::vec2> destination;
+	std::vector<glm::vec2> velocity;
+	std::vector<float> direction;
+	std::vector<FighterHandle> meleeTarget;
+
+	// render attributes
+	std::vector<glm::vec2> previousPosition;
+
+	void Resize(int size);
+
+	FighterState Get(int slot) const;
+	void Set(int slot, const FighterState& value);
+	void Copy(int dst, int src);
+	void Assign(const FighterStateArrays& other, int slot, int count);
+};
+
+
+struct FighterStore
+{
+	int size;
+
+	// dynamic attributes
+	FighterStateArrays state;
+
+	// intermediate attributes
+	FighterStateArrays nextState;
+	std::vector<unsigned char> casualty;
+
+	// identity attributes, a fighter keeps its handle when its state moves to another slot,
+	// handles are never reused, so a removed fighter's handle resolves to none from then on
+	std::vector<Fighter*> fighters; // by slot
+	std::vector<FighterHandle> handle; // by slot, none past a unit's fighters count
+	std::vector<int> slotByHandle; // -1 once the fighter is removed
+
+	FighterStore();
+
+	int Allocate(int count);
+
+	int GetSlot(FighterHandle value) const { return value != NoFighterHandle ? slotByHandle[value] : -1; }
+	Fighter* GetFighter(FighterHandle value) const
+	{
+		int slot = GetSlot(value);
+		return slot != -1 ? fighters[slot] : nullptr;
+	}
+	FighterHandle GetHandle(const Fighter* fighter) const;
+
+	void SetHandle(int slot, FighterHandle value)
+	{
+		handle[slot] = value;
+		slotByHandle[value] = slot;
+	}
+
+	void Move(int dst, int src); // the state and handle of the fighter in src
+	void Remove(int slot); // the fighter's handle no longer resolves
+};
+
+
 struct Fighter
 {
 	// static attributes
 	Unit* unit;
+	FighterStore* store;
+	int slot;
 
-	// dynamic attributes
-	FighterState state;
+	Fighter();
 
-	// optimization attributes
-	bool terrainForest;
-	bool terrainWater;
-	glm::vec2 terrainPosition;
+	FighterState GetState() const { return store->state.Get(slot); }
+	void SetState(const FighterState& value) { store->state.Set(slot, value); }
 
-	// intermediate attributes
-	FighterState nextState;
-	bool casualty;
+	glm::vec2 GetPosition() const { return store->state.position[slot]; }
+	glm::vec2 GetPreviousPosition() const { return store->state.previousPosition[slot]; }
+	glm::vec2 GetDestination() const { return store->state.destination[slot]; }
+	glm::vec2 GetVelocity() const { return store->state.velocity[slot]; }
+	float GetDirection() const { return store->state.direction[slot]; }
+	ReadyState GetReadyState() const { return store->state.readyState[slot]; }
+	Fighter* GetOpponent() const { return store->GetFighter(store->state.opponent[slot]); }
+	Fighter* GetMeleeTarget() const { return store->GetFighter(store->state.meleeTarget[slot]); }
 
+	// between the previous and the current position, t = 0 to 1
+	glm::vec2 GetInterpolatedPosition(float t) const
+	{
+		glm::vec2 p1 = GetPreviousPosition();
+		return p1 + t * (GetPosition() - p1);
+	}
+
+	bool IsCasualty() const { return store->casualty[slot] != 0; }
+	void SetCasualty(bool value) { store->casualty[slot] = value ? 1 : 0; }
 
-	Fighter();
 	FighterUpdate GetFighterUpdate(const UnitUpdate& unitUpdate);
 	void SetFighterUpdate(const UnitUpdate& unitUpdate, const FighterUpdate& fighterUpdate);
 };
 
 
+inline FighterHandle FighterStore::GetHandle(const Fighter* fighter) const
+{
+	return fighter != nullptr ? handle[fighter->slot] : NoFighterHandle;
+}
+
+
 struct UnitStats
 {
 	UnitPlatform unitPlatform;
@@ -277,10 +386,15 @@ struct Unit
 	int shootingCounter; // updated by ResolveMissileCombat()
 	Formation formation; // updated by UpdateFormation()
 	float timeUntilSwapFighters;
+	bool aggregate; // moves in formation without fighter lookups, updated by ComputeNextState()
+	bool asleep; // fighters keep their state without being simulated, updated by ComputeNextState()
+	glm::vec2 sleepDestination; // movement destination and formation direction when the unit fell asleep,
+	float sleepDirection; // a new order wakes it up
 
 
 	// intermediate attributes
 	UnitState nextState; // updated by ComputeNextState()
+	std::vector<FighterOrder> fighterOrder; // by place, reused by SwapFighters() so that swapping does not allocate
 
 	// control attributes
 	Movement movement; // updated by TouchGesture()
@@ -302,18 +416,33 @@ struct Unit
 };
 
 
+enum SimulationRoll
+{
+	SimulationRollMeleeKill,
+	SimulationRollShootingTimer,
+	SimulationRollProjectileDelay,
+	SimulationRollMissileTargetX,
+	SimulationRollMissileTargetY
+};
+
+
 struct SimulationState
 {
 	int lastUnitId;
 	Player winner;
 	float time;
 	float timeStep;
+	int tick; // number of time steps simulated
+	unsigned int seed; // battle seed, keys every random roll
 
 	std::map<int, Unit*> units;
-	std::vector<Shooting> shootings;
+	timingwheel<Projectile> projectiles; // in flight, by the tick they hit
+	FighterStore fighterStore;
 
 	SmoothTerrainModel* terrainModel;
 	image* map;
+	TerrainGrid terrainGrid; // classes of the map pixels, see UpdateTerrainGrid()
+	PathPlanner pathPlanner; // paths around impassable terrain, see MovementRules::UpdateMovementPath()
 
 	SimulationState();
 	~SimulationState();
@@ -326,8 +455,21 @@ struct SimulationState
 
 	bool IsMelee() const;
 
-	bool IsForest(glm::vec2 position) const;
-	bool IsImpassable(glm::vec2 position) const;
+	// hash of the dynamic state, for checking that two runs stay identical
+	unsigned long long CalculateHash() const;
+
+	// same value for the same seed, tick, roll, unit and fighter index, whatever order rolls are made in
+	unsigned int Roll(SimulationRoll roll, int unitId, int fighterIndex) const
+	{
+		return counterrng(seed)((unsigned int)tick, (unsigned int)roll, (unsigned int)unitId, (unsigned int)fighterIndex);
+	}
+
+	// call after setting map, and with the bounds returned by the terrain model's edits
+	void UpdateTerrainGrid() { terrainGrid.Build(map); }
+	void UpdateTerrainGrid(bounds2f bounds) { terrainGrid.Update(map, bounds); }
+
+	bool IsForest(glm::vec2 position) const { return terrainGrid.IsForest(position); }
+	bool IsImpassable(glm::vec2 position) const { return terrainGrid.IsImpassable(position); }
 
 	Unit* AddUnit(Player player, int numberOfFighters, UnitStats stats, glm::vec2 position);
 
@@ -0,0 +1,688 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#include "SimulationSync.h"
+#include "SimulationRecorder.h"
+
+
+static const int TickBits = 32;
+static const int UnitCountBits = 16;
+static const int UnitIdBits = 16;
+static const int PlayerBits = 2;
+static const int PlatformBits = 2;
+static const int WeaponBits = 3;
+static const int FightersCountBits = 10;
+static const int UnitModeBits = 2;
+static const int MoraleBits = 8;
+static const int DirectionBits = 8;
+static const int PositionBits = 16;
+static const int FighterPositionBits = 8;
+static const int FighterDeltaBits = 4;
+static const int ReadyStateBits = 3;
+
+static const unsigned int NoBaseline = 0xFFFFFFFF;
+
+
+static int QuantizePosition(float value, bool roundUp)
+{
+	// steps of 1/16 meter over [-1024, 3072)
+	float x = (value + 1024) * 16;
+	int result = (int)(roundUp ? ceilf(x) : floorf(x));
+	return std::max(0, std::min(result, (int)bitwriter::mask(PositionBits)));
+}
+
+
+static float DequantizePosition(int value)
+{
+	return value / 16.0f - 1024;
+}
+
+
+static int QuantizeMorale(float value)
+{
+	float x = fmaxf(-1, fminf(value, 1));
+	return (int)roundf((x + 1) * 127.5f);
+}
+
+
+static float DequantizeMorale(int value)
+{
+	return value / 127.5f - 1;
+}
+
+
+static int QuantizeDirection(float value)
+{
+	return (int)roundf(value * 128 / (float)M_PI) & bitwriter::mask(DirectionBits);
+}
+
+
+static float DequantizeDirection(int value)
+{
+	return value * (float)M_PI / 128;
+}
+
+
+static int GetMaxDelta()
+{
+	return (1 << (FighterDeltaBits - 1)) - 1;
+}
+
+
+static void WriteUnitState(bitwriter& writer, const SyncUnit& unit)
+{
+	writer.write(unit.fightersCount, FightersCountBits);
+	writer.write(unit.unitMode, UnitModeBits);
+	writer.write(unit.morale, MoraleBits);
+	writer.write(unit.direction, DirectionBits);
+}
+
+
+static void ReadUnitState(bitreader& reader, SyncUnit& unit)
+{
+	unit.fightersCount = reader.read(FightersCountBits);
+	unit.unitMode = reader.read(UnitModeBits);
+	unit.morale = reader.read(MoraleBits);
+	unit.direction = reader.read(DirectionBits);
+}
+
+
+static void WriteUnitBounds(bitwriter& writer, const SyncUnit& unit)
+{
+	writer.write(unit.minX, PositionBits);
+	writer.write(unit.minY, PositionBits);
+	writer.write(unit.maxX, PositionBits);
+	writer.write(unit.maxY, PositionBits);
+}
+
+
+static void ReadUnitBounds(bitreader& reader, SyncUnit& unit)
+{
+	unit.minX = reader.read(PositionBits);
+	unit.minY = reader.read(PositionBits);
+	unit.maxX = reader.read(PositionBits);
+	unit.maxY = reader.read(PositionBits);
+}
+
+
+static void WriteUnitMovement(bitwriter& writer, const SyncUnit& unit)
+{
+	writer.write(unit.destinationX, PositionBits);
+	writer.write(unit.destinationY, PositionBits);
+	writer.write(unit.movementDirection, DirectionBits);
+	writer.write(unit.movementTargetUnitId, UnitIdBits);
+	writer.write(unit.movementRunning, 1);
+}
+
+
+static void ReadUnitMovement(bitreader& reader, SyncUnit& unit)
+{
+	unit.destinationX = reader.read(PositionBits);
+	unit.destinationY = reader.read(PositionBits);
+	unit.movementDirection = reader.read(DirectionBits);
+	unit.movementTargetUnitId = reader.read(UnitIdBits);
+	unit.movementRunning = reader.read(1);
+}
+
+
+static void WriteFighter(bitwriter& writer, const SyncFighter& fighter)
+{
+	writer.write(fighter.update.positionX, FighterPositionBits);
+	writer.write(fighter.update.positionY, FighterPositionBits);
+	writer.write(fighter.readyState, ReadyStateBits);
+}
+
+
+static void ReadFighter(bitreader& reader, SyncFighter& fighter)
+{
+	fighter.update.positionX = (unsigned char)reader.read(FighterPositionBits);
+	fighter.update.positionY = (unsigned char)reader.read(FighterPositionBits);
+	fighter.readyState = reader.read(ReadyStateBits);
+}
+
+
+static void WriteFighterDelta(bitwriter& writer, const SyncFighter& fighter, const SyncFighter& previous)
+{
+	// 1 bit if unmoved, 10 bits for small steps, 18 bits otherwise
+	int dx = fighter.update.positionX - previous.update.positionX;
+	int dy = fighter.update.positionY - previous.update.positionY;
+	int maxDelta = GetMaxDelta();
+	if (dx == 0 && dy == 0)
+	{
+		writer.write(0, 1);
+	}
+	else if (-maxDelta - 1 <= dx && dx <= maxDelta && -maxDelta - 1 <= dy && dy <= maxDelta)
+	{
+		writer.write(1, 1);
+		writer.write(0, 1);
+		writer.write_signed(dx, FighterDeltaBits);
+		writer.write_signed(dy, FighterDeltaBits);
+	}
+	else
+	{
+		writer.write(1, 1);
+		writer.write(1, 1);
+		writer.write(fighter.update.positionX, FighterPositionBits);
+		writer.write(fighter.update.positionY, FighterPositionBits);
+	}
+
+	if (fighter.readyState == previous.readyState)
+	{
+		writer.write(0, 1);
+	}
+	else
+	{
+		writer.write(1, 1);
+		writer.write(fighter.readyState, ReadyStateBits);
+	}
+}
+
+
+static void ReadFighterDelta(bitreader& reader, SyncFighter& fighter, const SyncFighter& previous)
+{
+	fighter = previous;
+	if (reader.read(1) != 0)
+	{
+		if (reader.read(1) == 0)
+		{
+			fighter.update.positionX = (unsigned char)(previous.update.positionX + reader.read_signed(FighterDeltaBits));
+			fighter.update.positionY = (unsigned char)(previous.update.positionY + reader.read_signed(FighterDeltaBits));
+		}
+		else
+		{
+			fighter.update.positionX = (unsigned char)reader.read(FighterPositionBits);
+			fighter.update.positionY = (unsigned char)reader.read(FighterPositionBits);
+		}
+	}
+
+	if (reader.read(1) != 0)
+		fighter.readyState = reader.read(ReadyStateBits);
+}
+
+
+static bool SameFighters(const SyncFrame& frame, const SyncUnit& unit, const SyncFrame& baseline, const SyncUnit& previous)
+{
+	if (unit.fightersCount != previous.fightersCount)
+		return false;
+
+	for (int i = 0; i < unit.fightersCount; ++i)
+	{
+		const SyncFighter& a = frame.fighters[unit.firstFighter + i];
+		const SyncFighter& b = baseline.fighters[previous.firstFighter + i];
+		if (a.update.positionX != b.update.positionX || a.update.positionY != b.update.positionY || a.readyState != b.readyState)
+			return false;
+	}
+
+	return true;
+}
+
+
+
+bool SyncUnit::SameUnit(const SyncUnit& other) const
+{
+	return fightersCount == other.fightersCount
+		&& unitMode == other.unitMode
+		&& morale == other.morale
+		&& direction == other.direction;
+}
+
+
+bool SyncUnit::SameBounds(const SyncUnit& other) const
+{
+	return minX == other.minX
+		&& minY == other.minY
+		&& maxX == other.maxX
+		&& maxY == other.maxY;
+}
+
+
+bool SyncUnit::SameMovement(const SyncUnit& other) const
+{
+	return destinationX == other.destinationX
+		&& destinationY == other.destinationY
+		&& movementDirection == other.movementDirection
+		&& movementTargetUnitId == other.movementTargetUnitId
+		&& movementRunning == other.movementRunning;
+}
+
+
+UnitUpdate SyncUnit::GetUnitUpdate() const
+{
+	UnitUpdate result;
+
+	result.unitId = unitId;
+	result.fightersCount = fightersCount;
+	result.morale = DequantizeMorale(morale);
+
+	result.minX = DequantizePosition(minX);
+	result.maxX = DequantizePosition(maxX);
+	result.minY = DequantizePosition(minY);
+	result.maxY = DequantizePosition(maxY);
+
+	result.movementDestination = glm::vec2(DequantizePosition(destinationX), DequantizePosition(destinationY));
+	result.movementDirection = DequantizeDirection(movementDirection);
+	result.movementTargetUnitId = movementTargetUnitId;
+	result.movementRunning = movementRunning != 0;
+
+	return result;
+}
+
+
+const SyncUnit* SyncFrame::FindUnit(int unitId) const
+{
+	std::vector<SyncUnit>::const_iterator i = std::lower_bound(units.begin(), units.end(), unitId,
+		[](const SyncUnit& unit, int id) { return unit.unitId < id; });
+
+	return i != units.end() && i->unitId == unitId ? &*i : nullptr;
+}
+
+
+/***/
+
+
+SyncServer::SyncServer(Player player) :
+_player(player),
+_acknowledgedTick(-1),
+sightRange(300),
+maxSentFrames(64)
+{
+}
+
+
+void SyncServer::Acknowledge(int tick)
+{
+	if (tick > _acknowledgedTick && FindSentFrame(tick) != nullptr)
+		_acknowledgedTick = tick;
+}
+
+
+void SyncServer::WritePacket(SimulationState* simulationState, std::vector<unsigned char>& packet)
+{
+	if (!_sentFrames.empty() && simulationState->tick <= _sentFrames.back().tick)
+	{
+		if (simulationState->tick < _sentFrames.back().tick)
+		{
+			// the battle was rewound, start over from a full frame
+			_sentFrames.clear();
+			_acknowledgedTick = -1;
+		}
+		else
+		{
+			_sentFrames.pop_back();
+		}
+	}
+
+	CaptureFrame(simulationState);
+
+	const SyncFrame& frame = _sentFrames.back();
+	const SyncFrame* baseline = FindSentFrame(_acknowledgedTick);
+
+	packet.clear();
+	bitwriter writer(packet);
+	writer.write((unsigned int)frame.tick, TickBits);
+	writer.write(baseline != nullptr ? (unsigned int)baseline->tick : NoBaseline, TickBits);
+	WriteFrame(writer, frame, baseline);
+	writer.flush();
+
+	// acknowledgements only move forward, so frames before the baseline are not needed again
+	while (!_sentFrames.empty() && _sentFrames.front().tick < _acknowledgedTick)
+		_sentFrames.pop_front();
+	while ((int)_sentFrames.size() > maxSentFrames)
+		_sentFrames.pop_front();
+}
+
+
+void SyncServer::CaptureFrame(SimulationState* simulationState)
+{
+	_sentFrames.push_back(SyncFrame());
+	SyncFrame& frame = _sentFrames.back();
+	frame.tick = simulationState->tick;
+
+	std::vector<glm::vec2> sight;
+	for (std::pair<int, Unit*> item : simulationState->units)
+		if (item.second->player == _player)
+			sight.push_back(item.second->state.center);
+
+	for (std::pair<int, Unit*> item : simulationState->units)
+	{
+		Unit* unit = item.second;
+
+		bool visible = _player == PlayerNone || unit->player == _player;
+		for (std::vector<glm::vec2>::iterator i = sight.begin(); !visible && i != sight.end(); ++i)
+			visible = glm::length(unit->state.center - *i) <= sightRange;
+		if (!visible)
+			continue;
+
+		UnitUpdate unitUpdate = unit->GetUnitUpdate();
+		int count = std::min(unit->fightersCount, (int)bitwriter::mask(FightersCountBits));
+		if (count == 0)
+		{
+			unitUpdate.minX = unitUpdate.maxX = unit->state.center.x;
+			unitUpdate.minY = unitUpdate.maxY = unit->state.center.y;
+		}
+
+		SyncUnit syncUnit;
+		syncUnit.unitId = unit->unitId & bitwriter::mask(UnitIdBits);
+		syncUnit.player = unit->player;
+		syncUnit.unitPlatform = unit->stats.unitPlatform;
+		syncUnit.unitWeapon = unit->stats.unitWeapon;
+		syncUnit.fightersCount = count;
+		syncUnit.unitMode = unit->state.unitMode;
+		syncUnit.morale = QuantizeMorale(unit->state.morale);
+		syncUnit.direction = QuantizeDirection(unit->state.direction);
+		syncUnit.minX = QuantizePosition(unitUpdate.minX, false);
+		syncUnit.minY = QuantizePosition(unitUpdate.minY, false);
+		syncUnit.maxX = std::max(QuantizePosition(unitUpdate.maxX, true), syncUnit.minX + 1);
+		syncUnit.maxY = std::max(QuantizePosition(unitUpdate.maxY, true), syncUnit.minY + 1);
+		syncUnit.destinationX = QuantizePosition(unitUpdate.movementDestination.x, false);
+		syncUnit.destinationY = QuantizePosition(unitUpdate.movementDestination.y, false);
+		syncUnit.movementDirection = QuantizeDirection(unitUpdate.movementDirection);
+		syncUnit.movementTargetUnitId = unitUpdate.movementTargetUnitId & bitwriter::mask(UnitIdBits);
+		syncUnit.movementRunning = unitUpdate.movementRunning ? 1 : 0;
+		syncUnit.firstFighter = (int)frame.fighters.size();
+
+		// positions are quantized within the bounds the client will see
+		UnitUpdate bounds = syncUnit.GetUnitUpdate();
+		for (int i = 0; i < count; ++i)
+		{
+			SyncFighter syncFighter;
+			syncFighter.update = unit->fighters[i].GetFighterUpdate(bounds);
+			syncFighter.readyState = unit->fighters[i].GetReadyState();
+			frame.fighters.push_back(syncFighter);
+		}
+
+		frame.units.push_back(syncUnit);
+	}
+}
+
+
+const SyncFrame* SyncServer::FindSentFrame(int tick) const
+{
+	for (const SyncFrame& frame : _sentFrames)
+		if (frame.tick == tick)
+			return &frame;
+	return nullptr;
+}
+
+
+void SyncServer::WriteFrame(bitwriter& writer, const SyncFrame& frame, const SyncFrame* baseline)
+{
+	writer.write((unsigned int)frame.units.size(), UnitCountBits);
+
+	for (const SyncUnit& unit : frame.units)
+	{
+		writer.write(unit.unitId, UnitIdBits);
+
+		const SyncUnit* previous = baseline != nullptr ? baseline->FindUnit(unit.unitId) : nullptr;
+		if (previous == nullptr)
+		{
+			// came into sight, everything in full
+			writer.write(unit.player, PlayerBits);
+			writer.write(unit.unitPlatform, PlatformBits);
+			writer.write(unit.unitWeapon, WeaponBits);
+			WriteUnitState(writer, unit);
+			WriteUnitBounds(writer, unit);
+			WriteUnitMovement(writer, unit);
+			for (int i = 0; i < unit.fightersCount; ++i)
+				WriteFighter(writer, frame.fighters[unit.firstFighter + i]);
+			continue;
+		}
+
+		bool sameUnit = unit.SameUnit(*previous);
+		writer.write(sameUnit ? 0 : 1, 1);
+		if (!sameUnit)
+			WriteUnitState(writer, unit);
+
+		bool sameBounds = unit.SameBounds(*previous);
+		writer.write(sameBounds ? 0 : 1, 1);
+		if (!sameBounds)
+			WriteUnitBounds(writer, unit);
+
+		bool sameMovement = unit.SameMovement(*previous);
+		writer.write(sameMovement ? 0 : 1, 1);
+		if (!sameMovement)
+			WriteUnitMovement(writer, unit);
+
+		bool sameFighters = SameFighters(frame, unit, *baseline, *previous);
+		writer.write(sameFighters ? 0 : 1, 1);
+		if (!sameFighters)
+		{
+			// fighters beyond the baseline count are new, the rest are deltas by index
+			for (int i = 0; i < unit.fightersCount; ++i)
+			{
+				const SyncFighter& fighter = frame.fighters[unit.firstFighter + i];
+				if (i < previous->fightersCount)
+					WriteFighterDelta(writer, fighter, baseline->fighters[previous->firstFighter + i]);
+				else
+					WriteFighter(writer, fighter);
+			}
+		}
+	}
+}
+
+
+/***/
+
+
+SyncClient::SyncClient(SimulationState* simulationState) :
+_simulationState(simulationState),
+_appliedTick(-1)
+{
+}
+
+
+SyncClient::~SyncClient()
+{
+	for (std::pair<int, Unit*> item : _hiddenUnits)
+	{
+		delete[] item.second->fighters;
+		delete item.second;
+	}
+}
+
+
+int SyncClient::ReadPacket(const unsigned char* data, size_t size)
+{
+	bitreader reader(data, size);
+	int tick = (int)reader.read(TickBits);
+	unsigned int baselineTick = reader.read(TickBits);
+	if (reader.failed() || tick < 0)
+		return -1;
+
+	const SyncFrame* baseline = nullptr;
+	if (baselineTick != NoBaseline)
+	{
+		baseline = FindReceivedFrame((int)baselineTick);
+		if (baseline == nullptr)
+			return -1;
+	}
+
+	SyncFrame frame;
+	frame.tick = tick;
+	if (!ReadFrame(reader, frame, baseline))
+		return -1;
+
+	// a full frame may follow a rewind, deltas older than the state are late and only kept as baselines
+	if (tick > _appliedTick || baseline == nullptr)
+	{
+		ApplyFrame(frame);
+		_appliedTick = tick;
+	}
+
+	if (baseline != nullptr)
+	{
+		while (!_receivedFrames.empty() && _receivedFrames.front().tick < (int)baselineTick)
+			_receivedFrames.pop_front();
+	}
+
+	std::deque<SyncFrame>::iterator i = std::find_if(_receivedFrames.begin(), _receivedFrames.end(),
+		[tick](const SyncFrame& received) { return received.tick == tick; });
+	if (i != _receivedFrames.end())
+		_receivedFrames.erase(i);
+
+	_receivedFrames.push_back(SyncFrame());
+	_receivedFrames.back().tick = frame.tick;
+	_receivedFrames.back().units.swap(frame.units);
+	_receivedFrames.back().fighters.swap(frame.fighters);
+	while (_receivedFrames.size() > 64)
+		_receivedFrames.pop_front();
+
+	return tick;
+}
+
+
+const SyncFrame* SyncClient::FindReceivedFrame(int tick) const
+{
+	for (const SyncFrame& frame : _receivedFrames)
+		if (frame.tick == tick)
+			return &frame;
+	return nullptr;
+}
+
+
+void SyncClient::ApplyFrame(const SyncFrame& frame)
+{
+	// units out of sight leave the state, but views may still refer to them
+	std::vector<int> hidden;
+	for (std::pair<int, Unit*> item : _simulationState->units)
+		if (frame.FindUnit(item.first) == nullptr)
+			hidden.push_back(item.first);
+
+	for (int unitId : hidden)
+	{
+		_hiddenUnits[unitId] = _simulationState->units[unitId];
+		_simulationState->units.erase(unitId);
+	}
+
+	// all units are in place before movement targets are looked up
+	std::set<int> appeared;
+	for (const SyncUnit& syncUnit : frame.units)
+	{
+		if (_simulationState->GetUnit(syncUnit.unitId) != nullptr)
+			continue;
+
+		appeared.insert(syncUnit.unitId);
+		std::map<int, Unit*>::iterator i = _hiddenUnits.find(syncUnit.unitId);
+		if (i != _hiddenUnits.end())
+		{
+			_simulationState->units[syncUnit.unitId] = i->second;
+			_hiddenUnits.erase(i);
+			continue;
+		}
+
+		UnitUpdate unitUpdate = syncUnit.GetUnitUpdate();
+		UnitDeployment deployment;
+		deployment.unitId = syncUnit.unitId;
+		deployment.player = (Player)syncUnit.player;
+		deployment.stats = SimulationState::GetDefaultUnitStats((UnitPlatform)syncUnit.unitPlatform, (UnitWeapon)syncUnit.unitWeapon);
+		deployment.fightersCount = std::max(1, syncUnit.fightersCount);
+		deployment.center = glm::vec2((unitUpdate.minX + unitUpdate.maxX) / 2, (unitUpdate.minY + unitUpdate.maxY) / 2);
+		deployment.Apply(_simulationState);
+		_capacities[syncUnit.unitId] = deployment.fightersCount;
+	}
+
+	for (const SyncUnit& syncUnit : frame.units)
+	{
+		Unit* unit = _simulationState->GetUnit(syncUnit.unitId);
+		UnitUpdate unitUpdate = syncUnit.GetUnitUpdate();
+		unitUpdate.fightersCount = std::min(unitUpdate.fightersCount, _capacities[syncUnit.unitId]);
+
+		unit->SetUnitUpdate(unitUpdate, _simulationState);
+		unit->state.unitMode = (UnitMode)syncUnit.unitMode;
+		unit->state.direction = DequantizeDirection(syncUnit.direction);
+
+		// fighters are rendered moving from the previous frame, except units just come into sight
+		FighterStateArrays& state = _simulationState->fighterStore.state;
+		bool moving = appeared.find(syncUnit.unitId) == appeared.end();
+		for (int i = 0; i < unit->fightersCount; ++i)
+		{
+			const SyncFighter& syncFighter = frame.fighters[syncUnit.firstFighter + i];
+			int slot = unit->fighters[i].slot;
+			glm::vec2 previousPosition = state.position[slot];
+			unit->fighters[i].SetFighterUpdate(unitUpdate, syncFighter.update);
+			state.previousPosition[slot] = moving ? previousPosition : state.position[slot];
+			state.readyState[slot] = (ReadyState)syncFighter.readyState;
+		}
+
+		if (unit->fightersCount != 0)
+			unit->state.center = unit->CalculateUnitCenter();
+		unit->nextState = unit->state;
+	}
+
+	_simulationState->tick = frame.tick;
+	_simulationState->time = frame.tick * _simulationState->timeStep;
+}
+
+
+bool SyncClient::ReadFrame(bitreader& reader, SyncFrame& frame, const SyncFrame* baseline)
+{
+	int count = (int)reader.read(UnitCountBits);
+	if (reader.failed())
+		return false;
+
+	frame.units.resize(count);
+	for (int j = 0; j < count; ++j)
+	{
+		SyncUnit& unit = frame.units[j];
+		unit.unitId = (int)reader.read(UnitIdBits);
+		if (j != 0 && unit.unitId <= frame.units[j - 1].unitId)
+			return false;
+
+		const SyncUnit* previous = baseline != nullptr ? baseline->FindUnit(unit.unitId) : nullptr;
+		if (previous == nullptr)
+		{
+			unit.player = (int)reader.read(PlayerBits);
+			unit.unitPlatform = (int)reader.read(PlatformBits);
+			unit.unitWeapon = (int)reader.read(WeaponBits);
+			ReadUnitState(reader, unit);
+			ReadUnitBounds(reader, unit);
+			ReadUnitMovement(reader, unit);
+			unit.firstFighter = (int)frame.fighters.size();
+			if (unit.player > Player2 || unit.unitWeapon > UnitWeaponArq || reader.failed())
+				return false;
+
+			frame.fighters.resize(unit.firstFighter + unit.fightersCount);
+			for (int i = 0; i < unit.fightersCount; ++i)
+				ReadFighter(reader, frame.fighters[unit.firstFighter + i]);
+		}
+		else
+		{
+			unit = *previous;
+			if (reader.read(1) != 0)
+				ReadUnitState(reader, unit);
+			if (reader.read(1) != 0)
+				ReadUnitBounds(reader, unit);
+			if (reader.read(1) != 0)
+				ReadUnitMovement(reader, unit);
+			unit.firstFighter = (int)frame.fighters.size();
+			if (reader.failed())
+				return false;
+
+			frame.fighters.resize(unit.firstFighter + unit.fightersCount);
+			bool sameFighters = reader.read(1) == 0;
+			if (sameFighters && unit.fightersCount != previous->fightersCount)
+				return false;
+
+			for (int i = 0; i < unit.fightersCount; ++i)
+			{
+				SyncFighter& fighter = frame.fighters[unit.firstFighter + i];
+				if (i >= previous->fightersCount)
+					ReadFighter(reader, fighter);
+				else if (sameFighters)
+					fighter = baseline->fighters[previous->firstFighter + i];
+				else
+					ReadFighterDelta(reader, fighter, baseline->fighters[previous->firstFighter + i]);
+			}
+		}
+
+		if (unit.maxX <= unit.minX || unit.maxY <= unit.minY)
+			return false;
+	}
+
+	for (const SyncFighter& fighter : frame.fighters)
+		if (fighter.readyState > ReadyStateStunned)
+			return false;
+
+	return !reader.failed();
+}
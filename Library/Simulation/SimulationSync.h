@@ -0,0 +1,115 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#ifndef SIMULATIONSYNC_H
+#define SIMULATIONSYNC_H
+
+#include "SimulationState.h"
+#include "bitstream.h"
+
+
+// The quantized state of a unit as seen by a client. Positions are 16 bits in
+// steps of 1/16 meter, fighter positions are 8 bits within the unit's bounds,
+// as in Unit::GetUnitUpdate() and Fighter::GetFighterUpdate().
+
+struct SyncUnit
+{
+	int unitId;
+	int player;
+	int unitPlatform;
+	int unitWeapon;
+	int fightersCount;
+	int unitMode;
+	int morale; // 8 bits over [-1, 1]
+	int direction; // 8 bits over a full turn
+	int minX, minY, maxX, maxY;
+	int destinationX, destinationY;
+	int movementDirection;
+	int movementTargetUnitId;
+	int movementRunning;
+	int firstFighter; // index in SyncFrame::fighters
+
+	UnitUpdate GetUnitUpdate() const;
+
+	bool SameUnit(const SyncUnit& other) const;
+	bool SameBounds(const SyncUnit& other) const;
+	bool SameMovement(const SyncUnit& other) const;
+};
+
+
+struct SyncFighter
+{
+	FighterUpdate update;
+	int readyState;
+};
+
+
+struct SyncFrame
+{
+	int tick;
+	std::vector<SyncUnit> units; // ordered by unit id
+	std::vector<SyncFighter> fighters;
+
+	const SyncUnit* FindUnit(int unitId) const;
+};
+
+
+// Encodes packets for one client: the units the client's player can see, as a
+// delta against the last frame the client acknowledged, or in full when there
+// is none. Keep one server per client.
+
+class SyncServer
+{
+	Player _player;
+	std::deque<SyncFrame> _sentFrames;
+	int _acknowledgedTick;
+
+public:
+	float sightRange; // distance at which enemy units are seen from own units
+	int maxSentFrames; // frames kept as baselines, older acknowledgements are ignored
+
+	explicit SyncServer(Player player);
+
+	void Acknowledge(int tick);
+	void WritePacket(SimulationState* simulationState, std::vector<unsigned char>& packet);
+
+	int GetAcknowledgedTick() const { return _acknowledgedTick; } // -1 until a sent frame is acknowledged
+
+private:
+	void CaptureFrame(SimulationState* simulationState);
+	const SyncFrame* FindSentFrame(int tick) const;
+
+	static void WriteFrame(bitwriter& writer, const SyncFrame& frame, const SyncFrame* baseline);
+};
+
+
+// Decodes packets from a SyncServer into a client side SimulationState, adding
+// units as they come into sight and removing them when they are lost. Removed
+// Unit objects are kept and reused when the unit is seen again, since views
+// may still refer to them.
+
+class SyncClient
+{
+	SimulationState* _simulationState;
+	std::deque<SyncFrame> _receivedFrames;
+	std::map<int, Unit*> _hiddenUnits;
+	std::map<int, int> _capacities; // fighters allocated per unit id
+	int _appliedTick;
+
+public:
+	explicit SyncClient(SimulationState* simulationState);
+	~SyncClient();
+
+	// returns the tick to acknowledge, or -1 if the packet could not be decoded
+	int ReadPacket(const unsigned char* data, size_t size);
+
+private:
+	const SyncFrame* FindReceivedFrame(int tick) const;
+	void ApplyFrame(const SyncFrame& frame);
+
+	static bool ReadFrame(bitreader& reader, SyncFrame& frame, const SyncFrame* baseline);
+};
+
+
+#endif
@@ -0,0 +1,84 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#include "TerrainGrid.h"
+#include "image.h"
+
+
+TerrainGrid::TerrainGrid() :
+_cells(std::make_shared<std::vector<unsigned char>>(2, 0)),
+_data(_cells->data()),
+_width(0),
+_height(0),
+_stride(1)
+{
+}
+
+
+void TerrainGrid::Build(const image* map)
+{
+	_width = map != nullptr ? (int)map->_width : 0;
+	_height = map != nullptr ? (int)map->_height : 0;
+	_stride = (_width + 3) / 2;
+
+	// copies of the grid keep the cells they were made with
+	_cells = std::make_shared<std::vector<unsigned char>>(_stride * (_height + 2), 0);
+	_data = _cells->data();
+
+	if (map != nullptr)
+		ClassifyPixels(map, 0, 0, _width, _height);
+}
+
+
+void TerrainGrid::Update(const image* map, bounds2f bounds)
+{
+	if (map == nullptr || (int)map->_width != _width || (int)map->_height != _height)
+	{
+		Build(map);
+		return;
+	}
+
+	// a pixel either side, for positions truncated toward zero
+	int x0 = std::max(0, (int)floorf(512 * bounds.min.x / 1024) - 1);
+	int y0 = std::max(0, (int)floorf(512 * bounds.min.y / 1024) - 1);
+	int x1 = std::min(_width, (int)ceilf(512 * bounds.max.x / 1024) + 1);
+	int y1 = std::min(_height, (int)ceilf(512 * bounds.max.y / 1024) + 1);
+
+	if (_cells.use_count() != 1)
+	{
+		_cells = std::make_shared<std::vector<unsigned char>>(*_cells);
+		_data = _cells->data();
+	}
+
+	ClassifyPixels(map, x0, y0, x1, y1);
+}
+
+
+int TerrainGrid::Classify(glm::vec4 pixel)
+{
+	// channels have 8 bits, so > 0.5 and >= 0.5 are the same test
+	int result = 0;
+	if (pixel.g >= 0.5)
+		result |= TerrainClassForest;
+	if (pixel.b >= 0.5)
+		result |= TerrainClassWater;
+	if (pixel.r >= 0.5)
+		result |= TerrainClassFord;
+	if (pixel.b >= 0.5 && pixel.r < 0.5)
+		result |= TerrainClassImpassable;
+	return result;
+}
+
+
+void TerrainGrid::ClassifyPixels(const image* map, int x0, int y0, int x1, int y1)
+{
+	for (int y = y0; y < y1; ++y)
+		for (int x = x0; x < x1; ++x)
+		{
+			int cx = x + 1;
+			int shift = (cx & 1) << 2;
+			unsigned char& cell = (*_cells)[(y + 1) * _stride + (cx >> 1)];
+			cell = (unsigned char)((cell & ~(15 << shift)) | (Classify(map->get_pixel(x, y)) << shift));
+		}
+}
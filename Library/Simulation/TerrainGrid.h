@@ -0,0 +1,67 @@
+// Copyright (C) 2013 Felix Ungman
+//
+// This file is part of the openwar platform (GPL v3 or later), see LICENSE.txt
+
+#ifndef TERRAINGRID_H
+#define TERRAINGRID_H
+
+#include "bounds.h"
+
+class image;
+
+
+enum TerrainClass
+{
+	TerrainClassForest = 1,
+	TerrainClassWater = 2,
+	TerrainClassFord = 4,
+	TerrainClassImpassable = 8 // water without a ford
+};
+
+
+// Terrain classes of the map pixels, four bits per pixel and two pixels per
+// byte, classified once when the map is loaded and again where it is edited.
+// Positions map to pixels as in the map lookups the simulation used to make,
+// a pixel per two meters. They are clamped onto a border of open terrain
+// instead of being tested against the map bounds, so lookups do not branch.
+//
+// Copies share the cells until one of them is updated, so forked simulation
+// states do not copy the terrain.
+
+class TerrainGrid
+{
+	std::shared_ptr<std::vector<unsigned char>> _cells;
+	const unsigned char* _data; // the shared cells, for lookups without the indirection
+	int _width; // pixels, the border not included
+	int _height;
+	int _stride; // bytes per row
+
+public:
+	TerrainGrid();
+
+	void Build(const image* map);
+	void Update(const image* map, bounds2f bounds);
+
+	// true if the grids are copies of each other that neither has updated since
+	bool IsSharedWith(const TerrainGrid& other) const { return _cells == other._cells; }
+
+	int GetClasses(glm::vec2 position) const
+	{
+		// truncates toward zero like the (int) cast in the map lookups
+		int x = (int)fminf(fmaxf(512 * position.x / 1024, -1), (float)_width) + 1;
+		int y = (int)fminf(fmaxf(512 * position.y / 1024, -1), (float)_height) + 1;
+		return (_data[y * _stride + (x >> 1)] >> ((x & 1) << 2)) & 15;
+	}
+
+	bool IsForest(glm::vec2 position) const { return (GetClasses(position) & TerrainClassForest) != 0; }
+	bool IsWater(glm::vec2 position) const { return (GetClasses(position) & TerrainClassWater) != 0; }
+	bool IsImpassable(glm::vec2 position) const { return (GetClasses(position) & TerrainClassImpassable) != 0; }
+
+	static int Classify(glm::vec4 pixel);
+
+private:
+	void ClassifyPixels(const image* map, int x0, int y0, int x1, int y1);
+};
+
+
+#endif
@@ -40,6 +40,9 @@ static SimulationState* LoadSimulationState(image* map)
 {
 	SimulationState* result = new SimulationState();
 
+	// a new seed for every battle, recorded in the replay log so the battle can be run again
+	result->seed = (unsigned int)std::chrono::system_clock::now().time_since_epoch().count();
+
 	if (map == nullptr)
 	{
 		map = new image(512, 512);
@@ -64,6 +67,7 @@ static SimulationState* LoadSimulationState(image* map)
 	}
 
 	result->map = map;
+	result->UpdateTerrainGrid();
 	result->terrainModel = new SmoothTerrainModel(bounds2f(0, 0, 1024, 1024), map);
 
 	return result;
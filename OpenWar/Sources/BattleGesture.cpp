@@ -463,14 +463,18 @@ void BattleGesture::UpdateTrackingMarker()
 			markerPosition += differenceToCenter * (distanceToCenter - 512) / distanceToCenter;
 		}
 
+		// the path goes around water on the way, but the marker cannot be put in it
 		float waterEdgeFactor = -1;
-		float delta = 2 / fmaxf(1, glm::length(currentDestination - markerPosition));
-		for (float k = 0; k < 1; k += delta)
+		if (_boardView->GetBoardModel()->_simulationState->IsImpassable(markerPosition))
 		{
-			if (_boardView->GetBoardModel()->_simulationState->IsImpassable(glm::mix(currentDestination, markerPosition, k)))
+			float delta = 2 / fmaxf(1, glm::length(currentDestination - markerPosition));
+			for (float k = 0; k < 1; k += delta)
 			{
-				waterEdgeFactor = k;
-				break;
+				if (_boardView->GetBoardModel()->_simulationState->IsImpassable(glm::mix(currentDestination, markerPosition, k)))
+				{
+					waterEdgeFactor = k;
+					break;
+				}
 			}
 		}
 
@@ -487,7 +491,7 @@ void BattleGesture::UpdateTrackingMarker()
 
 
 		float trackingVelocity = glm::length(_trackingTouch->GetVelocity() / 1024.0f);
-		MovementRules::UpdateMovementPath(_trackingMarker->_path, origin, markerPosition, trackingVelocity);
+		MovementRules::UpdateMovementPath(_boardView->GetBoardModel()->_simulationState, _trackingMarker->_unit, _trackingMarker->_path, origin, markerPosition, trackingVelocity);
 
 
 		if (enemyUnit)
@@ -392,6 +392,30 @@ void BattleModel::AddRangeMarker(Unit* unit)
 }
 
 
+void BattleModel::AddMissingUnitMarkers()
+{
+	// units brought back by rewinding lost their markers when they were removed
+	for (std::pair<int, Unit*> item : _simulationState->units)
+	{
+		Unit* unit = item.second;
+
+		bool hasUnitMarker = false;
+		for (UnitMarker* marker : _unitMarkers)
+			if (marker->_unit == unit)
+				hasUnitMarker = true;
+		if (!hasUnitMarker)
+			AddUnitMarker(unit);
+
+		bool hasRangeMarker = false;
+		for (RangeMarker* marker : _rangeMarkers)
+			if (marker->_unit == unit)
+				hasRangeMarker = true;
+		if (!hasRangeMarker && unit->stats.maximumRange > 0)
+			AddRangeMarker(unit);
+	}
+}
+
+
 void BattleModel::AddCasualty(const Casualty& casualty)
 {
 	glm::vec3 position = glm::vec3(casualty.position, _simulationState->terrainModel->GetHeight(casualty.position));
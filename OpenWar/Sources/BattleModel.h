@@ -219,6 +219,7 @@ public:
 
 	void AddUnitMarker(Unit* unit);
 	void AddRangeMarker(Unit* unit);
+	void AddMissingUnitMarkers();
 	void AddCasualty(const Casualty& casualty);
 
 	MovementMarker* AddMovementMarker(Unit* unit);
@@ -23,7 +23,8 @@ _trackingMarker_missileHeadShape(),
 _unitMarker_targetLineShape(),
 _unitMarker_targetHeadShape(),
 _shape_fighter_weapons(),
-_terrainRendering(terrainRendering)
+_terrainRendering(terrainRendering),
+interpolationFactor(1)
 {
 	int max_level = 2;
 
@@ -449,8 +450,8 @@ void BattleView::AppendFighterWeapons(Unit* unit)
 	{
 		for (Fighter* fighter = unit->fighters, * end = fighter + unit->fightersCount; fighter != end; ++fighter)
 		{
-			glm::vec2 p1 = fighter->state.position;
-			glm::vec2 p2 = p1 + unit->stats.weaponReach * vector2_from_angle(fighter->state.direction);
+			glm::vec2 p1 = fighter->GetInterpolatedPosition(interpolationFactor);
+			glm::vec2 p2 = p1 + unit->stats.weaponReach * vector2_from_angle(fighter->GetDirection());
 
 			_shape_fighter_weapons._vertices.push_back(plain_vertex3(to_vector3(p1)));
 			_shape_fighter_weapons._vertices.push_back(plain_vertex3(to_vector3(p2)));
@@ -521,7 +522,7 @@ void BattleView::AppendFighterBillboards()
 		for (Fighter* fighter = unit->fighters, * end = fighter + unit->fightersCount; fighter != end; ++fighter)
 		{
 			float size = 2.0;
-			float diff = angle_difference(GetCameraFacing(), fighter->state.direction);
+			float diff = angle_difference(GetCameraFacing(), fighter->GetDirection());
 			float absdiff = fabsf(diff);
 
 			int i = unit->player == Player2 ? 2 : 1;
@@ -551,7 +552,7 @@ void BattleView::AppendFighterBillboards()
 			}
 
 
-			_dynamic_billboards.push_back(MakeBillboardVertex(fighter->state.position, size, i, j, diff < 0));
+			_dynamic_billboards.push_back(MakeBillboardVertex(fighter->GetInterpolatedPosition(interpolationFactor), size, i, j, diff < 0));
 		}
 	}
 }
@@ -63,6 +63,7 @@ class BattleView : public TerrainView
 
 public:
 	SmoothTerrainRendering* _terrainRendering;
+	float interpolationFactor; // fighters are rendered this far from their previous position, see SimulationRules::GetInterpolationFactor()
 
 	BattleView(Surface* screen, BattleModel* boardModel, renderers* r, BattleRendering* battleRendering, SmoothTerrainRendering* terrainRendering, Player bluePlayer);
 	~BattleView();
@@ -86,6 +86,7 @@ void EditorModel::EditWater(glm::vec2 position, bool value)
 {
 	bounds2f bounds = _terrainRendering->GetTerrainModel()->EditWater(position, 15, value ? 0.5 : -0.5);
 	_terrainRendering->UpdateHeights(bounds);
+	_battleView->GetBoardModel()->_simulationState->UpdateTerrainGrid(bounds);
 	_battleView->UpdateTerrainTrees(bounds);
 }
 
@@ -94,5 +95,6 @@ void EditorModel::EditTrees(glm::vec2 position, bool value)
 {
 	bounds2f bounds = _terrainRendering->GetTerrainModel()->EditTrees(position, 15, value ? 0.5 : -0.5);
 	_terrainRendering->UpdateMapTexture();
+	_battleView->GetBoardModel()->_simulationState->UpdateTerrainGrid(bounds);
 	_battleView->UpdateTerrainTrees(bounds);
 }
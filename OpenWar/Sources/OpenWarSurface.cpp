@@ -6,6 +6,8 @@
 #include "SoundPlayer.h"
 #include "SimulationState.h"
 #include "SimulationRules.h"
+#include "SimulationHistory.h"
+#include "SimulationRecorder.h"
 #include "BattleModel.h"
 #include "BattleGesture.h"
 #include "TerrainGesture.h"
@@ -19,6 +21,10 @@ OpenWarSurface::OpenWarSurface(glm::vec2 size, float pixelDensity) : Surface(siz
 _mode(Mode::None),
 _simulationState(nullptr),
 _simulationRules(nullptr),
+_simulationWorkers(nullptr),
+_pathJobs(nullptr),
+_simulationRecorder(nullptr),
+_simulationHistory(nullptr),
 _renderers(nullptr),
 _battleRendering(nullptr),
 _buttonRendering(nullptr),
@@ -42,6 +48,9 @@ _buttonItemTrees(nullptr)
 {
 	SoundPlayer::Initialize();
 
+	_simulationWorkers = new taskpool();
+	_pathJobs = new PathJobQueue();
+
 	_renderers = renderers::singleton = new renderers();
 	_battleRendering = new BattleRendering();
 	_buttonRendering = new ButtonRendering(_renderers, pixelDensity);
@@ -92,10 +101,21 @@ OpenWarSurface::~OpenWarSurface()
 
 void OpenWarSurface::Reset(SimulationState* simulationState)
 {
+	// a revert replaces the battle, its recording and history go with it
+	StopRecording();
+	delete _simulationHistory;
+	_simulationHistory = nullptr;
+
 	_simulationState = simulationState;
 
 	_simulationRules = new SimulationRules(_simulationState);
 	_simulationRules->currentPlayer = Player1;
+	_simulationRules->workers = _simulationWorkers;
+	_simulationRules->pathJobs = _pathJobs;
+
+	// about a hundred seconds of a 5000 fighter battle, one keyframe every 5 seconds
+	_simulationHistory = new SimulationHistory(64 << 20, 75);
+	_simulationRules->history = _simulationHistory;
 
 	_terrainRendering = new SmoothTerrainRendering(_simulationState->terrainModel, _simulationState->map, true);
 
@@ -138,7 +158,10 @@ void OpenWarSurface::Update(double secondsSinceLastUpdate)
 		UpdateSoundPlayer();
 	}
 	if (_battleView != nullptr)
+	{
+		_battleView->interpolationFactor = _mode == Mode::Playing ? _simulationRules->GetInterpolationFactor() : 1;
 		_battleView->Update(secondsSinceLastUpdate);
+	}
 }
 
 
@@ -203,6 +226,7 @@ void OpenWarSurface::UpdateSoundPlayer()
 
 void OpenWarSurface::ClickedPlay()
 {
+	StartRecording();
 	_mode = Mode::Playing;
 	UpdateButtonsAndGestures();
 }
@@ -210,6 +234,7 @@ void OpenWarSurface::ClickedPlay()
 
 void OpenWarSurface::ClickedPause()
 {
+	StopRecording();
 	_mode = Mode::Editing;
 	UpdateButtonsAndGestures();
 }
@@ -217,12 +242,48 @@ void OpenWarSurface::ClickedPause()
 
 void OpenWarSurface::ClickedRewind()
 {
-	_simulationState->time = 0; // TODO: reload & reset simlation state
+	StopRecording();
+	int tick = _simulationHistory->GetStartTick() != -1 ? _simulationHistory->GetStartTick() : _simulationHistory->GetFirstTick();
+	if (_simulationRules->Rewind(tick))
+	{
+		_battleModel->RemoveAllShootingMarkers();
+		_battleModel->RemoveAllSmokeMarkers();
+		_battleModel->AddMissingUnitMarkers();
+	}
 	_mode = Mode::Editing;
 	UpdateButtonsAndGestures();
 }
 
 
+// Set OPENWAR_REPLAY_LOG to a file path to record battles played from the start,
+// for running them again with Benchmarks/ReplayBenchmark. The map can be edited
+// while paused, so the log is saved and recording stops on pause.
+
+void OpenWarSurface::StartRecording()
+{
+	if (_simulationRecorder == nullptr && _simulationState->tick == 0 && getenv("OPENWAR_REPLAY_LOG") != nullptr)
+	{
+		_simulationRecorder = new SimulationRecorder(_simulationState, true);
+		_simulationRules->recorder = _simulationRecorder;
+	}
+}
+
+
+void OpenWarSurface::StopRecording()
+{
+	if (_simulationRecorder != nullptr)
+	{
+		const char* path = getenv("OPENWAR_REPLAY_LOG");
+		if (path != nullptr && !_simulationRecorder->Save(path))
+			NSLog(@"could not save replay log: %s", path);
+
+		_simulationRules->recorder = nullptr;
+		delete _simulationRecorder;
+		_simulationRecorder = nullptr;
+	}
+}
+
+
 void OpenWarSurface::SetEditorMode(EditorMode editorMode)
 {
 	if (_editorModel != nullptr)
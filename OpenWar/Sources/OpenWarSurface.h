@@ -17,10 +17,14 @@ class ButtonItem;
 class ButtonRendering;
 class ButtonView;
 class EditorGesture;
+class PathJobQueue;
+class SimulationHistory;
+class SimulationRecorder;
 class SimulationRules;
 class SimulationState;
 class SmoothTerrainRendering;
 class TerrainGesture;
+class taskpool;
 
 
 class OpenWarSurface : public Surface
@@ -30,6 +34,10 @@ public: // TODO: just testing
 	Mode _mode;
 	SimulationState* _simulationState;
 	SimulationRules* _simulationRules;
+	taskpool* _simulationWorkers;
+	PathJobQueue* _pathJobs;
+	SimulationRecorder* _simulationRecorder;
+	SimulationHistory* _simulationHistory;
 
 	renderers* _renderers;
 	BattleRendering* _battleRendering;
@@ -73,6 +81,9 @@ private:
 	void ClickedPause();
 	void ClickedRewind();
 
+	void StartRecording();
+	void StopRecording();
+
 	void SetEditorMode(EditorMode editorMode);
 	void SetEditorFeature(EditorFeature editorFeature);
 